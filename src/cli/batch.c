@@ -0,0 +1,376 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cli/batch.h"
+#include "common/colorspaces.h"
+#include "common/darktable.h"
+#include "common/exif.h"
+#include "common/film.h"
+#include "common/image.h"
+#include "common/image_cache.h"
+#include "common/imageio.h"
+#include "common/imageio_module.h"
+#include "common/metadata_export.h"
+
+#include <json-glib/json-glib.h>
+#include <libintl.h>
+#include <string.h>
+
+typedef struct dt_cli_batch_job_t
+{
+  gchar *input;
+  int imgid;
+  size_t memory; // estimated peak while the job runs, 0 if unknown
+  int count;
+  dt_imageio_rendition_t *renditions;
+} dt_cli_batch_job_t;
+
+typedef struct dt_cli_batch_t
+{
+  dt_cli_batch_job_t *jobs;
+  int count;
+  size_t limit;
+
+  dt_pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int next, running, done, failed;
+  size_t reserved;
+} dt_cli_batch_t;
+
+static const struct
+{
+  const char *name;
+  dt_colorspaces_color_profile_type_t type;
+} _batch_profiles[] = { { "image", DT_COLORSPACE_NONE },
+                        { "srgb", DT_COLORSPACE_SRGB },
+                        { "adobergb", DT_COLORSPACE_ADOBERGB },
+                        { "linear-rec709", DT_COLORSPACE_LIN_REC709 },
+                        { "linear-rec2020", DT_COLORSPACE_LIN_REC2020 },
+                        { "rec709", DT_COLORSPACE_REC709 },
+                        { "prophoto", DT_COLORSPACE_PROPHOTO_RGB } };
+
+static const struct
+{
+  const char *name;
+  dt_iop_color_intent_t intent;
+} _batch_intents[] = { { "perceptual", DT_INTENT_PERCEPTUAL },
+                       { "relative", DT_INTENT_RELATIVE_COLORIMETRIC },
+                       { "saturation", DT_INTENT_SATURATION },
+                       { "absolute", DT_INTENT_ABSOLUTE_COLORIMETRIC } };
+
+static const gchar *_get_string(JsonObject *object, const char *name)
+{
+  return json_object_has_member(object, name) ? json_object_get_string_member(object, name) : NULL;
+}
+
+static gint64 _get_int(JsonObject *object, const char *name, const gint64 def)
+{
+  return json_object_has_member(object, name) ? json_object_get_int_member(object, name) : def;
+}
+
+static gboolean _get_bool(JsonObject *object, const char *name, const gboolean def)
+{
+  return json_object_has_member(object, name) ? json_object_get_boolean_member(object, name) : def;
+}
+
+// fills r from one entry of "outputs", returns 1 on errors
+static int _batch_parse_output(JsonObject *output, const char *style, const gboolean style_append,
+                               dt_imageio_rendition_t *r)
+{
+  const gchar *file = _get_string(output, "file");
+  if(!file || !*file)
+  {
+    fprintf(stderr, "%s\n", _("error: output without file name"));
+    return 1;
+  }
+
+  // the format follows from the extension, as for single exports
+  const char *dot = strrchr(file, '.');
+  if(!dot || strchr(dot, G_DIR_SEPARATOR))
+  {
+    fprintf(stderr, _("error: can't tell the format of %s"), file);
+    fprintf(stderr, "\n");
+    return 1;
+  }
+  gchar *ext = g_ascii_strdown(dot + 1, -1);
+  const char *name = !strcmp(ext, "jpg") ? "jpeg" : !strcmp(ext, "tif") ? "tiff" : ext;
+  r->format = dt_imageio_get_format_by_name(name);
+  if(!r->format)
+  {
+    fprintf(stderr, _("unknown extension '.%s'"), ext);
+    fprintf(stderr, "\n");
+    g_free(ext);
+    return 1;
+  }
+  g_free(ext);
+
+  const gchar *profile = _get_string(output, "profile");
+  r->icc_type = DT_COLORSPACE_NONE;
+  r->icc_filename = NULL;
+  if(profile)
+  {
+    gboolean found = FALSE;
+    for(int k = 0; k < G_N_ELEMENTS(_batch_profiles) && !found; k++)
+      if(!g_ascii_strcasecmp(profile, _batch_profiles[k].name))
+      {
+        r->icc_type = _batch_profiles[k].type;
+        found = TRUE;
+      }
+    if(!found && g_file_test(profile, G_FILE_TEST_IS_REGULAR))
+    {
+      r->icc_type = DT_COLORSPACE_FILE;
+      r->icc_filename = g_strdup(profile);
+      found = TRUE;
+    }
+    if(!found)
+    {
+      fprintf(stderr, _("error: unknown profile '%s'"), profile);
+      fprintf(stderr, "\n");
+      return 1;
+    }
+  }
+
+  const gchar *intent = _get_string(output, "intent");
+  r->icc_intent = DT_INTENT_LAST;
+  if(intent)
+  {
+    for(int k = 0; k < G_N_ELEMENTS(_batch_intents); k++)
+      if(!g_ascii_strcasecmp(intent, _batch_intents[k].name)) r->icc_intent = _batch_intents[k].intent;
+    if(r->icc_intent == DT_INTENT_LAST)
+    {
+      fprintf(stderr, _("error: unknown intent '%s'"), intent);
+      fprintf(stderr, "\n");
+      g_free((gchar *)r->icc_filename);
+      return 1;
+    }
+  }
+
+  r->format_params = r->format->get_params(r->format);
+  if(!r->format_params)
+  {
+    fprintf(stderr, "%s\n", _("failed to get parameters from format module, aborting export ..."));
+    g_free((gchar *)r->icc_filename);
+    return 1;
+  }
+
+  uint32_t fw = 0, fh = 0;
+  r->format->dimension(r->format, r->format_params, &fw, &fh);
+  const int width = MAX(_get_int(output, "width", 0), 0);
+  const int height = MAX(_get_int(output, "height", 0), 0);
+  r->format_params->max_width = (fw != 0 && width > fw) ? fw : width;
+  r->format_params->max_height = (fh != 0 && height > fh) ? fh : height;
+  g_strlcpy(r->format_params->style, style ? style : "", sizeof(r->format_params->style));
+  r->format_params->style_append = style_append;
+
+  r->filename = g_strdup(file);
+  r->high_quality = _get_bool(output, "hq", TRUE);
+  r->upscale = _get_bool(output, "upscale", FALSE);
+  return 0;
+}
+
+// imports the input of the job and sets up its renditions, returns 1 on errors
+static int _batch_parse_job(JsonObject *object, dt_cli_batch_job_t *job)
+{
+  const gchar *input = _get_string(object, "input");
+  if(!input || !*input)
+  {
+    fprintf(stderr, "%s\n", _("error: job without input file"));
+    return 1;
+  }
+  job->input = g_strdup(input);
+
+  JsonArray *outputs = json_object_has_member(object, "outputs") ? json_object_get_array_member(object, "outputs")
+                                                                  : NULL;
+  const int count = outputs ? json_array_get_length(outputs) : 0;
+  if(!count)
+  {
+    fprintf(stderr, _("error: no outputs for %s"), input);
+    fprintf(stderr, "\n");
+    return 1;
+  }
+
+  gchar *directory = g_path_get_dirname(input);
+  dt_film_t film;
+  const int filmid = dt_film_new(&film, directory);
+  g_free(directory);
+  job->imgid = dt_image_import(filmid, input, TRUE);
+  if(!job->imgid)
+  {
+    fprintf(stderr, _("error: can't open file %s"), input);
+    fprintf(stderr, "\n");
+    return 1;
+  }
+
+  const gchar *xmp = _get_string(object, "xmp");
+  if(xmp)
+  {
+    dt_image_t *image = dt_image_cache_get(darktable.image_cache, job->imgid, 'w');
+    const int res = dt_exif_xmp_read(image, xmp, 1);
+    // don't write new xmp:
+    dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_RELAXED);
+    if(res)
+    {
+      fprintf(stderr, _("error: can't open xmp file %s"), xmp);
+      fprintf(stderr, "\n");
+      return 1;
+    }
+  }
+
+  // the full size input, the shared buffer and the two cache lines of the pipe
+  const dt_image_t *image = dt_image_cache_get(darktable.image_cache, job->imgid, 'r');
+  const size_t pixels = (size_t)image->width * image->height;
+  dt_image_cache_read_release(darktable.image_cache, image);
+  job->memory = pixels * (sizeof(uint16_t) + 3 * 4 * sizeof(float));
+
+  const gchar *style = _get_string(object, "style");
+  const gboolean style_append = !_get_bool(object, "style-overwrite", FALSE);
+  job->renditions = (dt_imageio_rendition_t *)calloc(count, sizeof(dt_imageio_rendition_t));
+  for(int k = 0; k < count; k++)
+  {
+    JsonNode *node = json_array_get_element(outputs, k);
+    if(!JSON_NODE_HOLDS_OBJECT(node)
+       || _batch_parse_output(json_node_get_object(node), style, style_append, &job->renditions[job->count]))
+      return 1;
+    job->count++;
+  }
+  return 0;
+}
+
+static void _batch_job_cleanup(dt_cli_batch_job_t *job)
+{
+  for(int k = 0; k < job->count; k++)
+  {
+    dt_imageio_rendition_t *r = &job->renditions[k];
+    r->format->free_params(r->format, r->format_params);
+    g_free((gchar *)r->filename);
+    g_free((gchar *)r->icc_filename);
+  }
+  free(job->renditions);
+  g_free(job->input);
+}
+
+static void *_batch_worker(void *data)
+{
+  dt_cli_batch_t *batch = (dt_cli_batch_t *)data;
+
+  dt_pthread_mutex_lock(&batch->mutex);
+  while(batch->next < batch->count)
+  {
+    dt_cli_batch_job_t *job = &batch->jobs[batch->next];
+    // images whose size isn't known yet get the whole budget
+    const size_t memory = job->memory ? job->memory : batch->limit;
+    // wait for memory to become available, unless nothing else is running which could free some
+    if(batch->limit && batch->running && batch->reserved + memory > batch->limit)
+    {
+      dt_pthread_cond_wait(&batch->cond, &batch->mutex);
+      continue;
+    }
+    batch->next++;
+    batch->running++;
+    batch->reserved += memory;
+    dt_pthread_mutex_unlock(&batch->mutex);
+
+    dt_export_metadata_t metadata;
+    metadata.flags = dt_lib_export_metadata_default_flags();
+    metadata.list = NULL;
+    const int failed = dt_imageio_export_renditions(job->imgid, job->renditions, job->count, &metadata);
+
+    dt_pthread_mutex_lock(&batch->mutex);
+    batch->running--;
+    batch->reserved -= memory;
+    batch->failed += failed;
+    batch->done++;
+    printf("[%d/%d] %s: %d/%d %s\n", batch->done, batch->count, job->input, job->count - failed, job->count,
+           _("outputs written"));
+    pthread_cond_broadcast(&batch->cond);
+  }
+  dt_pthread_mutex_unlock(&batch->mutex);
+  return NULL;
+}
+
+int dt_cli_batch_run(const char *filename, const int threads, const int memory_limit)
+{
+  GError *error = NULL;
+  JsonParser *parser = json_parser_new();
+  if(!json_parser_load_from_file(parser, filename, &error))
+  {
+    fprintf(stderr, _("error: can't read job file %s: %s"), filename, error->message);
+    fprintf(stderr, "\n");
+    g_error_free(error);
+    g_object_unref(parser);
+    return -1;
+  }
+
+  JsonNode *root = json_parser_get_root(parser);
+  JsonObject *object = JSON_NODE_HOLDS_OBJECT(root) ? json_node_get_object(root) : NULL;
+  JsonArray *jobs = object && json_object_has_member(object, "jobs") ? json_object_get_array_member(object, "jobs")
+                                                                     : NULL;
+  if(!jobs)
+  {
+    fprintf(stderr, _("error: no `jobs' array in %s"), filename);
+    fprintf(stderr, "\n");
+    g_object_unref(parser);
+    return -1;
+  }
+
+  dt_cli_batch_t batch = { 0 };
+  batch.limit = (size_t)MAX(memory_limit, 0) << 20;
+  batch.jobs = (dt_cli_batch_job_t *)calloc(json_array_get_length(jobs), sizeof(dt_cli_batch_job_t));
+
+  // importing goes through the library, do that up front and only render in parallel
+  for(int k = 0; k < json_array_get_length(jobs); k++)
+  {
+    JsonNode *node = json_array_get_element(jobs, k);
+    dt_cli_batch_job_t *job = &batch.jobs[batch.count];
+    if(!JSON_NODE_HOLDS_OBJECT(node) || _batch_parse_job(json_node_get_object(node), job))
+    {
+      fprintf(stderr, _("skipping job %d"), k + 1);
+      fprintf(stderr, "\n");
+      batch.failed++;
+      _batch_job_cleanup(job);
+      memset(job, 0, sizeof(dt_cli_batch_job_t));
+      continue;
+    }
+    batch.count++;
+  }
+  g_object_unref(parser);
+
+  dt_pthread_mutex_init(&batch.mutex, NULL);
+  pthread_cond_init(&batch.cond, NULL);
+
+  const int workers = CLAMP(threads, 1, MAX(batch.count, 1));
+  pthread_t *thread = (pthread_t *)calloc(workers, sizeof(pthread_t));
+  int started = 0;
+  for(int k = 1; k < workers; k++)
+    if(!dt_pthread_create(&thread[started], _batch_worker, &batch)) started++;
+  // the calling thread works on the jobs as well
+  _batch_worker(&batch);
+  for(int k = 0; k < started; k++) pthread_join(thread[k], NULL);
+  free(thread);
+
+  pthread_cond_destroy(&batch.cond);
+  dt_pthread_mutex_destroy(&batch.mutex);
+
+  for(int k = 0; k < batch.count; k++) _batch_job_cleanup(&batch.jobs[k]);
+  free(batch.jobs);
+  return batch.failed;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,43 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+
+/**
+ * headless batch mode of darktable-cli. a json job file lists the inputs, each with an optional xmp file and
+ * style, and any number of outputs with their own size, color profile and format:
+ *
+ * { "jobs": [ { "input": "a.nef", "xmp": "a.nef.xmp", "style": "name", "style-overwrite": false,
+ *               "outputs": [ { "file": "a-web.jpg", "width": 2048, "height": 2048, "profile": "srgb",
+ *                              "intent": "perceptual", "hq": true, "upscale": false },
+ *                            { "file": "a-print.tif", "profile": "adobergb" } ] } ] }
+ *
+ * all outputs of one input are rendered together, see dt_imageio_export_renditions(). inputs are processed by
+ * up to threads workers at a time, which only start on another input while the estimated memory of all running
+ * ones stays below memory_limit megabytes (0 for no limit).
+ */
+
+/** runs the job file, dt_init() has to be done already. returns the number of failed outputs, where a job which
+ * could not be set up counts as one, or -1 if the job file could not be read. */
+int dt_cli_batch_run(const char *filename, const int threads, const int memory_limit);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
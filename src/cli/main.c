@@ -25,6 +25,8 @@
  *  - profit
  */
 
+#include "cli/batch.h"
+#include "common/export_report.h"
 #include "common/collection.h"
 #include "common/darktable.h"
 #include "common/debug.h"
@@ -58,6 +60,7 @@
 static void usage(const char *progname)
 {
   fprintf(stderr, "usage: %s <input file> [<xmp file>] <output file> [options] [--core <darktable options>]\n", progname);
+  fprintf(stderr, "       %s --batch <job file> [batch options] [--core <darktable options>]\n", progname);
   fprintf(stderr, "\n");
   fprintf(stderr, "options:\n");
   fprintf(stderr, "   --width <max width> default: 0 = full resolution\n");
@@ -68,7 +71,13 @@ static void usage(const char *progname)
   fprintf(stderr, "   --style <style name>\n");
   fprintf(stderr, "   --style-overwrite\n");
   fprintf(stderr, "   --apply-custom-presets <0|1|false|true>, default: true\n");
+  fprintf(stderr, "   --report <file> write a json line with the timings of each exported image to file\n");
   fprintf(stderr, "   --verbose\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "batch options:\n");
+  fprintf(stderr, "   --batch-threads <n> images processed at the same time, default: 1\n");
+  fprintf(stderr, "   --batch-memory <MB> memory limit for images processed at the same time, default: 0 = none\n");
+  fprintf(stderr, "\n");
   fprintf(stderr, "   --help,-h\n");
   fprintf(stderr, "   --version\n");
 }
@@ -89,6 +98,9 @@ int main(int argc, char *arg[])
   char *xmp_filename = NULL;
   char *output_filename = NULL;
   char *style = NULL;
+  char *batch_filename = NULL;
+  char *report_filename = NULL;
+  int batch_threads = 1, batch_memory = 0;
   int file_counter = 0;
   int width = 0, height = 0, bpp = 0;
   gboolean verbose = FALSE, high_quality = TRUE, upscale = FALSE, style_overwrite = FALSE, custom_presets = TRUE;
@@ -184,6 +196,26 @@ int main(int argc, char *arg[])
         g_free(str);
       }
 
+      else if(!strcmp(arg[k], "--batch") && argc > k + 1)
+      {
+        k++;
+        batch_filename = arg[k];
+      }
+      else if(!strcmp(arg[k], "--batch-threads") && argc > k + 1)
+      {
+        k++;
+        batch_threads = MAX(atoi(arg[k]), 1);
+      }
+      else if(!strcmp(arg[k], "--batch-memory") && argc > k + 1)
+      {
+        k++;
+        batch_memory = MAX(atoi(arg[k]), 0);
+      }
+      else if(!strcmp(arg[k], "--report") && argc > k + 1)
+      {
+        k++;
+        report_filename = arg[k];
+      }
       else if(!strcmp(arg[k], "-v") || !strcmp(arg[k], "--verbose"))
       {
         verbose = TRUE;
@@ -217,6 +249,39 @@ int main(int argc, char *arg[])
   for(; k < argc; k++) m_arg[m_argc++] = arg[k];
   m_arg[m_argc] = NULL;
 
+  if(batch_filename)
+  {
+    if(file_counter)
+    {
+      usage(arg[0]);
+      free(m_arg);
+      exit(1);
+    }
+
+    // init dt without gui and without data.db:
+    if(dt_init(m_argc, m_arg, FALSE, custom_presets, NULL))
+    {
+      free(m_arg);
+      exit(1);
+    }
+
+    if(report_filename && dt_export_report_open(report_filename))
+    {
+      fprintf(stderr, _("error: can't write report file `%s'"), report_filename);
+      fprintf(stderr, "\n");
+      dt_cleanup();
+      free(m_arg);
+      exit(1);
+    }
+
+    const int failed = dt_cli_batch_run(batch_filename, batch_threads, batch_memory);
+
+    dt_export_report_close();
+    dt_cleanup();
+    free(m_arg);
+    exit(failed ? 1 : 0);
+  }
+
   if(file_counter < 2 || file_counter > 3)
   {
     usage(arg[0]);
@@ -251,6 +316,15 @@ int main(int argc, char *arg[])
     exit(1);
   }
 
+  if(report_filename && dt_export_report_open(report_filename))
+  {
+    fprintf(stderr, _("error: can't write report file `%s'"), report_filename);
+    fprintf(stderr, "\n");
+    dt_cleanup();
+    free(m_arg);
+    exit(1);
+  }
+
   GList *id_list = NULL;
 
   if(g_file_test(input_filename, G_FILE_TEST_IS_DIR))
@@ -444,6 +518,7 @@ int main(int argc, char *arg[])
   format->free_params(format, fdata);
   g_list_free(id_list);
 
+  dt_export_report_close();
   dt_cleanup();
 
   free(m_arg);
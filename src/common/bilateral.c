@@ -81,14 +81,6 @@ size_t dt_bilateral_singlebuffer_size2(const int width,
 }
 #endif
 
-static void image_to_grid(const dt_bilateral_t *const b, const int i, const int j, const float L, float *x,
-                          float *y, float *z)
-{
-  *x = CLAMPS(i / b->sigma_s, 0, b->size_x - 1);
-  *y = CLAMPS(j / b->sigma_s, 0, b->size_y - 1);
-  *z = CLAMPS(L / b->sigma_r, 0, b->size_z - 1);
-}
-
 dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
                                   const int height,    // height of input image
                                   const float sigma_s, // spatial sigma (blur pixel coords)
@@ -120,103 +112,134 @@ dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
   return b;
 }
 
-#ifdef _OPENMP
-#pragma omp declare simd aligned(in:64)
-#endif
+// grid slab (lower y index) an image row splats into and reads from
+static inline int grid_slab(const dt_bilateral_t *const b, const int j, float *yf)
+{
+  const int size_y = b->size_y;
+  const float y = CLAMPS(j / b->sigma_s, 0, size_y - 1);
+  const int yi = MIN((int)y, size_y - 2);
+  *yf = y - yi;
+  return yi;
+}
+
 void dt_bilateral_splat(dt_bilateral_t *b, const float *const in)
 {
   const int ox = 1;
   const int oy = b->size_x;
   const int oz = b->size_y * b->size_x;
-  const float sigma_s = b->sigma_s * b->sigma_s;
+  const int width = b->width;
+  const int size_x = b->size_x;
+  const int size_y = b->size_y;
+  const int size_z = b->size_z;
+  const int slabs = size_y - 1;
+  const float sigma_s = b->sigma_s;
+  const float sigma_r = b->sigma_r;
+  const float norm = 100.0f / (sigma_s * sigma_s);
   float *const buf = b->buf;
 
-// splat into downsampled grid
+  // every image row splats into the two grid slabs yi and yi + 1. rows are grouped by yi, one group per
+  // thread, and all groups with even yi run before the ones with odd yi. that way no two threads ever
+  // write to the same slab and the grid needs neither atomics nor per-thread copies.
+  int *const row_start = (int *)malloc(sizeof(int) * (slabs + 1));
+  if(!row_start) return;
+  for(int yi = 0, j = 0; yi < slabs; yi++)
+  {
+    row_start[yi] = j;
+    float yf;
+    while(j < b->height && grid_slab(b, j, &yf) == yi) j++;
+  }
+  row_start[slabs] = b->height;
+
+  for(int parity = 0; parity < 2; parity++)
+  {
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(in, oy, oz, ox, sigma_s, buf) \
-  shared(b) \
-  collapse(2)
+  dt_omp_firstprivate(in, oy, oz, ox, norm, buf, b, width, size_x, size_y, size_z, slabs, sigma_s, sigma_r, \
+                      row_start, parity) \
+  schedule(dynamic)
 #endif
-  for(int j = 0; j < b->height; j++)
-  {
-    for(int i = 0; i < b->width; i++)
+    for(int yi = parity; yi < slabs; yi += 2)
     {
-      size_t index = 4 * (j * b->width + i);
-      float x, y, z;
-      const float L = in[index];
-      image_to_grid(b, i, j, L, &x, &y, &z);
-      const int xi = MIN((int)x, b->size_x - 2);
-      const int yi = MIN((int)y, b->size_y - 2);
-      const int zi = MIN((int)z, b->size_z - 2);
-      const float xf = x - xi;
-      const float yf = y - yi;
-      const float zf = z - zi;
-      // nearest neighbour splatting:
-      const size_t grid_index = xi + b->size_x * (yi + b->size_y * zi);
-      // sum up payload here, doesn't have to be same as edge stopping data
-      // for cross bilateral applications.
-      // also note that this is not clipped (as L->z is), so potentially hdr/out of gamut
-      // should not cause clipping here.
-#ifdef _OPENMP
-#pragma omp simd aligned(buf:64)
-#endif
-      for(int k = 0; k < 8; k++)
+      for(int j = row_start[yi]; j < row_start[yi + 1]; j++)
       {
-        const size_t ii = grid_index + ((k & 1) ? ox : 0) + ((k & 2) ? oy : 0) + ((k & 4) ? oz : 0);
-        const float contrib = ((k & 1) ? xf : (1.0f - xf)) * ((k & 2) ? yf : (1.0f - yf))
-                              * ((k & 4) ? zf : (1.0f - zf)) * 100.0f / sigma_s;
-        buf[ii] += contrib;
+        float yf;
+        grid_slab(b, j, &yf);
+        for(int i = 0; i < width; i++)
+        {
+          const size_t index = 4 * ((size_t)j * width + i);
+          const float L = in[index];
+          const float x = CLAMPS(i / sigma_s, 0, size_x - 1);
+          const float z = CLAMPS(L / sigma_r, 0, size_z - 1);
+          const int xi = MIN((int)x, size_x - 2);
+          const int zi = MIN((int)z, size_z - 2);
+          const float xf = x - xi;
+          const float zf = z - zi;
+          const size_t grid_index = xi + (size_t)size_x * (yi + (size_t)size_y * zi);
+          // sum up payload here, doesn't have to be same as edge stopping data
+          // for cross bilateral applications.
+          // also note that this is not clipped (as L->z is), so potentially hdr/out of gamut
+          // should not cause clipping here.
+          for(int k = 0; k < 8; k++)
+          {
+            const size_t ii = grid_index + ((k & 1) ? ox : 0) + ((k & 2) ? oy : 0) + ((k & 4) ? oz : 0);
+            const float contrib = ((k & 1) ? xf : (1.0f - xf)) * ((k & 2) ? yf : (1.0f - yf))
+                                  * ((k & 4) ? zf : (1.0f - zf)) * norm;
+            buf[ii] += contrib;
+          }
+        }
       }
     }
   }
+
+  free(row_start);
 }
 
-#ifdef _OPENMP
-#pragma omp declare simd aligned(buf:64)
-#endif
-static void blur_line_z(float *buf, const int offset1, const int offset2, const int offset3, const int size1,
-                        const int size2, const int size3)
+// the blurs along y and z run on whole grid rows (all x at once), so the inner loops are contiguous and
+// vectorize. lines start at k * offset1 for k < size1, and have size3 rows of size_x values, offset3 apart.
+// scratch has to hold 4 rows per thread: the zero padding and the original values of the last three rows.
+static void blur_line_rows(float *const buf, float *const scratch, const int offset1, const int offset3,
+                           const int size1, const int size3, const int size_x, const int derivative)
 {
+  const float w0 = derivative ? 0.0f : 6.f / 16.f;
   const float w1 = 4.f / 16.f;
-  const float w2 = 2.f / 16.f;
+  const float w2 = derivative ? 2.f / 16.f : 1.f / 16.f;
+  // the derivative subtracts what the gaussian adds
+  const float sign = derivative ? -1.0f : 1.0f;
+  const size_t stride = dt_round_size_sse((size_t)size_x);
+
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(size1, size2, size3, offset1, offset2, offset3, w1, w2) \
-    shared(buf)
+  dt_omp_firstprivate(buf, scratch, offset1, offset3, size1, size3, size_x, w0, w1, w2, sign, stride) \
+  schedule(static)
 #endif
   for(int k = 0; k < size1; k++)
   {
-    size_t index = (size_t)k * offset1;
-    for(int j = 0; j < size2; j++)
+    float *const zero = scratch + 4 * stride * dt_get_thread_num();
+    float *saved[3] = { zero + stride, zero + 2 * stride, zero + 3 * stride };
+    for(int x = 0; x < size_x; x++) zero[x] = 0.0f;
+
+    // original values of the rows i - 2 and i - 1, zero outside the grid
+    const float *prev2 = zero, *prev1 = zero;
+    for(int i = 0; i < size3; i++)
     {
-      float tmp1 = buf[index];
-      buf[index] = w1 * buf[index + offset3] + w2 * buf[index + 2 * offset3];
-      index += offset3;
-      float tmp2 = buf[index];
-      buf[index] = w1 * (buf[index + offset3] - tmp1) + w2 * buf[index + 2 * offset3];
-      index += offset3;
-      for(int i = 2; i < size3 - 2; i++)
+      float *const row = buf + (size_t)k * offset1 + (size_t)i * offset3;
+      const float *const next1 = i + 1 < size3 ? row + offset3 : zero;
+      const float *const next2 = i + 2 < size3 ? row + 2 * offset3 : zero;
+      float *const cur = saved[i % 3];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int x = 0; x < size_x; x++)
       {
-        const float tmp3 = buf[index];
-        buf[index] = +w1 * (buf[index + offset3] - tmp2) + w2 * (buf[index + 2 * offset3] - tmp1);
-        index += offset3;
-        tmp1 = tmp2;
-        tmp2 = tmp3;
+        cur[x] = row[x];
+        row[x] = w0 * row[x] + w1 * (next1[x] + sign * prev1[x]) + w2 * (next2[x] + sign * prev2[x]);
       }
-      const float tmp3 = buf[index];
-      buf[index] = w1 * (buf[index + offset3] - tmp2) - w2 * tmp1;
-      index += offset3;
-      buf[index] = -w1 * tmp3 - w2 * tmp2;
-      index += offset3;
-      index += offset2 - offset3 * size3;
+      prev2 = prev1;
+      prev1 = cur;
     }
   }
 }
 
-#ifdef _OPENMP
-#pragma omp declare simd aligned(buf:64)
-#endif
 static void blur_line(float *buf, const int offset1, const int offset2, const int offset3, const int size1,
                       const int size2, const int size3)
 {
@@ -261,12 +284,24 @@ static void blur_line(float *buf, const int offset1, const int offset2, const in
 
 void dt_bilateral_blur(dt_bilateral_t *b)
 {
+  const int size_x = b->size_x, size_y = b->size_y, size_z = b->size_z;
+  const int oz = size_x * size_y;
+  float *const scratch = dt_alloc_align(64, sizeof(float) * 4 * dt_round_size_sse((size_t)size_x)
+                                                * dt_get_num_threads());
+
+  if(!scratch)
+  {
+    fprintf(stderr, "[bilateral] could not allocate blur buffers\n");
+    return;
+  }
+
+  // gaussian up to 3 sigma. x is the contiguous axis, so this one stays a scalar recursion per line.
+  blur_line(b->buf, oz, size_x, 1, size_z, size_y, size_x);
   // gaussian up to 3 sigma
-  blur_line(b->buf, b->size_x * b->size_y, b->size_x, 1, b->size_z, b->size_y, b->size_x);
-  // gaussian up to 3 sigma
-  blur_line(b->buf, b->size_x * b->size_y, 1, b->size_x, b->size_z, b->size_x, b->size_y);
+  blur_line_rows(b->buf, scratch, oz, size_x, size_z, size_y, size_x, FALSE);
   // -2 derivative of the gaussian up to 3 sigma: x*exp(-x*x)
-  blur_line_z(b->buf, 1, b->size_x, b->size_x * b->size_y, b->size_x, b->size_y, b->size_z);
+  blur_line_rows(b->buf, scratch, size_x, oz, size_y, size_z, size_x, TRUE);
+  dt_free_align(scratch);
 }
 
 
@@ -282,46 +317,54 @@ void dt_bilateral_slice(const dt_bilateral_t *const b, const float *const in, fl
   const int oz = b->size_y * b->size_x;
   float *const buf = b->buf;
   const int size_x = b->size_x;
-  const int size_y = b->size_y;
   const int size_z = b->size_z;
   const int width = b->width;
   const int height = b->height;
+  const float sigma_s = b->sigma_s;
+  const float sigma_r = b->sigma_r;
 
+  // y only changes per row, the lookups along a row vectorize as gathers.
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(b, in, norm, ox, oy, oz, size_x, size_y, size_z, height, width, buf) \
-    shared(out) collapse(2)
+  dt_omp_firstprivate(b, in, norm, ox, oy, oz, size_x, size_z, height, width, buf, sigma_s, sigma_r) \
+    shared(out) schedule(static)
 #endif
   for(int j = 0; j < height; j++)
   {
+    float yf;
+    const int yi = grid_slab(b, j, &yf);
+    const float *const slab = buf + (size_t)yi * oy;
+    const float *const pin = in + (size_t)4 * j * width;
+    float *const pout = out + (size_t)4 * j * width;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
     for(int i = 0; i < width; i++)
     {
-      size_t index = 4 * (j * width + i);
-      float x, y, z;
-      const float L = in[index];
-      image_to_grid(b, i, j, L, &x, &y, &z);
+      const float L = pin[4 * i];
       // trilinear lookup:
+      const float x = CLAMPS(i / sigma_s, 0, size_x - 1);
+      const float z = CLAMPS(L / sigma_r, 0, size_z - 1);
       const int xi = MIN((int)x, size_x - 2);
-      const int yi = MIN((int)y, size_y - 2);
       const int zi = MIN((int)z, size_z - 2);
       const float xf = x - xi;
-      const float yf = y - yi;
       const float zf = z - zi;
-      const size_t gi = xi + size_x * (yi + size_y * zi);
+      const size_t gi = xi + (size_t)oz * zi;
       const float Lout = L
-                         + norm * (buf[gi] * (1.0f - xf) * (1.0f - yf) * (1.0f - zf)
-                                   + buf[gi + ox] * (xf) * (1.0f - yf) * (1.0f - zf)
-                                   + buf[gi + oy] * (1.0f - xf) * (yf) * (1.0f - zf)
-                                   + buf[gi + ox + oy] * (xf) * (yf) * (1.0f - zf)
-                                   + buf[gi + oz] * (1.0f - xf) * (1.0f - yf) * (zf)
-                                   + buf[gi + ox + oz] * (xf) * (1.0f - yf) * (zf)
-                                   + buf[gi + oy + oz] * (1.0f - xf) * (yf) * (zf)
-                                   + buf[gi + ox + oy + oz] * (xf) * (yf) * (zf));
-      out[index] = Lout;
+                         + norm * (slab[gi] * (1.0f - xf) * (1.0f - yf) * (1.0f - zf)
+                                   + slab[gi + ox] * (xf) * (1.0f - yf) * (1.0f - zf)
+                                   + slab[gi + oy] * (1.0f - xf) * (yf) * (1.0f - zf)
+                                   + slab[gi + ox + oy] * (xf) * (yf) * (1.0f - zf)
+                                   + slab[gi + oz] * (1.0f - xf) * (1.0f - yf) * (zf)
+                                   + slab[gi + ox + oz] * (xf) * (1.0f - yf) * (zf)
+                                   + slab[gi + oy + oz] * (1.0f - xf) * (yf) * (zf)
+                                   + slab[gi + ox + oy + oz] * (xf) * (yf) * (zf));
       // and copy color and mask
-      out[index + 1] = in[index + 1];
-      out[index + 2] = in[index + 2];
-      out[index + 3] = in[index + 3];
+      const float c1 = pin[4 * i + 1], c2 = pin[4 * i + 2], c3 = pin[4 * i + 3];
+      pout[4 * i] = Lout;
+      pout[4 * i + 1] = c1;
+      pout[4 * i + 2] = c2;
+      pout[4 * i + 3] = c3;
     }
   }
 }
@@ -339,41 +382,47 @@ void dt_bilateral_slice_to_output(const dt_bilateral_t *const b, const float *co
   const int oz = b->size_y * b->size_x;
   float *const buf = b->buf;
   const int size_x = b->size_x;
-  const int size_y = b->size_y;
   const int size_z = b->size_z;
   const int width = b->width;
   const int height = b->height;
+  const float sigma_s = b->sigma_s;
+  const float sigma_r = b->sigma_r;
 
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(b, in, norm, oy, oz, ox, buf, size_x, size_y, size_z, width, height) \
-  shared(out) collapse(2)
+  dt_omp_firstprivate(b, in, norm, oy, oz, ox, buf, size_x, size_z, width, height, sigma_s, sigma_r) \
+  shared(out) schedule(static)
 #endif
   for(int j = 0; j < height; j++)
   {
+    float yf;
+    const int yi = grid_slab(b, j, &yf);
+    const float *const slab = buf + (size_t)yi * oy;
+    const float *const pin = in + (size_t)4 * j * width;
+    float *const pout = out + (size_t)4 * j * width;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
     for(int i = 0; i < width; i++)
     {
-      size_t index = 4 * (j * width + i);
-      float x, y, z;
-      const float L = in[index];
-      image_to_grid(b, i, j, L, &x, &y, &z);
+      const float L = pin[4 * i];
       // trilinear lookup:
+      const float x = CLAMPS(i / sigma_s, 0, size_x - 1);
+      const float z = CLAMPS(L / sigma_r, 0, size_z - 1);
       const int xi = MIN((int)x, size_x - 2);
-      const int yi = MIN((int)y, size_y - 2);
       const int zi = MIN((int)z, size_z - 2);
       const float xf = x - xi;
-      const float yf = y - yi;
       const float zf = z - zi;
-      const size_t gi = xi + size_x * (yi + size_y * zi);
-      const float Lout = norm * (buf[gi] * (1.0f - xf) * (1.0f - yf) * (1.0f - zf)
-                                 + buf[gi + ox] * (xf) * (1.0f - yf) * (1.0f - zf)
-                                 + buf[gi + oy] * (1.0f - xf) * (yf) * (1.0f - zf)
-                                 + buf[gi + ox + oy] * (xf) * (yf) * (1.0f - zf)
-                                 + buf[gi + oz] * (1.0f - xf) * (1.0f - yf) * (zf)
-                                 + buf[gi + ox + oz] * (xf) * (1.0f - yf) * (zf)
-                                 + buf[gi + oy + oz] * (1.0f - xf) * (yf) * (zf)
-                                 + buf[gi + ox + oy + oz] * (xf) * (yf) * (zf));
-      out[index] = MAX(0.0f, out[index] + Lout);
+      const size_t gi = xi + (size_t)oz * zi;
+      const float Lout = norm * (slab[gi] * (1.0f - xf) * (1.0f - yf) * (1.0f - zf)
+                                 + slab[gi + ox] * (xf) * (1.0f - yf) * (1.0f - zf)
+                                 + slab[gi + oy] * (1.0f - xf) * (yf) * (1.0f - zf)
+                                 + slab[gi + ox + oy] * (xf) * (yf) * (1.0f - zf)
+                                 + slab[gi + oz] * (1.0f - xf) * (1.0f - yf) * (zf)
+                                 + slab[gi + ox + oz] * (xf) * (1.0f - yf) * (zf)
+                                 + slab[gi + oy + oz] * (1.0f - xf) * (yf) * (zf)
+                                 + slab[gi + ox + oy + oz] * (xf) * (yf) * (zf));
+      pout[4 * i] = MAX(0.0f, pout[4 * i] + Lout);
     }
   }
 }
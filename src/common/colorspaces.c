@@ -1284,7 +1284,21 @@ static gint _sort_profiles(gconstpointer a, gconstpointer b)
   return result;
 }
 
-static GList *load_profile_from_dir(const char *subdir)
+// parses an icc file. the profile lists only need the name, so that's all which gets done at startup, the
+// profile itself is only opened once it's asked for.
+static cmsHPROFILE _load_profile_file(const char *filename)
+{
+  // TODO: add support for grayscale profiles, then remove _ensure_rgb_profile() from here
+  gchar *icc_content = NULL;
+  gsize size = 0;
+  if(!g_file_get_contents(filename, &icc_content, &size, NULL)) return NULL;
+  cmsHPROFILE profile = _ensure_rgb_profile(cmsOpenProfileFromMem(icc_content, size));
+  g_free(icc_content);
+  return profile;
+}
+
+static GList *load_profile_from_dir(const char *subdir, GKeyFile *registry, GKeyFile *new_registry,
+                                    gboolean *registry_changed)
 {
   GList *temp_profiles = NULL;
   const gchar *d_name;
@@ -1310,32 +1324,46 @@ static GList *load_profile_from_dir(const char *subdir)
       const char *cc = filename + strlen(filename);
       for(; *cc != '.' && cc > filename; cc--)
         ;
-      if(!g_ascii_strcasecmp(cc, ".icc") || !g_ascii_strcasecmp(cc, ".icm"))
+      GStatBuf st;
+      if((!g_ascii_strcasecmp(cc, ".icc") || !g_ascii_strcasecmp(cc, ".icm")) && !g_stat(filename, &st))
       {
-        // TODO: add support for grayscale profiles, then remove _ensure_rgb_profile() from here
-        char *icc_content = NULL;
-        cmsHPROFILE tmpprof;
-
-        FILE *fd = g_fopen(filename, "rb");
-        if(!fd) goto icc_loading_done;
-
-        fseek(fd, 0, SEEK_END);
-        size_t end = ftell(fd);
-        rewind(fd);
+        cmsHPROFILE tmpprof = NULL;
+        gchar *name = NULL;
+        gboolean valid = FALSE;
+
+        // files which didn't change since they were last seen keep their registry entry
+        gchar *registry_lang = g_key_file_get_value(registry, filename, "lang", NULL);
+        if(g_key_file_get_int64(registry, filename, "mtime", NULL) == st.st_mtime
+           && g_key_file_get_int64(registry, filename, "size", NULL) == st.st_size
+           && !g_strcmp0(registry_lang, lang))
+        {
+          valid = g_key_file_get_boolean(registry, filename, "valid", NULL);
+          name = g_key_file_get_string(registry, filename, "name", NULL);
+        }
+        else
+        {
+          tmpprof = _load_profile_file(filename);
+          valid = (tmpprof != NULL);
+          name = g_malloc0(512);
+          if(tmpprof) dt_colorspaces_get_profile_name(tmpprof, lang, lang + 3, name, 512);
+          *registry_changed = TRUE;
+        }
+        g_free(registry_lang);
 
-        icc_content = (char *)malloc(end * sizeof(char));
-        if(!icc_content) goto icc_loading_done;
-        if(fread(icc_content, sizeof(char), end, fd) != end) goto icc_loading_done;
+        // unreadable files are remembered as well, so they don't get parsed again on every start
+        g_key_file_set_int64(new_registry, filename, "mtime", st.st_mtime);
+        g_key_file_set_int64(new_registry, filename, "size", st.st_size);
+        g_key_file_set_value(new_registry, filename, "lang", lang);
+        g_key_file_set_boolean(new_registry, filename, "valid", valid);
+        g_key_file_set_string(new_registry, filename, "name", name ? name : "");
 
-        tmpprof = _ensure_rgb_profile(cmsOpenProfileFromMem(icc_content, end * sizeof(char)));
-        if(tmpprof)
+        if(valid)
         {
           dt_colorspaces_color_profile_t *prof = (dt_colorspaces_color_profile_t *)calloc(1, sizeof(dt_colorspaces_color_profile_t));
-          dt_colorspaces_get_profile_name(tmpprof, lang, lang + 3, prof->name, sizeof(prof->name));
-
+          g_strlcpy(prof->name, name ? name : "", sizeof(prof->name));
           g_strlcpy(prof->filename, filename, sizeof(prof->filename));
           prof->type = DT_COLORSPACE_FILE;
-          prof->profile = tmpprof;
+          prof->profile = tmpprof; // NULL until it is used, see _get_profile()
           // these will be set after sorting!
           prof->in_pos = -1;
           prof->out_pos = -1;
@@ -1345,10 +1373,7 @@ static GList *load_profile_from_dir(const char *subdir)
           prof->work_pos = -1;
           temp_profiles = g_list_append(temp_profiles, prof);
         }
-
-icc_loading_done:
-        if(fd) fclose(fd);
-        free(icc_content);
+        g_free(name);
       }
       g_free(filename);
     }
@@ -1359,6 +1384,13 @@ icc_loading_done:
   return temp_profiles;
 }
 
+static void _registry_filename(char *filename, size_t size)
+{
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  snprintf(filename, size, "%s/%s", cachedir, "icc_profiles.cache");
+}
+
 dt_colorspaces_t *dt_colorspaces_init()
 {
   cmsSetLogErrorHandler(cms_error_handler);
@@ -1368,6 +1400,7 @@ dt_colorspaces_t *dt_colorspaces_init()
   _compute_prequantized_primaries(&D65xyY, &Rec709_Primaries, &Rec709_Primaries_Prequantized);
 
   pthread_rwlock_init(&res->xprofile_lock, NULL);
+  pthread_mutex_init(&res->profiles_lock, NULL);
 
   int in_pos = -1,
       out_pos = -1,
@@ -1471,8 +1504,16 @@ dt_colorspaces_t *dt_colorspaces_init()
   // temporary list of profiles to be added, we keep this separate to be able to sort it before adding
   GList *temp_profiles;
 
+  // what is known about the icc files from the last start. it's rebuilt from scratch to drop removed files
+  char registry_filename[PATH_MAX] = { 0 };
+  _registry_filename(registry_filename, sizeof(registry_filename));
+  GKeyFile *registry = g_key_file_new();
+  GKeyFile *new_registry = g_key_file_new();
+  g_key_file_load_from_file(registry, registry_filename, G_KEY_FILE_NONE, NULL);
+  gboolean registry_changed = FALSE;
+
   // read {userconfig,datadir}/color/in/*.icc, in this order.
-  temp_profiles = load_profile_from_dir("in");
+  temp_profiles = load_profile_from_dir("in", registry, new_registry, &registry_changed);
   for(GList *iter = temp_profiles; iter; iter = g_list_next(iter))
   {
     dt_colorspaces_color_profile_t *prof = (dt_colorspaces_color_profile_t *)iter->data;
@@ -1481,7 +1522,7 @@ dt_colorspaces_t *dt_colorspaces_init()
   res->profiles = g_list_concat(res->profiles, temp_profiles);
 
   // read {conf,data}dir/color/out/*.icc
-  temp_profiles = load_profile_from_dir("out");
+  temp_profiles = load_profile_from_dir("out", registry, new_registry, &registry_changed);
   for(GList *iter = temp_profiles; iter; iter = g_list_next(iter))
   {
     dt_colorspaces_color_profile_t *prof = (dt_colorspaces_color_profile_t *)iter->data;
@@ -1493,6 +1534,13 @@ dt_colorspaces_t *dt_colorspaces_init()
   }
   res->profiles = g_list_concat(res->profiles, temp_profiles);
 
+  gsize n_old = 0, n_new = 0;
+  g_strfreev(g_key_file_get_groups(registry, &n_old));
+  g_strfreev(g_key_file_get_groups(new_registry, &n_new));
+  if(registry_changed || n_old != n_new) g_key_file_save_to_file(new_registry, registry_filename, NULL);
+  g_key_file_free(registry);
+  g_key_file_free(new_registry);
+
   // init display profile and softproof/gama checking from conf
   res->display_type = dt_conf_get_int("ui_last/color/display_type");
   res->display2_type = dt_conf_get_int("ui_last/color/display2_type");
@@ -1581,6 +1629,7 @@ void dt_colorspaces_cleanup(dt_colorspaces_t *self)
   g_list_free_full(self->profiles, free);
 
   pthread_rwlock_destroy(&self->xprofile_lock);
+  pthread_mutex_destroy(&self->profiles_lock);
   g_free(self->colord_profile_file);
   g_free(self->xprofile_data);
 
@@ -1960,6 +2009,20 @@ static const dt_colorspaces_color_profile_t *_get_profile(dt_colorspaces_t *self
        && (p->type == type
            && (type != DT_COLORSPACE_FILE || dt_colorspaces_is_profile_equal(p->filename, filename))))
     {
+      if(type == DT_COLORSPACE_FILE)
+      {
+        // icc files are opened on first use, all pipes share the handle from then on
+        pthread_mutex_lock(&self->profiles_lock);
+        if(!p->profile)
+        {
+          p->profile = _load_profile_file(p->filename);
+          dt_print(DT_DEBUG_DEV, "[colorspaces] opened profile `%s'%s\n", p->filename,
+                   p->profile ? "" : " failed");
+        }
+        const gboolean loaded = (p->profile != NULL);
+        pthread_mutex_unlock(&self->profiles_lock);
+        if(!loaded) return NULL;
+      }
       return p;
     }
   }
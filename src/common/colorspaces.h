@@ -105,6 +105,8 @@ typedef enum dt_colorspaces_profile_direction_t
 typedef struct dt_colorspaces_t
 {
   GList *profiles;
+  // icc files are only opened when they are used for the first time
+  pthread_mutex_t profiles_lock;
 
   // xatom color profile:
   pthread_rwlock_t xprofile_lock;
@@ -142,7 +144,7 @@ typedef struct dt_colorspaces_color_profile_t
   // must be in synch with DT_IOPPR_COLOR_ICC_LEN in iop_order.h
   char filename[512];                       // icc file name
   char name[512];                           // product name, displayed in GUI
-  cmsHPROFILE profile;                      // the actual profile
+  cmsHPROFILE profile;                      // the actual profile, for files NULL until it gets used
   int in_pos;                               // position in input combo box, -1 if not applicable
   int out_pos;                              // position in output combo box, -1 if not applicable
   int display_pos;                          // position in display combo box, -1 if not applicable
@@ -58,6 +58,8 @@ dt_cpu_flags_t dt_detect_cpu_features()
       if(cx & 0x00080000) cpuflags |= CPU_FLAG_SSE4_2;
 
       if(cx & 0x08000000) cpuflags |= CPU_FLAG_AVX;
+      // vex encoded like avx, so it needs the os to save the avx state (osxsave) as well
+      if((cx & 0x38000000) == 0x38000000) cpuflags |= CPU_FLAG_F16C;
     }
 
     /* Are there extensions? */
@@ -55,6 +55,7 @@
 #include "common/opencl.h"
 #include "common/points.h"
 #include "common/resource_limits.h"
+#include "common/tags.h"
 #include "common/undo.h"
 #include "control/conf.h"
 #include "control/control.h"
@@ -313,9 +314,16 @@ static void dt_codepaths_init()
 #endif
   }
 
+#if defined(__F16C__)
+  darktable.codepath.F16C = 1;
+#elif defined(__i386__) || defined(__x86_64__)
+  // not every compiler knows f16c for __builtin_cpu_supports()
+  darktable.codepath.F16C = (dt_detect_cpu_features() & CPU_FLAG_F16C) != 0;
+#endif
+
   // second, apply overrides from conf
   // NOTE: all intrinsics sets can only be overridden to OFF
-  if(!dt_conf_get_bool("codepaths/sse2")) darktable.codepath.SSE2 = 0;
+  if(!dt_conf_get_bool("codepaths/sse2")) darktable.codepath.SSE2 = darktable.codepath.F16C = 0;
 
   // last: do we have any intrinsics sets enabled?
   darktable.codepath._no_intrinsics = !(darktable.codepath.SSE2);
@@ -874,15 +882,6 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   // Initialize the signal system
   darktable.signals = dt_control_signal_init();
 
-  // Make sure that the database and xmp files are in sync
-  // We need conf and db to be up and running for that which is the case here.
-  // FIXME: is this also useful in non-gui mode?
-  GList *changed_xmp_files = NULL;
-  if(init_gui && dt_conf_get_bool("run_crawler_on_start"))
-  {
-    changed_xmp_files = dt_control_crawler_run();
-  }
-
   if(init_gui)
   {
     dt_control_init(darktable.control);
@@ -928,7 +927,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   darktable.points = (dt_points_t *)calloc(1, sizeof(dt_points_t));
   dt_points_init(darktable.points, dt_get_num_threads());
 
-  darktable.noiseprofile_parser = dt_noiseprofile_init(noiseprofiles_from_command);
+  darktable.noiseprofiles = dt_noiseprofile_init(noiseprofiles_from_command);
 
   // must come before mipmap_cache, because that one will need to access
   // image dimensions stored in here:
@@ -1082,11 +1081,12 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 #endif
   }
 
-  // last but not least construct the popup that asks the user about images whose xmp files are newer than the
-  // db entry
-  if(init_gui && changed_xmp_files)
+  // last but not least make sure that the database and xmp files are in sync. this runs in the background and
+  // asks the user about images whose xmp files are newer than the db entry once it is done.
+  // FIXME: is this also useful in non-gui mode?
+  if(init_gui && dt_conf_get_bool("run_crawler_on_start"))
   {
-    dt_control_crawler_show_image_list(changed_xmp_files);
+    dt_control_crawler_start();
   }
 
   dt_print(DT_DEBUG_CONTROL, "[init] startup took %f seconds\n", dt_get_wtime() - start_wtime);
@@ -1110,6 +1110,8 @@ void dt_cleanup()
     dt_ctl_switch_mode_to("");
     dt_dbus_destroy(darktable.dbus);
 
+    // leaving the view might have queued some more sidecar writes
+    dt_control_flush_sidecar_files();
     dt_control_shutdown(darktable.control);
 
     dt_lib_cleanup(darktable.lib);
@@ -1141,6 +1143,9 @@ void dt_cleanup()
   free(darktable.conf);
   dt_points_cleanup(darktable.points);
   free(darktable.points);
+  dt_noiseprofile_cleanup(darktable.noiseprofiles);
+  darktable.noiseprofiles = NULL;
+  dt_tag_index_invalidate();
   dt_iop_unload_modules_so();
   g_list_free_full(darktable.iop_order_list, free);
   darktable.iop_order_list = NULL;
@@ -230,6 +230,7 @@ typedef struct dt_codepath_t
 {
   unsigned int SSE2 : 1;
   unsigned int _no_intrinsics : 1;
+  unsigned int F16C : 1; // half float conversions in common/half.h, not a codepath of its own
   unsigned int OPENMP_SIMD : 1; // always stays the last one
 } dt_codepath_t;
 
@@ -243,7 +244,7 @@ typedef struct darktable_t
   GList *iop_order_list;
   GList *iop_order_rules;
   GList *capabilities;
-  JsonParser *noiseprofile_parser;
+  struct dt_noiseprofile_table_t *noiseprofiles;
   struct dt_conf_t *conf;
   struct dt_develop_t *develop;
   struct dt_lib_t *lib;
@@ -43,8 +43,8 @@
 
 // whenever _create_*_schema() gets changed you HAVE to bump this version and add an update path to
 // _upgrade_*_schema_step()!
-#define CURRENT_DATABASE_VERSION_LIBRARY 21
-#define CURRENT_DATABASE_VERSION_DATA 4
+#define CURRENT_DATABASE_VERSION_LIBRARY 22
+#define CURRENT_DATABASE_VERSION_DATA 5
 
 typedef struct dt_database_t
 {
@@ -1187,6 +1187,17 @@ static int _upgrade_library_schema_step(dt_database_t *db, int version)
     sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
     new_version = 21;
   }
+  else if(version == 21)
+  {
+    sqlite3_exec(db->handle, "BEGIN TRANSACTION", NULL, NULL, NULL);
+
+    TRY_EXEC("CREATE TABLE main.embedded_thumbnails (imgid INTEGER PRIMARY KEY, offset INTEGER, size INTEGER, "
+             "mtime INTEGER)",
+             "[init] can't create table embedded_thumbnails\n");
+
+    sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
+    new_version = 22;
+  }
   else
     new_version = version; // should be the fallback so that calling code sees that we are in an infinite loop
 
@@ -1322,6 +1333,13 @@ static int _upgrade_data_schema_step(dt_database_t *db, int version)
 
     new_version = 4;
   }
+  else if(version == 4)
+  {
+    TRY_EXEC("CREATE TABLE data.module_manifest (kind VARCHAR, operation VARCHAR, hash INTEGER, "
+             "PRIMARY KEY (kind, operation))",
+             "[init] can't create module_manifest table\n");
+    new_version = 5;
+  }
   else
     new_version = version; // should be the fallback so that calling code sees that we are in an infinite loop
 
@@ -1445,6 +1463,10 @@ static void _create_library_schema(dt_database_t *db)
   ////////////////////////////// meta_data
   sqlite3_exec(db->handle, "CREATE TABLE main.meta_data (id INTEGER, key INTEGER, value VARCHAR)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE INDEX main.metadata_index ON meta_data (id, key)", NULL, NULL, NULL);
+  ////////////////////////////// embedded_thumbnails
+  sqlite3_exec(db->handle, "CREATE TABLE main.embedded_thumbnails (imgid INTEGER PRIMARY KEY, offset INTEGER, "
+                           "size INTEGER, mtime INTEGER)",
+               NULL, NULL, NULL);
 }
 
 /* create the current database schema and set the version in db_info accordingly */
@@ -1486,6 +1508,10 @@ static void _create_data_schema(dt_database_t *db)
                NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE UNIQUE INDEX data.presets_idx ON presets (name, operation, op_version)",
                NULL, NULL, NULL);
+  ////////////////////////////// module_manifest
+  sqlite3_exec(db->handle, "CREATE TABLE data.module_manifest (kind VARCHAR, operation VARCHAR, hash INTEGER, "
+                           "PRIMARY KEY (kind, operation))",
+               NULL, NULL, NULL);
 }
 
 // create the in-memory tables
@@ -1521,6 +1547,21 @@ static void _create_memory_schema(dt_database_t *db)
       "CREATE TABLE memory.undo_masks_history (id INTEGER, imgid INTEGER, num INTEGER, formid INTEGER, form INTEGER, "
       "name VARCHAR(256), version INTEGER, points BLOB, points_count INTEGER, source BLOB)",
       NULL, NULL, NULL);
+  // film rolls which got images added, removed or moved, or their folder renamed, since the collect module last
+  // counted them. temp triggers may not name a database, the unqualified table resolves to the memory one.
+  sqlite3_exec(db->handle, "CREATE TABLE memory.film_rolls_changed (id INTEGER PRIMARY KEY)", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE TEMP TRIGGER images_film_insert AFTER INSERT ON main.images"
+                           " BEGIN INSERT OR IGNORE INTO film_rolls_changed (id) VALUES (new.film_id); END",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE TEMP TRIGGER images_film_delete AFTER DELETE ON main.images"
+                           " BEGIN INSERT OR IGNORE INTO film_rolls_changed (id) VALUES (old.film_id); END",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE TEMP TRIGGER images_film_update AFTER UPDATE OF film_id ON main.images"
+                           " BEGIN INSERT OR IGNORE INTO film_rolls_changed (id) VALUES (old.film_id), (new.film_id); END",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE TEMP TRIGGER film_rolls_folder_update AFTER UPDATE OF folder ON main.film_rolls"
+                           " BEGIN INSERT OR IGNORE INTO film_rolls_changed (id) VALUES (new.id); END",
+               NULL, NULL, NULL);
 }
 
 static void _sanitize_db(dt_database_t *db)
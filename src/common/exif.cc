@@ -1309,8 +1309,46 @@ int dt_exif_read_from_blob(dt_image_t *img, uint8_t *blob, const int size)
 /**
  * Get the largest possible thumbnail from the image
  */
+// offset of a preview of the given size in the file, taken from the tags pointing to it. these are relative
+// to the tiff header, which is where the file starts for the tiff based raws. -1 if no tags match.
+static int64_t _exif_thumbnail_offset(Exiv2::ExifData &exifData, const size_t size)
+{
+  static const char *keys[][2] = {
+    { "Exif.Image.JPEGInterchangeFormat", "Exif.Image.JPEGInterchangeFormatLength" },
+    { "Exif.SubImage1.JPEGInterchangeFormat", "Exif.SubImage1.JPEGInterchangeFormatLength" },
+    { "Exif.SubImage2.JPEGInterchangeFormat", "Exif.SubImage2.JPEGInterchangeFormatLength" },
+    { "Exif.SubImage3.JPEGInterchangeFormat", "Exif.SubImage3.JPEGInterchangeFormatLength" },
+    { "Exif.Image2.JPEGInterchangeFormat", "Exif.Image2.JPEGInterchangeFormatLength" },
+    { "Exif.Image3.JPEGInterchangeFormat", "Exif.Image3.JPEGInterchangeFormatLength" },
+    { "Exif.Thumbnail.JPEGInterchangeFormat", "Exif.Thumbnail.JPEGInterchangeFormatLength" },
+    // previews in a single strip of their own directory
+    { "Exif.SubImage1.StripOffsets", "Exif.SubImage1.StripByteCounts" },
+    { "Exif.SubImage2.StripOffsets", "Exif.SubImage2.StripByteCounts" },
+    { "Exif.SubImage3.StripOffsets", "Exif.SubImage3.StripByteCounts" },
+    { "Exif.Image2.StripOffsets", "Exif.Image2.StripByteCounts" },
+    { "Exif.Image3.StripOffsets", "Exif.Image3.StripByteCounts" }
+  };
+
+  for(size_t k = 0; k < G_N_ELEMENTS(keys); k++)
+  {
+    Exiv2::ExifData::const_iterator offset = exifData.findKey(Exiv2::ExifKey(keys[k][0]));
+    if(offset == exifData.end() || offset->count() != 1) continue;
+    Exiv2::ExifData::const_iterator length = exifData.findKey(Exiv2::ExifKey(keys[k][1]));
+    if(length == exifData.end() || length->count() != 1) continue;
+    if(length->toLong() == (long)size && offset->toLong() > 0) return offset->toLong();
+  }
+  return -1;
+}
+
 int dt_exif_get_thumbnail(const char *path, uint8_t **buffer, size_t *size, char **mime_type)
 {
+  return dt_exif_get_thumbnail_ext(path, buffer, size, mime_type, NULL);
+}
+
+int dt_exif_get_thumbnail_ext(const char *path, uint8_t **buffer, size_t *size, char **mime_type,
+                              int64_t *offset)
+{
+  if(offset) *offset = -1;
   try
   {
     std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
@@ -1347,6 +1385,8 @@ int dt_exif_get_thumbnail(const char *path, uint8_t **buffer, size_t *size, char
     //std::cerr << "[exiv2] "<< path << ": found thumbnail "<< preview.width() << "x" << preview.height() << std::endl;
     memcpy(*buffer, tmp, _size);
 
+    if(offset) *offset = _exif_thumbnail_offset(image->exifData(), _size);
+
     return 0;
   }
   catch(Exiv2::AnyError &e)
@@ -1413,6 +1453,35 @@ int dt_exif_read(dt_image_t *img, const char *path)
   }
 }
 
+// drops what should not end up in the exif of an exported image
+static void _exif_export_cleanup(Exiv2::ExifData &exifData, const int compressed)
+{
+  {
+    // Remove thumbnail
+    static const char *keys[] = {
+      "Exif.Thumbnail.Compression",
+      "Exif.Thumbnail.XResolution",
+      "Exif.Thumbnail.YResolution",
+      "Exif.Thumbnail.ResolutionUnit",
+      "Exif.Thumbnail.JPEGInterchangeFormat",
+      "Exif.Thumbnail.JPEGInterchangeFormatLength"
+    };
+    static const guint n_keys = G_N_ELEMENTS(keys);
+    dt_remove_exif_keys(exifData, keys, n_keys);
+  }
+
+  // only compressed images may set PixelXDimension and PixelYDimension
+  if(!compressed)
+  {
+    static const char *keys[] = {
+      "Exif.Photo.PixelXDimension",
+      "Exif.Photo.PixelYDimension"
+    };
+    static const guint n_keys = G_N_ELEMENTS(keys);
+    dt_remove_exif_keys(exifData, keys, n_keys);
+  }
+}
+
 int dt_exif_write_blob(uint8_t *blob, uint32_t size, const char *path, const int compressed)
 {
   try
@@ -1434,30 +1503,7 @@ int dt_exif_write_blob(uint8_t *blob, uint32_t size, const char *path, const int
       imgExifData.add(Exiv2::ExifKey(i->key()), &i->value());
     }
 
-    {
-      // Remove thumbnail
-      static const char *keys[] = {
-        "Exif.Thumbnail.Compression",
-        "Exif.Thumbnail.XResolution",
-        "Exif.Thumbnail.YResolution",
-        "Exif.Thumbnail.ResolutionUnit",
-        "Exif.Thumbnail.JPEGInterchangeFormat",
-        "Exif.Thumbnail.JPEGInterchangeFormatLength"
-      };
-      static const guint n_keys = G_N_ELEMENTS(keys);
-      dt_remove_exif_keys(imgExifData, keys, n_keys);
-    }
-
-    // only compressed images may set PixelXDimension and PixelYDimension
-    if(!compressed)
-    {
-      static const char *keys[] = {
-        "Exif.Photo.PixelXDimension",
-        "Exif.Photo.PixelYDimension"
-      };
-      static const guint n_keys = G_N_ELEMENTS(keys);
-      dt_remove_exif_keys(imgExifData, keys, n_keys);
-    }
+    _exif_export_cleanup(imgExifData, compressed);
 
     imgExifData.sortByTag();
     image->writeMetadata();
@@ -2031,6 +2077,7 @@ static void _exif_import_tags(dt_image_t *img, Exiv2::XmpData::iterator &pos)
   sqlite3_finalize(stmt_sel_id);
   sqlite3_finalize(stmt_ins_tags);
   sqlite3_finalize(stmt_ins_tagged);
+  dt_tag_index_invalidate();
 }
 
 typedef struct history_entry_t
@@ -3558,139 +3605,142 @@ static void dt_remove_exif_key(Exiv2::ExifData &exif, const char *key)
   }
 }
 
-int dt_exif_xmp_attach_export(const int imgid, const char *filename, void *metadata)
+// fills in the metadata of an exported image: xmp and iptc of the original file, overwritten by the
+// sidecar and the database, and the exif adjusted to the export settings in m
+static void _exif_xmp_export_data(const int imgid, dt_export_metadata_t *m, Exiv2::ExifData &exifData,
+                                  Exiv2::XmpData &xmpData, Exiv2::IptcData &iptcData)
 {
-  dt_export_metadata_t *m = (dt_export_metadata_t *)metadata;
+  char input_filename[PATH_MAX] = { 0 };
+  gboolean from_cache = TRUE;
+  dt_image_full_path(imgid, input_filename, sizeof(input_filename), &from_cache);
+
   try
   {
-    char input_filename[PATH_MAX] = { 0 };
-    gboolean from_cache = TRUE;
-    dt_image_full_path(imgid, input_filename, sizeof(input_filename), &from_cache);
-
-    std::unique_ptr<Exiv2::Image> img(Exiv2::ImageFactory::open(WIDEN(filename)));
-    // unfortunately it seems we have to read the metadata, to not erase the exif (which we just wrote).
-    // will make export slightly slower, oh well.
-    // img->clearXmpPacket();
-    read_metadata_threadsafe(img);
-
-    try
+    // initialize XMP and IPTC data with the one from the original file
+    std::unique_ptr<Exiv2::Image> input_image(Exiv2::ImageFactory::open(WIDEN(input_filename)));
+    if(input_image.get() != 0)
     {
-      // initialize XMP and IPTC data with the one from the original file
-      std::unique_ptr<Exiv2::Image> input_image(Exiv2::ImageFactory::open(WIDEN(input_filename)));
-      if(input_image.get() != 0)
-      {
-        read_metadata_threadsafe(input_image);
-        img->setIptcData(input_image->iptcData());
-        img->setXmpData(input_image->xmpData());
-      }
-    }
-    catch(Exiv2::AnyError &e)
-    {
-      std::cerr << "[xmp_attach] " << input_filename << ": caught exiv2 exception '" << e << "'\n";
+      read_metadata_threadsafe(input_image);
+      iptcData = input_image->iptcData();
+      xmpData = input_image->xmpData();
     }
+  }
+  catch(Exiv2::AnyError &e)
+  {
+    std::cerr << "[xmp_attach] " << input_filename << ": caught exiv2 exception '" << e << "'\n";
+  }
 
-    Exiv2::XmpData &xmpData = img->xmpData();
+  // now add whatever we have in the sidecar XMP. this overwrites stuff from the source image
+  dt_image_path_append_version(imgid, input_filename, sizeof(input_filename));
+  g_strlcat(input_filename, ".xmp", sizeof(input_filename));
+  if(g_file_test(input_filename, G_FILE_TEST_EXISTS))
+  {
+    Exiv2::XmpData sidecarXmpData;
+    std::string xmpPacket;
 
-    // now add whatever we have in the sidecar XMP. this overwrites stuff from the source image
-    dt_image_path_append_version(imgid, input_filename, sizeof(input_filename));
-    g_strlcat(input_filename, ".xmp", sizeof(input_filename));
-    if(g_file_test(input_filename, G_FILE_TEST_EXISTS))
-    {
-      Exiv2::XmpData sidecarXmpData;
-      std::string xmpPacket;
+    Exiv2::DataBuf buf = Exiv2::readFile(WIDEN(input_filename));
+    xmpPacket.assign(reinterpret_cast<char *>(buf.pData_), buf.size_);
+    Exiv2::XmpParser::decode(sidecarXmpData, xmpPacket);
 
-      Exiv2::DataBuf buf = Exiv2::readFile(WIDEN(input_filename));
-      xmpPacket.assign(reinterpret_cast<char *>(buf.pData_), buf.size_);
-      Exiv2::XmpParser::decode(sidecarXmpData, xmpPacket);
+    for(Exiv2::XmpData::const_iterator it = sidecarXmpData.begin(); it != sidecarXmpData.end(); ++it)
+      xmpData.add(*it);
+  }
 
-      for(Exiv2::XmpData::const_iterator it = sidecarXmpData.begin(); it != sidecarXmpData.end(); ++it)
-        xmpData.add(*it);
-    }
+  dt_remove_known_keys(xmpData); // is this needed?
 
-    dt_remove_known_keys(xmpData); // is this needed?
-
-    {
-      // We also want to make sure to not have some tags that might
-      // have come in from XMP files created by digikam or similar
-      static const char *keys[] = {
-        "Xmp.tiff.Orientation"
-      };
-      static const guint n_keys = G_N_ELEMENTS(keys);
-      dt_remove_xmp_keys(xmpData, keys, n_keys);
-    }
+  {
+    // We also want to make sure to not have some tags that might
+    // have come in from XMP files created by digikam or similar
+    static const char *keys[] = {
+      "Xmp.tiff.Orientation"
+    };
+    static const guint n_keys = G_N_ELEMENTS(keys);
+    dt_remove_xmp_keys(xmpData, keys, n_keys);
+  }
 
-    // last but not least attach what we have in DB to the XMP. in theory that should be
-    // the same as what we just copied over from the sidecar file, but you never know ...
-    // make sure to remove all geotags if necessary
-    if(m)
+  // last but not least attach what we have in DB to the XMP. in theory that should be
+  // the same as what we just copied over from the sidecar file, but you never know ...
+  // make sure to remove all geotags if necessary
+  if(m)
+  {
+    Exiv2::ExifData exifOldData;
+    if(!(m->flags & DT_META_EXIF))
     {
-      Exiv2::ExifData exifOldData;
-      Exiv2::ExifData &exifData = img->exifData();
-      if(!(m->flags & DT_META_EXIF))
+      for(Exiv2::ExifData::const_iterator i = exifData.begin(); i != exifData.end() ; ++i)
       {
-        for(Exiv2::ExifData::const_iterator i = exifData.begin(); i != exifData.end() ; ++i)
-        {
-          exifOldData[i->key()] = i->value();
-        }
-        img->clearExifData();
+        exifOldData[i->key()] = i->value();
       }
+      exifData.clear();
+    }
 
-      dt_exif_xmp_read_data_export(xmpData, imgid, m);
-
-      Exiv2::IptcData &iptcData = img->iptcData();
-
-      if(!(m->flags & DT_META_GEOTAG))
-        dt_remove_exif_geotag(exifData);
-      // calculated metadata
-      dt_variables_params_t *params;
-      dt_variables_params_init(&params);
-      params->filename = input_filename;
-      params->jobcode = "export";
-      params->sequence = 0;
-      params->imgid = imgid;
+    dt_exif_xmp_read_data_export(xmpData, imgid, m);
 
-      dt_variables_set_tags_flags(params, m->flags);
-      for (GList *tags = m->list; tags; tags = g_list_next(tags))
+    if(!(m->flags & DT_META_GEOTAG))
+      dt_remove_exif_geotag(exifData);
+    // calculated metadata
+    dt_variables_params_t *params;
+    dt_variables_params_init(&params);
+    params->filename = input_filename;
+    params->jobcode = "export";
+    params->sequence = 0;
+    params->imgid = imgid;
+
+    dt_variables_set_tags_flags(params, m->flags);
+    for (GList *tags = m->list; tags; tags = g_list_next(tags))
+    {
+      gchar *tagname = (gchar *)tags->data;
+      tags = g_list_next(tags);
+      if (!tags) break;
+      gchar *formula = (gchar *)tags->data;
+      if (formula[0])
       {
-        gchar *tagname = (gchar *)tags->data;
-        tags = g_list_next(tags);
-        if (!tags) break;
-        gchar *formula = (gchar *)tags->data;
-        if (formula[0])
+        if(!(m->flags & DT_META_EXIF) && (formula[0] == '=') && g_str_has_prefix(tagname, "Exif."))
         {
-          if(!(m->flags & DT_META_EXIF) && (formula[0] == '=') && g_str_has_prefix(tagname, "Exif."))
-          {
-            Exiv2::ExifData::const_iterator pos;
-            if(dt_exif_read_exif_tag(exifOldData, &pos, tagname))
-            {
-              exifData[tagname] = pos->value();
-            }
-          }
-          else
+          Exiv2::ExifData::const_iterator pos;
+          if(dt_exif_read_exif_tag(exifOldData, &pos, tagname))
           {
-            gchar *result = dt_variables_expand(params, formula, FALSE);
-            if(result && result[0])
-            {
-              if(g_str_has_prefix(tagname, "Xmp."))
-                xmpData[tagname] = result;
-              else if(g_str_has_prefix(tagname, "Iptc."))
-                iptcData[tagname] = result;
-              else if(g_str_has_prefix(tagname, "Exif."))
-                exifData[tagname] = result;
-            }
-            g_free(result);
+            exifData[tagname] = pos->value();
           }
         }
         else
         {
-          if (g_str_has_prefix(tagname, "Xmp."))
-            dt_remove_xmp_key(xmpData, tagname);
-          else if (g_str_has_prefix(tagname, "Exif."))
-            dt_remove_exif_key(exifData, tagname);
+          gchar *result = dt_variables_expand(params, formula, FALSE);
+          if(result && result[0])
+          {
+            if(g_str_has_prefix(tagname, "Xmp."))
+              xmpData[tagname] = result;
+            else if(g_str_has_prefix(tagname, "Iptc."))
+              iptcData[tagname] = result;
+            else if(g_str_has_prefix(tagname, "Exif."))
+              exifData[tagname] = result;
+          }
+          g_free(result);
         }
       }
-      dt_variables_params_destroy(params);
+      else
+      {
+        if (g_str_has_prefix(tagname, "Xmp."))
+          dt_remove_xmp_key(xmpData, tagname);
+        else if (g_str_has_prefix(tagname, "Exif."))
+          dt_remove_exif_key(exifData, tagname);
+      }
     }
+    dt_variables_params_destroy(params);
+  }
+}
+
+int dt_exif_xmp_attach_export(const int imgid, const char *filename, void *metadata)
+{
+  dt_export_metadata_t *m = (dt_export_metadata_t *)metadata;
+  try
+  {
+    std::unique_ptr<Exiv2::Image> img(Exiv2::ImageFactory::open(WIDEN(filename)));
+    // unfortunately it seems we have to read the metadata, to not erase the exif (which we just wrote).
+    // will make export slightly slower, oh well.
+    // img->clearXmpPacket();
+    read_metadata_threadsafe(img);
+
+    _exif_xmp_export_data(imgid, m, img->exifData(), img->xmpData(), img->iptcData());
 
     img->writeMetadata();
     return 0;
@@ -3702,6 +3752,78 @@ int dt_exif_xmp_attach_export(const int imgid, const char *filename, void *metad
   }
 }
 
+dt_exif_blobs_t *dt_exif_export_blobs(const int imgid, const uint8_t *exif, const int exif_len, void *metadata,
+                                      const gboolean xmp, const int compressed)
+{
+  dt_export_metadata_t *m = (dt_export_metadata_t *)metadata;
+  try
+  {
+    Exiv2::ExifData exifData;
+    Exiv2::XmpData xmpData;
+    Exiv2::IptcData iptcData;
+
+    // what dt_exif_write_blob() would merge into the file
+    if(exif && exif_len > 6) Exiv2::ExifParser::decode(exifData, exif + 6, exif_len - 6);
+    _exif_export_cleanup(exifData, compressed);
+
+    // and what dt_exif_xmp_attach_export() would add afterwards
+    if(xmp) _exif_xmp_export_data(imgid, m, exifData, xmpData, iptcData);
+
+    dt_exif_blobs_t *blobs = (dt_exif_blobs_t *)g_malloc0(sizeof(dt_exif_blobs_t));
+
+    if(!exifData.empty())
+    {
+      exifData.sortByTag();
+      Exiv2::Blob blob;
+      Exiv2::ExifParser::encode(blob, Exiv2::bigEndian, exifData);
+      blobs->exif_len = blob.size() + 6;
+      blobs->exif = (uint8_t *)g_malloc(blobs->exif_len);
+      memcpy(blobs->exif, "Exif\000\000", 6);
+      memcpy(blobs->exif + 6, &(blob[0]), blob.size());
+    }
+
+    if(!xmpData.empty())
+    {
+      std::string xmpPacket;
+      if(Exiv2::XmpParser::encode(xmpPacket, xmpData, Exiv2::XmpParser::useCompactFormat) != 0)
+        throw Exiv2::Error(ERROR_CODE(1), "[export_blobs] failed to serialize xmp data");
+      blobs->xmp = g_strdup(xmpPacket.c_str());
+      blobs->xmp_len = xmpPacket.size();
+    }
+
+    if(!iptcData.empty())
+    {
+      // photoshop image resource 0x0404 (IPTC-NAA) with an empty name, padded to even size
+      Exiv2::DataBuf iim = Exiv2::IptcParser::encode(iptcData);
+      const size_t size = iim.size_;
+      blobs->iptc_len = 12 + size + (size & 1);
+      blobs->iptc = (uint8_t *)g_malloc0(blobs->iptc_len);
+      memcpy(blobs->iptc, "8BIM\004\004\000\000", 8);
+      blobs->iptc[8] = (size >> 24) & 0xff;
+      blobs->iptc[9] = (size >> 16) & 0xff;
+      blobs->iptc[10] = (size >> 8) & 0xff;
+      blobs->iptc[11] = size & 0xff;
+      memcpy(blobs->iptc + 12, iim.pData_, size);
+    }
+
+    return blobs;
+  }
+  catch(Exiv2::AnyError &e)
+  {
+    std::cerr << "[export_blobs] " << imgid << ": caught exiv2 exception '" << e << "'\n";
+    return NULL;
+  }
+}
+
+void dt_exif_blobs_free(dt_exif_blobs_t *blobs)
+{
+  if(!blobs) return;
+  g_free(blobs->exif);
+  g_free(blobs->xmp);
+  g_free(blobs->iptc);
+  g_free(blobs);
+}
+
 // write xmp sidecar file:
 int dt_exif_xmp_write(const int imgid, const char *filename)
 {
@@ -53,6 +53,23 @@ int dt_exif_xmp_write(const int imgid, const char *filename);
 /** write xmp packet inside an image. */
 int dt_exif_xmp_attach_export(const int imgid, const char *filename, void *metadata);
 
+/** serialized metadata of an exported image, for formats which embed it while encoding. */
+typedef struct dt_exif_blobs_t
+{
+  uint8_t *exif;  // "Exif\0\0" followed by the tiff structure, like dt_exif_read_blob() returns it
+  size_t exif_len;
+  char *xmp;      // complete xmp packet including the wrapper
+  size_t xmp_len;
+  uint8_t *iptc;  // IPTC-NAA record inside a photoshop image resource block
+  size_t iptc_len;
+} dt_exif_blobs_t;
+
+/** prepares the metadata dt_exif_write_blob() and, if xmp is set, dt_exif_xmp_attach_export() would write
+ * into the exported file, without touching any file. NULL on failure. */
+dt_exif_blobs_t *dt_exif_export_blobs(const int imgid, const uint8_t *exif, const int exif_len, void *metadata,
+                                      const gboolean xmp, const int compressed);
+void dt_exif_blobs_free(dt_exif_blobs_t *blobs);
+
 /** get the xmp blob for imgid. */
 char *dt_exif_xmp_read_string(const int imgid);
 
@@ -61,6 +78,9 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
 
 /** fetch largest exif thumbnail jpg bytestream into buffer*/
 int dt_exif_get_thumbnail(const char *path, uint8_t **buffer, size_t *size, char **mime_type);
+/** same, also returning where the tags put it in the file, -1 if that isn't known */
+int dt_exif_get_thumbnail_ext(const char *path, uint8_t **buffer, size_t *size, char **mime_type,
+                              int64_t *offset);
 
 /** thread safe init and cleanup. */
 void dt_exif_init();
@@ -0,0 +1,190 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/export_report.h"
+#include "common/darktable.h"
+#include "common/image.h"
+
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
+#include <stdio.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+typedef struct dt_export_report_module_t
+{
+  gchar *op;
+  const char *device;
+  gboolean tiled;
+  double time;
+} dt_export_report_module_t;
+
+struct dt_export_report_t
+{
+  int imgid;
+  gchar *output;
+  double start;
+  long rss_start;
+  double time[DT_EXPORT_REPORT_LAST];
+  GArray *modules;
+};
+
+static const char *_stage_names[DT_EXPORT_REPORT_LAST] = { "load", "exif", "pipe", "encode", "metadata" };
+
+static FILE *_report_file = NULL;
+static dt_pthread_mutex_t _report_mutex;
+
+static long _peak_rss()
+{
+#ifndef _WIN32
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss;
+#else
+  return 0;
+#endif
+}
+
+int dt_export_report_open(const char *filename)
+{
+  if(_report_file) return 0;
+  _report_file = g_fopen(filename, "w");
+  if(!_report_file) return 1;
+  dt_pthread_mutex_init(&_report_mutex, NULL);
+  return 0;
+}
+
+void dt_export_report_close()
+{
+  if(!_report_file) return;
+  fclose(_report_file);
+  _report_file = NULL;
+  dt_pthread_mutex_destroy(&_report_mutex);
+}
+
+dt_export_report_t *dt_export_report_new(const int imgid, const char *output)
+{
+  if(!_report_file) return NULL;
+
+  dt_export_report_t *report = (dt_export_report_t *)calloc(1, sizeof(dt_export_report_t));
+  report->imgid = imgid;
+  report->output = g_strdup(output);
+  report->start = dt_get_wtime();
+  report->rss_start = _peak_rss();
+  report->modules = g_array_new(FALSE, FALSE, sizeof(dt_export_report_module_t));
+  return report;
+}
+
+void dt_export_report_time(dt_export_report_t *report, const dt_export_report_stage_t stage, const double seconds)
+{
+  if(report) report->time[stage] += seconds;
+}
+
+void dt_export_report_module(dt_export_report_t *report, const char *op, const char *device, const gboolean tiled,
+                             const double seconds)
+{
+  if(!report) return;
+  const dt_export_report_module_t module = { g_strdup(op), device, tiled, seconds };
+  g_array_append_val(report->modules, module);
+}
+
+void dt_export_report_finish(dt_export_report_t *report, const int failed)
+{
+  if(!report) return;
+
+  char input[PATH_MAX] = { 0 };
+  gboolean from_cache = FALSE;
+  dt_image_full_path(report->imgid, input, sizeof(input), &from_cache);
+
+  JsonBuilder *builder = json_builder_new();
+  json_builder_begin_object(builder);
+  json_builder_set_member_name(builder, "imgid");
+  json_builder_add_int_value(builder, report->imgid);
+  json_builder_set_member_name(builder, "input");
+  json_builder_add_string_value(builder, input);
+  json_builder_set_member_name(builder, "output");
+  if(report->output)
+    json_builder_add_string_value(builder, report->output);
+  else
+    json_builder_add_null_value(builder);
+  json_builder_set_member_name(builder, "status");
+  json_builder_add_string_value(builder, failed ? "failed" : "ok");
+  for(int k = 0; k < DT_EXPORT_REPORT_LAST; k++)
+  {
+    json_builder_set_member_name(builder, _stage_names[k]);
+    json_builder_add_double_value(builder, report->time[k]);
+  }
+  json_builder_set_member_name(builder, "total");
+  json_builder_add_double_value(builder, dt_get_wtime() - report->start);
+  json_builder_set_member_name(builder, "peak_rss_delta_kb");
+  json_builder_add_int_value(builder, _peak_rss() - report->rss_start);
+
+  int tiled = 0;
+  for(guint k = 0; k < report->modules->len; k++)
+    tiled += g_array_index(report->modules, dt_export_report_module_t, k).tiled ? 1 : 0;
+  json_builder_set_member_name(builder, "tiled_modules");
+  json_builder_add_int_value(builder, tiled);
+
+  json_builder_set_member_name(builder, "modules");
+  json_builder_begin_array(builder);
+  for(guint k = 0; k < report->modules->len; k++)
+  {
+    dt_export_report_module_t *module = &g_array_index(report->modules, dt_export_report_module_t, k);
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "op");
+    json_builder_add_string_value(builder, module->op);
+    json_builder_set_member_name(builder, "device");
+    json_builder_add_string_value(builder, module->device);
+    json_builder_set_member_name(builder, "tiled");
+    json_builder_add_boolean_value(builder, module->tiled);
+    json_builder_set_member_name(builder, "time");
+    json_builder_add_double_value(builder, module->time);
+    json_builder_end_object(builder);
+    g_free(module->op);
+  }
+  json_builder_end_array(builder);
+  json_builder_end_object(builder);
+
+  JsonGenerator *generator = json_generator_new();
+  JsonNode *root = json_builder_get_root(builder);
+  json_generator_set_root(generator, root);
+  gchar *line = json_generator_to_data(generator, NULL);
+
+  // exports might finish at the same time, keep their lines apart
+  dt_pthread_mutex_lock(&_report_mutex);
+  if(_report_file)
+  {
+    fprintf(_report_file, "%s\n", line);
+    fflush(_report_file);
+  }
+  dt_pthread_mutex_unlock(&_report_mutex);
+
+  g_free(line);
+  json_node_free(root);
+  g_object_unref(generator);
+  g_object_unref(builder);
+
+  g_array_free(report->modules, TRUE);
+  g_free(report->output);
+  free(report);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
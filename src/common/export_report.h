@@ -0,0 +1,69 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+
+/**
+ * machine readable account of where the time of each export went. once a report file is open, every export
+ * appends one json object per line to it:
+ *
+ * { "imgid": 1, "input": "/path/img.nef", "output": "/path/img.jpg", "status": "ok",
+ *   "load": 0.61, "exif": 0.01, "pipe": 2.35, "encode": 0.22, "metadata": 0.02, "total": 3.25,
+ *   "peak_rss_delta_kb": 512000, "tiled_modules": 1,
+ *   "modules": [ { "op": "demosaic", "device": "CPU", "tiled": false, "time": 0.52 }, ... ] }
+ *
+ * times are in seconds. load is getting the full size input (the raw decode, unless it was cached), exif
+ * reading the metadata of the input for the output file. the rss delta is how much the peak resident size of
+ * the whole process grew during the export, so it is only meaningful for exports which don't run in parallel.
+ */
+
+typedef enum dt_export_report_stage_t
+{
+  DT_EXPORT_REPORT_LOAD = 0,
+  DT_EXPORT_REPORT_EXIF,
+  DT_EXPORT_REPORT_PIPE,
+  DT_EXPORT_REPORT_ENCODE,
+  DT_EXPORT_REPORT_METADATA,
+  DT_EXPORT_REPORT_LAST
+} dt_export_report_stage_t;
+
+typedef struct dt_export_report_t dt_export_report_t;
+
+/** starts appending reports to filename, returns 1 if it can't be written. */
+int dt_export_report_open(const char *filename);
+void dt_export_report_close();
+
+/** returns NULL unless a report file is open, all other functions accept NULL and do nothing then. output is
+ * NULL for exports which don't write a file of their own. */
+dt_export_report_t *dt_export_report_new(const int imgid, const char *output);
+
+/** adds seconds to the time spent in stage. */
+void dt_export_report_time(dt_export_report_t *report, const dt_export_report_stage_t stage, const double seconds);
+
+/** records one module (or a run of fused ones) processed by the pixelpipe. */
+void dt_export_report_module(dt_export_report_t *report, const char *op, const char *device, const gboolean tiled,
+                             const double seconds);
+
+/** writes the report as one line and frees it. */
+void dt_export_report_finish(dt_export_report_t *report, const int failed);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
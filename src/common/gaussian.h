@@ -29,6 +29,12 @@ typedef enum dt_gaussian_order_t
   DT_IOP_GAUSSIAN_TWO = 2
 } dt_gaussian_order_t;
 
+typedef enum dt_gaussian_engine_t
+{
+  DT_GAUSSIAN_ENGINE_AUTO = 0, // pick by sigma, order, channels and image size
+  DT_GAUSSIAN_ENGINE_IIR = 1,  // recursive filter, cost independent of sigma
+  DT_GAUSSIAN_ENGINE_FIR = 2   // separable truncated kernel, for small sigma and order zero only
+} dt_gaussian_engine_t;
 
 typedef struct dt_gaussian_t
 {
@@ -38,11 +44,19 @@ typedef struct dt_gaussian_t
   float *max;
   float *min;
   float *buf;
+  dt_gaussian_engine_t engine;
+  int radius;     // FIR only: kernel taps -radius..radius
+  float *kernel;  // FIR only: normalized weights, 2 * radius + 1 of them
+  size_t rowsize; // FIR only: floats per thread row, stored in buf after the image
 } dt_gaussian_t;
 
 dt_gaussian_t *dt_gaussian_init(const int width, const int height, const int channels, const float *max,
                                 const float *min, const float sigma, const int order);
 
+dt_gaussian_t *dt_gaussian_init_engine(const int width, const int height, const int channels, const float *max,
+                                       const float *min, const float sigma, const int order,
+                                       const dt_gaussian_engine_t engine);
+
 size_t dt_gaussian_memory_use(const int width, const int height, const int channels);
 
 size_t dt_gaussian_singlebuffer_size(const int width, const int height, const int channels);
@@ -0,0 +1,118 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+#include <stddef.h>
+#include <stdint.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+// distro builds don't target f16c, so it is compiled in for these functions only and picked at runtime
+#define DT_HALF_F16C
+#endif
+
+/**
+ * conversion between 32 bit floats and IEEE 754 half floats, for buffers which are stored or passed around in
+ * half the space. plain integer code, so it works the same on every cpu, rounds to nearest even and keeps
+ * infs, nans and subnormals.
+ */
+
+static inline uint16_t dt_float_to_half(const float f)
+{
+  union { float f; uint32_t i; } u = { .f = f };
+  const uint32_t sign = u.i & 0x80000000u;
+  u.i ^= sign;
+
+  uint16_t h;
+  if(u.i >= 0x47800000u) // too large for a half, inf or nan
+    h = u.i > 0x7f800000u ? 0x7e00 : 0x7c00;
+  else if(u.i < 0x38800000u) // subnormal half or zero: let the fpu do the rounding
+  {
+    const union { uint32_t i; float f; } magic = { .i = 0x3f000000u };
+    u.f += magic.f;
+    h = u.i - magic.i;
+  }
+  else // normal half: rebias the exponent and round to nearest even
+  {
+    const uint32_t odd = (u.i >> 13) & 1;
+    u.i += 0xc8000fffu + odd;
+    h = u.i >> 13;
+  }
+  return h | (sign >> 16);
+}
+
+static inline float dt_half_to_float(const uint16_t h)
+{
+  union { uint32_t i; float f; } u = { .i = (uint32_t)(h & 0x7fff) << 13 };
+  const uint32_t exp = u.i & 0x0f800000u;
+  u.i += 0x38000000u; // rebias the exponent
+  if(exp == 0x0f800000u) // inf or nan
+    u.i += 0x38000000u;
+  else if(!exp) // subnormal
+  {
+    const union { uint32_t i; float f; } magic = { .i = 0x38800000u };
+    u.i += 0x00800000u;
+    u.f -= magic.f;
+  }
+  u.i |= (uint32_t)(h & 0x8000) << 16;
+  return u.f;
+}
+
+#ifdef DT_HALF_F16C
+// both return the number of values converted, a multiple of 4
+__attribute__((target("f16c"))) static size_t _dt_float_to_half_f16c(uint16_t *const out,
+                                                                      const float *const in, const size_t n)
+{
+  size_t k = 0;
+  for(; k + 4 <= n; k += 4)
+    _mm_storel_epi64((__m128i *)(out + k), _mm_cvtps_ph(_mm_loadu_ps(in + k), _MM_FROUND_TO_NEAREST_INT));
+  return k;
+}
+
+__attribute__((target("f16c"))) static size_t _dt_half_to_float_f16c(float *const out, const uint16_t *const in,
+                                                                      const size_t n)
+{
+  size_t k = 0;
+  for(; k + 4 <= n; k += 4) _mm_storeu_ps(out + k, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)(in + k))));
+  return k;
+}
+#endif
+
+/** converts n floats, using the f16c instructions if the cpu has them. */
+static inline void dt_float_to_half_buf(uint16_t *const out, const float *const in, const size_t n)
+{
+  size_t k = 0;
+#ifdef DT_HALF_F16C
+  if(darktable.codepath.F16C) k = _dt_float_to_half_f16c(out, in, n);
+#endif
+  for(; k < n; k++) out[k] = dt_float_to_half(in[k]);
+}
+
+static inline void dt_half_to_float_buf(float *const out, const uint16_t *const in, const size_t n)
+{
+  size_t k = 0;
+#ifdef DT_HALF_F16C
+  if(darktable.codepath.F16C) k = _dt_half_to_float_f16c(out, in, n);
+#endif
+  for(; k < n; k++) out[k] = dt_half_to_float(in[k]);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -166,18 +166,24 @@ inline static void histogram_helper_cs_rgb(const dt_dev_histogram_collection_par
   const dt_histogram_roi_t *roi = histogram_params->roi;
   float *in = (float *)pixel + 4 * (roi->width * j + roi->crop_x);
 
-  // process aligned pixels with SSE
-  for(int i = 0; i < roi->width - roi->crop_width - roi->crop_x; i++, in += 4)
+  const int width = roi->width - roi->crop_width - roi->crop_x;
+
+  // pick the code path once per row, not per pixel
+  if(darktable.codepath.OPENMP_SIMD)
   {
-    if(darktable.codepath.OPENMP_SIMD)
+    for(int i = 0; i < width; i++, in += 4)
       histogram_helper_cs_rgb_helper_process_pixel_float(histogram_params, in, histogram);
+  }
 #if defined(__SSE2__)
-    else if(darktable.codepath.SSE2)
+  // process aligned pixels with SSE
+  else if(darktable.codepath.SSE2)
+  {
+    for(int i = 0; i < width; i++, in += 4)
       histogram_helper_cs_rgb_helper_process_pixel_m128(histogram_params, in, histogram);
-#endif
-    else
-      dt_unreachable_codepath();
   }
+#endif
+  else
+    dt_unreachable_codepath();
 }
 
 inline static void histogram_helper_cs_rgb_compensated(const dt_dev_histogram_collection_params_t *const histogram_params,
@@ -187,18 +193,23 @@ inline static void histogram_helper_cs_rgb_compensated(const dt_dev_histogram_co
   const dt_histogram_roi_t *roi = histogram_params->roi;
   float *in = (float *)pixel + 4 * (roi->width * j + roi->crop_x);
 
-  // process aligned pixels with SSE
-  for(int i = 0; i < roi->width - roi->crop_width - roi->crop_x; i++, in += 4)
+  const int width = roi->width - roi->crop_width - roi->crop_x;
+
+  if(darktable.codepath.OPENMP_SIMD)
   {
-    if(darktable.codepath.OPENMP_SIMD)
+    for(int i = 0; i < width; i++, in += 4)
       histogram_helper_cs_rgb_helper_process_pixel_float_compensated(histogram_params, in, histogram, profile_info);
+  }
 #if defined(__SSE2__)
-    else if(darktable.codepath.SSE2)
+  // process aligned pixels with SSE
+  else if(darktable.codepath.SSE2)
+  {
+    for(int i = 0; i < width; i++, in += 4)
       histogram_helper_cs_rgb_helper_process_pixel_m128_compensated(histogram_params, in, histogram, profile_info);
-#endif
-    else
-      dt_unreachable_codepath();
   }
+#endif
+  else
+    dt_unreachable_codepath();
 }
 
 //------------------------------------------------------------------------------
@@ -255,18 +266,23 @@ inline static void histogram_helper_cs_Lab(const dt_dev_histogram_collection_par
   const dt_histogram_roi_t *roi = histogram_params->roi;
   float *in = (float *)pixel + 4 * (roi->width * j + roi->crop_x);
 
-  // process aligned pixels with SSE
-  for(int i = 0; i < roi->width - roi->crop_width - roi->crop_x; i++, in += 4)
+  const int width = roi->width - roi->crop_width - roi->crop_x;
+
+  if(darktable.codepath.OPENMP_SIMD)
   {
-    if(darktable.codepath.OPENMP_SIMD)
+    for(int i = 0; i < width; i++, in += 4)
       histogram_helper_cs_Lab_helper_process_pixel_float(histogram_params, in, histogram);
+  }
 #if defined(__SSE2__)
-    else if(darktable.codepath.SSE2)
+  // process aligned pixels with SSE
+  else if(darktable.codepath.SSE2)
+  {
+    for(int i = 0; i < width; i++, in += 4)
       histogram_helper_cs_Lab_helper_process_pixel_m128(histogram_params, in, histogram);
-#endif
-    else
-      dt_unreachable_codepath();
   }
+#endif
+  else
+    dt_unreachable_codepath();
 }
 
 inline static void __attribute__((__unused__)) histogram_helper_cs_Lab_LCh_helper_process_pixel_float(
@@ -332,25 +348,21 @@ void dt_histogram_worker(dt_dev_histogram_collection_params_t *const histogram_p
     Worker(histogram_params, pixel, thread_hist, j, profile_info);
   }
 
-#ifdef _OPENMP
   *histogram = realloc(*histogram, buf_size);
-  memset(*histogram, 0, buf_size);
-  uint32_t *hist = *histogram;
+#ifdef _OPENMP
+  uint32_t *const hist = *histogram;
 
+  // the usual 256 bins are summed up quicker than another thread team is started
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(nthreads, bins_total) \
-  shared(hist, partial_hists) \
-  schedule(static)
+  dt_omp_firstprivate(nthreads, bins_total, hist, partial_hists) \
+  schedule(static) if(bins_total > 16384)
   for(size_t k = 0; k < bins_total; k++)
   {
-    for(size_t n = 0; n < nthreads; n++)
-    {
-      const uint32_t *thread_hist = (uint32_t *)partial_hists + bins_total * n;
-      hist[k] += thread_hist[k];
-    }
+    uint32_t sum = 0;
+    for(int n = 0; n < nthreads; n++) sum += ((const uint32_t *)partial_hists)[bins_total * n + k];
+    hist[k] = sum;
   }
 #else
-  *histogram = realloc(*histogram, buf_size);
   memmove(*histogram, partial_hists, buf_size);
 #endif
   free(partial_hists);
@@ -30,6 +30,7 @@
 #include "common/history_snapshot.h"
 #include "common/undo.h"
 #include "control/control.h"
+#include "control/jobs/control_jobs.h"
 #include "develop/develop.h"
 #include "develop/blend.h"
 #include "develop/masks.h"
@@ -539,35 +540,38 @@ int dt_history_merge_module_into_history(dt_develop_t *dev_dest, dt_develop_t *d
   return module_added;
 }
 
-static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_imgid, GList *ops)
+// loads the history of the source image into dev_src, it can then be merged onto any number of images
+static void _history_copy_and_paste_source_init(dt_develop_t *dev_src, int32_t imgid)
+{
+  // we will do the copy/paste on memory so we can deal with masks
+  dt_dev_init(dev_src, FALSE);
+  dev_src->iop = dt_iop_load_modules_ext(dev_src, TRUE);
+  dt_dev_read_history_ext(dev_src, imgid, TRUE);
+  dt_ioppr_check_iop_order(dev_src, imgid, "_history_copy_and_paste_on_image_merge ");
+  dt_dev_pop_history_items_ext(dev_src, dev_src->history_end);
+  dt_ioppr_check_iop_order(dev_src, imgid, "_history_copy_and_paste_on_image_merge 1");
+}
+
+static int _history_copy_and_paste_on_image_merge_ext(dt_develop_t *dev_src, int32_t imgid, int32_t dest_imgid,
+                                                      GList *ops)
 {
   GList *modules_used = NULL;
 
-  dt_develop_t _dev_src = { 0 };
   dt_develop_t _dev_dest = { 0 };
 
-  dt_develop_t *dev_src = &_dev_src;
   dt_develop_t *dev_dest = &_dev_dest;
 
-  // we will do the copy/paste on memory so we can deal with masks
-  dt_dev_init(dev_src, FALSE);
   dt_dev_init(dev_dest, FALSE);
 
-  dev_src->iop = dt_iop_load_modules_ext(dev_src, TRUE);
   dev_dest->iop = dt_iop_load_modules_ext(dev_dest, TRUE);
 
-  dt_dev_read_history_ext(dev_src, imgid, TRUE);
-
   // This prepends the default modules and converts just in case it's an empty history
   dt_dev_read_history_ext(dev_dest, dest_imgid, TRUE);
 
-  dt_ioppr_check_iop_order(dev_src, imgid, "_history_copy_and_paste_on_image_merge ");
   dt_ioppr_check_iop_order(dev_dest, imgid, "_history_copy_and_paste_on_image_merge ");
 
-  dt_dev_pop_history_items_ext(dev_src, dev_src->history_end);
   dt_dev_pop_history_items_ext(dev_dest, dev_dest->history_end);
 
-  dt_ioppr_check_iop_order(dev_src, imgid, "_history_copy_and_paste_on_image_merge 1");
   dt_ioppr_check_iop_order(dev_dest, imgid, "_history_copy_and_paste_on_image_merge 1");
 
   const int iop_order_version_src = dt_image_get_iop_order_version(imgid);
@@ -611,6 +615,9 @@ static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_im
           // merge the entry
           dt_history_merge_module_into_history(dev_dest, dev_src, hist->module, &modules_used, FALSE);
         }
+
+        // dev_src might be merged onto further images
+        hist->module->iop_order = old_iop_order;
       }
 
       l = g_list_previous(l);
@@ -647,6 +654,8 @@ static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_im
 
         // merge the module into dest image
         dt_history_merge_module_into_history(dev_dest, dev_src, mod_src, &modules_used, FALSE);
+
+        mod_src->iop_order = old_iop_order;
       }
 
       modules_src = g_list_next(modules_src);
@@ -660,7 +669,6 @@ static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_im
   // write history and forms to db
   dt_dev_write_history_ext(dev_dest, dest_imgid);
 
-  dt_dev_cleanup(dev_src);
   dt_dev_cleanup(dev_dest);
 
   g_list_free(modules_used);
@@ -668,7 +676,20 @@ static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_im
   return 0;
 }
 
-static int _history_copy_and_paste_on_image_overwrite(int32_t imgid, int32_t dest_imgid, GList *ops)
+static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_imgid, GList *ops)
+{
+  dt_develop_t _dev_src = { 0 };
+  dt_develop_t *dev_src = &_dev_src;
+
+  _history_copy_and_paste_source_init(dev_src, imgid);
+  const int ret_val = _history_copy_and_paste_on_image_merge_ext(dev_src, imgid, dest_imgid, ops);
+  dt_dev_cleanup(dev_src);
+
+  return ret_val;
+}
+
+static int _history_copy_and_paste_on_image_overwrite(dt_develop_t *dev_src, int32_t imgid, int32_t dest_imgid,
+                                                      GList *ops)
 {
   int ret_val = 0;
   sqlite3_stmt *stmt;
@@ -750,7 +771,10 @@ static int _history_copy_and_paste_on_image_overwrite(int32_t imgid, int32_t des
   else
   {
     // since the history and masks where deleted we can do a merge
-    ret_val = _history_copy_and_paste_on_image_merge(imgid, dest_imgid, ops);
+    if(dev_src)
+      ret_val = _history_copy_and_paste_on_image_merge_ext(dev_src, imgid, dest_imgid, ops);
+    else
+      ret_val = _history_copy_and_paste_on_image_merge(imgid, dest_imgid, ops);
   }
 
   return ret_val;
@@ -780,7 +804,7 @@ int dt_history_copy_and_paste_on_image(int32_t imgid, int32_t dest_imgid, gboole
   if(merge)
     ret_val = _history_copy_and_paste_on_image_merge(imgid, dest_imgid, ops);
   else
-    ret_val = _history_copy_and_paste_on_image_overwrite(imgid, dest_imgid, ops);
+    ret_val = _history_copy_and_paste_on_image_overwrite(NULL, imgid, dest_imgid, ops);
 
   dt_history_snapshot_undo_create(hist->imgid, &hist->after, &hist->after_history_end);
   dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
@@ -902,33 +926,117 @@ char *dt_history_get_items_as_string(int32_t imgid)
   return result;
 }
 
+int dt_history_copy_and_paste_on_images(int32_t imgid, GList *imgs, gboolean merge, GList *ops)
+{
+  if(imgid < 0) return 1;
+
+  // be sure the current history is written before pasting some other history data
+  const dt_view_t *cv = dt_view_manager_get_current_view(darktable.view_manager);
+  if(cv->view((dt_view_t *)cv) == DT_VIEW_DARKROOM) dt_dev_write_history(darktable.develop);
+
+  // the source history is the same for all images, only load it once. an overwrite without
+  // selected entries is a plain copy in the database and does not need it.
+  dt_develop_t _dev_src = { 0 };
+  dt_develop_t *dev_src = NULL;
+  if(merge || ops)
+  {
+    dev_src = &_dev_src;
+    _history_copy_and_paste_source_init(dev_src, imgid);
+  }
+
+  guint tagid = 0;
+  dt_tag_new("darktable|changed", &tagid);
+
+  const gboolean sort_aspect_ratio = darktable.collection->params.sort == DT_COLLECTION_SORT_ASPECT_RATIO;
+  gboolean reload_current = FALSE;
+  GList *changed = NULL;
+  int res = 0;
+
+  // a single transaction for the history, snapshots and tags of all images
+  dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
+  sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+
+  for(const GList *l = imgs; l; l = g_list_next(l))
+  {
+    const int32_t dest_imgid = GPOINTER_TO_INT(l->data);
+    if(dest_imgid == imgid) continue;
+
+    dt_lock_image_pair(imgid, dest_imgid);
+
+    dt_undo_lt_history_t *hist = dt_history_snapshot_item_init();
+    hist->imgid = dest_imgid;
+    dt_history_snapshot_undo_create_ext(hist->imgid, &hist->before, &hist->before_history_end, FALSE);
+
+    if(merge)
+      res |= _history_copy_and_paste_on_image_merge_ext(dev_src, imgid, dest_imgid, ops);
+    else
+      res |= _history_copy_and_paste_on_image_overwrite(dev_src, imgid, dest_imgid, ops);
+
+    dt_history_snapshot_undo_create_ext(hist->imgid, &hist->after, &hist->after_history_end, FALSE);
+    dt_undo_record(darktable.undo, NULL, DT_UNDO_LT_HISTORY, (dt_undo_data_t)hist,
+                   dt_history_snapshot_undo_pop, dt_history_snapshot_undo_lt_history_data_free);
+
+    /* attach changed tag reflecting actual change */
+    dt_tag_attach(tagid, dest_imgid, FALSE, FALSE);
+
+    dt_mipmap_cache_remove(darktable.mipmap_cache, dest_imgid);
+
+    /* update the aspect ratio. recompute only if really needed for performance reasons */
+    if(sort_aspect_ratio)
+      dt_image_set_aspect_ratio(dest_imgid);
+    else
+      dt_image_reset_aspect_ratio(dest_imgid);
+
+    dt_unlock_image_pair(imgid, dest_imgid);
+
+    if(dt_dev_is_current_image(darktable.develop, dest_imgid)) reload_current = TRUE;
+    changed = g_list_prepend(changed, GINT_TO_POINTER(dest_imgid));
+  }
+
+  sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+  dt_undo_end_group(darktable.undo);
+
+  if(dev_src) dt_dev_cleanup(dev_src);
+
+  dt_image_reset_final_size(imgid);
+
+  /* if current image in develop reload history */
+  if(reload_current)
+  {
+    dt_dev_reload_history_items(darktable.develop);
+    dt_dev_modulegroups_set(darktable.develop, dt_dev_modulegroups_get(darktable.develop));
+  }
+
+  /* update xmp files, this is by far the slowest part and done in the background */
+  dt_control_write_sidecar_files_list(g_list_reverse(changed));
+
+  return res;
+}
+
 int dt_history_copy_and_paste_on_selection(int32_t imgid, gboolean merge, GList *ops)
 {
   if(imgid < 0) return 1;
 
   int res = 0;
+  GList *imgs = NULL;
   sqlite3_stmt *stmt;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "SELECT imgid FROM main.selected_images WHERE imgid != ?1", -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
-    do
-    {
-      /* get imgid of selected image */
-      int32_t dest_imgid = sqlite3_column_int(stmt, 0);
-
-      /* paste history stack onto image id */
-      dt_history_copy_and_paste_on_image(imgid, dest_imgid, merge, ops);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    imgs = g_list_prepend(imgs, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
 
-    } while(sqlite3_step(stmt) == SQLITE_ROW);
-    dt_undo_end_group(darktable.undo);
+  if(imgs)
+  {
+    imgs = g_list_reverse(imgs);
+    /* paste history stack onto all selected images at once */
+    dt_history_copy_and_paste_on_images(imgid, imgs, merge, ops);
+    g_list_free(imgs);
   }
   else
     res = 1;
 
-  sqlite3_finalize(stmt);
   return res;
 }
 
@@ -40,6 +40,9 @@ void dt_history_delete_on_image(int32_t imgid);
 /** as above but control whether to record undo/redo */
 void dt_history_delete_on_image_ext(int32_t imgid, gboolean undo);
 
+/** copy history from imgid and pasts on all images of the list at once, merge or overwrite... */
+int dt_history_copy_and_paste_on_images(int32_t imgid, GList *imgs, gboolean merge, GList *ops);
+
 /** copy history from imgid and pasts on selected images, merge or overwrite... */
 int dt_history_copy_and_paste_on_selection(int32_t imgid, gboolean merge, GList *ops);
 
@@ -26,7 +26,7 @@ dt_undo_lt_history_t *dt_history_snapshot_item_init(void)
   return (dt_undo_lt_history_t *)g_malloc0(sizeof(dt_undo_lt_history_t));
 }
 
-void dt_history_snapshot_undo_create(int32_t imgid, int *snap_id, int *history_end)
+void dt_history_snapshot_undo_create_ext(int32_t imgid, int *snap_id, int *history_end, gboolean own_transaction)
 {
   // create history & mask snapshots for imgid, return the snapshot id
   sqlite3_stmt *stmt;
@@ -55,7 +55,7 @@ void dt_history_snapshot_undo_create(int32_t imgid, int *snap_id, int *history_e
     *snap_id = sqlite3_column_int(stmt, 0) + 1;
   sqlite3_finalize(stmt);
 
-  sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+  if(own_transaction) sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
 
   // copy current state into undo_history
 
@@ -78,14 +78,22 @@ void dt_history_snapshot_undo_create(int32_t imgid, int *snap_id, int *history_e
   all_ok = all_ok && (sqlite3_step(stmt) == SQLITE_DONE);
   sqlite3_finalize(stmt);
 
-  if(all_ok)
-    sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
-  else
-    sqlite3_exec(dt_database_get(darktable.db), "ROLLBACK_TRANSACTION", NULL, NULL, NULL);
+  if(own_transaction)
+  {
+    if(all_ok)
+      sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+    else
+      sqlite3_exec(dt_database_get(darktable.db), "ROLLBACK_TRANSACTION", NULL, NULL, NULL);
+  }
 
   dt_unlock_image(imgid);
 }
 
+void dt_history_snapshot_undo_create(int32_t imgid, int *snap_id, int *history_end)
+{
+  dt_history_snapshot_undo_create_ext(imgid, snap_id, history_end, TRUE);
+}
+
 static void _history_snapshot_undo_restore(int32_t imgid, int snap_id, int history_end)
 {
   // restore the given snapshot for imgid
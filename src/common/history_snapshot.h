@@ -32,6 +32,8 @@ typedef struct dt_undo_lt_history_t
 dt_undo_lt_history_t *dt_history_snapshot_item_init(void);
 
 void dt_history_snapshot_undo_create(int32_t imgid, int *snap_id, int *history_end);
+/** same as above, but leaves the transaction handling to the caller if own_transaction is FALSE */
+void dt_history_snapshot_undo_create_ext(int32_t imgid, int *snap_id, int *history_end, gboolean own_transaction);
 
 void dt_history_snapshot_undo_pop(gpointer user_data, dt_undo_type_t type, dt_undo_data_t data, dt_undo_action_t action, GList **imgs);
 
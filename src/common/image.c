@@ -33,6 +33,7 @@
 #include "control/conf.h"
 #include "control/control.h"
 #include "control/jobs.h"
+#include "control/jobs/control_jobs.h"
 #include "develop/lightroom.h"
 #include "win/filepath.h"
 #ifdef USE_LUA
@@ -836,6 +837,7 @@ int32_t dt_image_duplicate_with_version(const int32_t imgid, const int32_t newve
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
+    dt_tag_index_invalidate();
 
     // make sure that the duplicate doesn't have some magic darktable| tags
     dt_tag_detach_by_string("darktable|changed", newid, FALSE, FALSE);
@@ -902,6 +904,7 @@ void dt_image_remove(const int32_t imgid)
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
+  dt_tag_index_invalidate();
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "DELETE FROM main.history WHERE imgid = ?1", -1,
                               &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
@@ -927,6 +930,11 @@ void dt_image_remove(const int32_t imgid)
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "DELETE FROM main.embedded_thumbnails WHERE imgid = ?1", -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
   // also clear all thumbnails in mipmap_cache.
   dt_mipmap_cache_remove(darktable.mipmap_cache, imgid);
 }
@@ -1388,11 +1396,8 @@ void dt_image_init(dt_image_t *img)
   memset(img->exif_maker, 0, sizeof(img->exif_maker));
   memset(img->exif_model, 0, sizeof(img->exif_model));
   memset(img->exif_lens, 0, sizeof(img->exif_lens));
-  memset(img->camera_maker, 0, sizeof(img->camera_maker));
-  memset(img->camera_model, 0, sizeof(img->camera_model));
-  memset(img->camera_alias, 0, sizeof(img->camera_alias));
-  memset(img->camera_makermodel, 0, sizeof(img->camera_makermodel));
-  memset(img->camera_legacy_makermodel, 0, sizeof(img->camera_legacy_makermodel));
+  img->camera_maker = img->camera_model = img->camera_alias = "";
+  img->camera_makermodel = img->camera_legacy_makermodel = "";
   memset(img->filename, 0, sizeof(img->filename));
   g_strlcpy(img->filename, "(unknown)", sizeof(img->filename));
   img->exif_model[0] = img->exif_maker[0] = img->exif_lens[0] = '\0';
@@ -1429,17 +1434,20 @@ void dt_image_refresh_makermodel(dt_image_t *img)
   if (!img->camera_maker[0] || !img->camera_model[0] || !img->camera_alias[0])
   {
     // We need to use the exif values, so let's get rawspeed to munge them
+    char maker[64], model[64], alias[64];
     dt_rawspeed_lookup_makermodel(img->exif_maker, img->exif_model,
-                                  img->camera_maker, sizeof(img->camera_maker),
-                                  img->camera_model, sizeof(img->camera_model),
-                                  img->camera_alias, sizeof(img->camera_alias));
+                                  maker, sizeof(maker),
+                                  model, sizeof(model),
+                                  alias, sizeof(alias));
+    img->camera_maker = g_intern_string(maker);
+    img->camera_model = g_intern_string(model);
+    img->camera_alias = g_intern_string(alias);
   }
 
   // Now we just create a makermodel by concatenation
-  g_strlcpy(img->camera_makermodel, img->camera_maker, sizeof(img->camera_makermodel));
-  int len = strlen(img->camera_maker);
-  img->camera_makermodel[len] = ' ';
-  g_strlcpy(img->camera_makermodel+len+1, img->camera_model, sizeof(img->camera_makermodel)-len-1);
+  gchar *makermodel = g_strdup_printf("%s %s", img->camera_maker, img->camera_model);
+  img->camera_makermodel = g_intern_string(makermodel);
+  g_free(makermodel);
 }
 
 int32_t dt_image_rename(const int32_t imgid, const int32_t filmid, const gchar *newname)
@@ -1769,6 +1777,7 @@ int32_t dt_image_copy_rename(const int32_t imgid, const int32_t filmid, const gc
         DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
         sqlite3_step(stmt);
         sqlite3_finalize(stmt);
+        dt_tag_index_invalidate();
 
         // get max_version of image duplicates in destination filmroll
         int32_t max_version = -1;
@@ -2053,19 +2062,18 @@ void dt_image_synch_xmp(const int selected)
 {
   if(selected > 0)
   {
-    dt_image_write_sidecar_file(selected);
+    dt_control_queue_sidecar_file(selected);
   }
   else if(dt_conf_get_bool("write_sidecar_files"))
   {
+    GList *imgs = NULL;
     sqlite3_stmt *stmt;
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT imgid FROM main.selected_images", -1, &stmt,
                                 NULL);
     while(sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      const int imgid = sqlite3_column_int(stmt, 0);
-      dt_image_write_sidecar_file(imgid);
-    }
+      imgs = g_list_prepend(imgs, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
     sqlite3_finalize(stmt);
+    dt_control_write_sidecar_files_list(imgs);
   }
 }
 
@@ -2082,14 +2090,13 @@ void dt_image_synch_all_xmp(const gchar *pathname)
                                 -1, &stmt, NULL);
     DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, imgpath, -1, SQLITE_TRANSIENT);
     DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, imgfname, -1, SQLITE_TRANSIENT);
+    GList *imgs = NULL;
     while(sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      const int imgid = sqlite3_column_int(stmt, 0);
-      dt_image_write_sidecar_file(imgid);
-    }
+      imgs = g_list_prepend(imgs, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
     sqlite3_finalize(stmt);
     g_free(imgfname);
     g_free(imgpath);
+    dt_control_write_sidecar_files_list(imgs);
   }
 }
 
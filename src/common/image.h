@@ -161,11 +161,13 @@ typedef struct dt_image_t
   char exif_lens[128];
   char exif_datetime_taken[20];
 
-  char camera_maker[64];
-  char camera_model[64];
-  char camera_alias[64];
-  char camera_makermodel[128];
-  char camera_legacy_makermodel[128];
+  // canonical names looked up from the exif ones. there are only a handful of them
+  // across a whole library, so they are interned (g_intern_string) and never freed.
+  const char *camera_maker;
+  const char *camera_model;
+  const char *camera_alias;
+  const char *camera_makermodel;
+  const char *camera_legacy_makermodel;
 
   char filename[DT_MAX_FILENAME_LEN];
 
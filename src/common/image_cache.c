@@ -22,119 +22,147 @@
 #include "common/exif.h"
 #include "common/image.h"
 #include "control/conf.h"
+#include "control/jobs/control_jobs.h"
 #include "develop/develop.h"
 
 #include <sqlite3.h>
 
+// the columns _image_cache_fill() expects, in this order
+#define DT_IMAGE_CACHE_COLUMNS                                                                                    \
+  "id, group_id, film_id, width, height, filename, maker, model, lens, exposure, "                               \
+  "aperture, iso, focal_length, datetime_taken, flags, crop, orientation, focus_distance, "                       \
+  "raw_parameters, longitude, latitude, altitude, color_matrix, colorspace, version, raw_black, "                 \
+  "raw_maximum, aspect_ratio"
+
+static void _image_cache_fill(dt_image_t *img, sqlite3_stmt *stmt)
+{
+  char *str;
+  img->id = sqlite3_column_int(stmt, 0);
+  img->group_id = sqlite3_column_int(stmt, 1);
+  img->film_id = sqlite3_column_int(stmt, 2);
+  img->width = sqlite3_column_int(stmt, 3);
+  img->height = sqlite3_column_int(stmt, 4);
+  img->crop_x = img->crop_y = img->crop_width = img->crop_height = 0;
+  img->filename[0] = img->exif_maker[0] = img->exif_model[0] = img->exif_lens[0]
+      = img->exif_datetime_taken[0] = '\0';
+  str = (char *)sqlite3_column_text(stmt, 5);
+  if(str) g_strlcpy(img->filename, str, sizeof(img->filename));
+  str = (char *)sqlite3_column_text(stmt, 6);
+  if(str) g_strlcpy(img->exif_maker, str, sizeof(img->exif_maker));
+  str = (char *)sqlite3_column_text(stmt, 7);
+  if(str) g_strlcpy(img->exif_model, str, sizeof(img->exif_model));
+  str = (char *)sqlite3_column_text(stmt, 8);
+  if(str) g_strlcpy(img->exif_lens, str, sizeof(img->exif_lens));
+  img->exif_exposure = sqlite3_column_double(stmt, 9);
+  img->exif_aperture = sqlite3_column_double(stmt, 10);
+  img->exif_iso = sqlite3_column_double(stmt, 11);
+  img->exif_focal_length = sqlite3_column_double(stmt, 12);
+  str = (char *)sqlite3_column_text(stmt, 13);
+  if(str) g_strlcpy(img->exif_datetime_taken, str, sizeof(img->exif_datetime_taken));
+  img->flags = sqlite3_column_int(stmt, 14);
+  img->loader = LOADER_UNKNOWN;
+  img->exif_crop = sqlite3_column_double(stmt, 15);
+  img->orientation = sqlite3_column_int(stmt, 16);
+  img->exif_focus_distance = sqlite3_column_double(stmt, 17);
+  if(img->exif_focus_distance >= 0 && img->orientation >= 0) img->exif_inited = 1;
+  uint32_t tmp = sqlite3_column_int(stmt, 18);
+  memcpy(&img->legacy_flip, &tmp, sizeof(dt_image_raw_parameters_t));
+  if(sqlite3_column_type(stmt, 19) == SQLITE_FLOAT)
+    img->geoloc.longitude = sqlite3_column_double(stmt, 19);
+  else
+    img->geoloc.longitude = NAN;
+  if(sqlite3_column_type(stmt, 20) == SQLITE_FLOAT)
+    img->geoloc.latitude = sqlite3_column_double(stmt, 20);
+  else
+    img->geoloc.latitude = NAN;
+  if(sqlite3_column_type(stmt, 21) == SQLITE_FLOAT)
+    img->geoloc.elevation = sqlite3_column_double(stmt, 21);
+  else
+    img->geoloc.elevation = NAN;
+  const void *color_matrix = sqlite3_column_blob(stmt, 22);
+  if(color_matrix)
+    memcpy(img->d65_color_matrix, color_matrix, sizeof(img->d65_color_matrix));
+  else
+    img->d65_color_matrix[0] = NAN;
+  g_free(img->profile);
+  img->profile = NULL;
+  img->profile_size = 0;
+  img->colorspace = sqlite3_column_int(stmt, 23);
+  img->version = sqlite3_column_int(stmt, 24);
+  img->raw_black_level = sqlite3_column_int(stmt, 25);
+  for(uint8_t i = 0; i < 4; i++) img->raw_black_level_separate[i] = 0;
+  img->raw_white_point = sqlite3_column_int(stmt, 26);
+  if(sqlite3_column_type(stmt, 27) == SQLITE_FLOAT)
+    img->aspect_ratio = sqlite3_column_double(stmt, 27);
+  else
+    img->aspect_ratio = 0.0;
+
+  // buffer size? colorspace?
+  if(img->flags & DT_IMAGE_LDR)
+  {
+    img->buf_dsc.channels = 4;
+    img->buf_dsc.datatype = TYPE_FLOAT;
+    img->buf_dsc.cst = iop_cs_rgb;
+  }
+  else if(img->flags & DT_IMAGE_HDR)
+  {
+    if(img->flags & DT_IMAGE_RAW)
+    {
+      img->buf_dsc.channels = 1;
+      img->buf_dsc.datatype = TYPE_FLOAT;
+      img->buf_dsc.cst = iop_cs_RAW;
+    }
+    else
+    {
+      img->buf_dsc.channels = 4;
+      img->buf_dsc.datatype = TYPE_FLOAT;
+      img->buf_dsc.cst = iop_cs_rgb;
+    }
+  }
+  else
+  {
+    // raw
+    img->buf_dsc.channels = 1;
+    img->buf_dsc.datatype = TYPE_UINT16;
+    img->buf_dsc.cst = iop_cs_RAW;
+  }
+}
+
+static void _image_free(gpointer data)
+{
+  dt_image_t *img = (dt_image_t *)data;
+  g_free(img->profile);
+  g_free(img);
+}
+
 void dt_image_cache_allocate(void *data, dt_cache_entry_t *entry)
 {
+  dt_image_cache_t *cache = (dt_image_cache_t *)data;
   entry->cost = sizeof(dt_image_t);
 
-  dt_image_t *img = (dt_image_t *)g_malloc(sizeof(dt_image_t));
+  // take it over if a batch load got it already
+  dt_pthread_mutex_lock(&cache->prefetch_lock);
+  dt_image_t *img = (dt_image_t *)g_hash_table_lookup(cache->prefetched, GINT_TO_POINTER(entry->key));
+  if(img) g_hash_table_steal(cache->prefetched, GINT_TO_POINTER(entry->key));
+  dt_pthread_mutex_unlock(&cache->prefetch_lock);
+  if(img)
+  {
+    entry->data = img;
+    img->cache_entry = entry;
+    return;
+  }
+
+  img = (dt_image_t *)g_malloc(sizeof(dt_image_t));
   dt_image_init(img);
   entry->data = img;
   // load stuff from db and store in cache:
-  char *str;
   sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
-      "SELECT id, group_id, film_id, width, height, filename, maker, model, lens, exposure, "
-      "aperture, iso, focal_length, datetime_taken, flags, crop, orientation, focus_distance, "
-      "raw_parameters, longitude, latitude, altitude, color_matrix, colorspace, version, raw_black, "
-      "raw_maximum, aspect_ratio FROM main.images WHERE id = ?1",
-      -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT " DT_IMAGE_CACHE_COLUMNS " FROM main.images WHERE id = ?1", -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, entry->key);
   if(sqlite3_step(stmt) == SQLITE_ROW)
   {
-    img->id = sqlite3_column_int(stmt, 0);
-    img->group_id = sqlite3_column_int(stmt, 1);
-    img->film_id = sqlite3_column_int(stmt, 2);
-    img->width = sqlite3_column_int(stmt, 3);
-    img->height = sqlite3_column_int(stmt, 4);
-    img->crop_x = img->crop_y = img->crop_width = img->crop_height = 0;
-    img->filename[0] = img->exif_maker[0] = img->exif_model[0] = img->exif_lens[0]
-        = img->exif_datetime_taken[0] = '\0';
-    str = (char *)sqlite3_column_text(stmt, 5);
-    if(str) g_strlcpy(img->filename, str, sizeof(img->filename));
-    str = (char *)sqlite3_column_text(stmt, 6);
-    if(str) g_strlcpy(img->exif_maker, str, sizeof(img->exif_maker));
-    str = (char *)sqlite3_column_text(stmt, 7);
-    if(str) g_strlcpy(img->exif_model, str, sizeof(img->exif_model));
-    str = (char *)sqlite3_column_text(stmt, 8);
-    if(str) g_strlcpy(img->exif_lens, str, sizeof(img->exif_lens));
-    img->exif_exposure = sqlite3_column_double(stmt, 9);
-    img->exif_aperture = sqlite3_column_double(stmt, 10);
-    img->exif_iso = sqlite3_column_double(stmt, 11);
-    img->exif_focal_length = sqlite3_column_double(stmt, 12);
-    str = (char *)sqlite3_column_text(stmt, 13);
-    if(str) g_strlcpy(img->exif_datetime_taken, str, sizeof(img->exif_datetime_taken));
-    img->flags = sqlite3_column_int(stmt, 14);
-    img->loader = LOADER_UNKNOWN;
-    img->exif_crop = sqlite3_column_double(stmt, 15);
-    img->orientation = sqlite3_column_int(stmt, 16);
-    img->exif_focus_distance = sqlite3_column_double(stmt, 17);
-    if(img->exif_focus_distance >= 0 && img->orientation >= 0) img->exif_inited = 1;
-    uint32_t tmp = sqlite3_column_int(stmt, 18);
-    memcpy(&img->legacy_flip, &tmp, sizeof(dt_image_raw_parameters_t));
-    if(sqlite3_column_type(stmt, 19) == SQLITE_FLOAT)
-      img->geoloc.longitude = sqlite3_column_double(stmt, 19);
-    else
-      img->geoloc.longitude = NAN;
-    if(sqlite3_column_type(stmt, 20) == SQLITE_FLOAT)
-      img->geoloc.latitude = sqlite3_column_double(stmt, 20);
-    else
-      img->geoloc.latitude = NAN;
-    if(sqlite3_column_type(stmt, 21) == SQLITE_FLOAT)
-      img->geoloc.elevation = sqlite3_column_double(stmt, 21);
-    else
-      img->geoloc.elevation = NAN;
-    const void *color_matrix = sqlite3_column_blob(stmt, 22);
-    if(color_matrix)
-      memcpy(img->d65_color_matrix, color_matrix, sizeof(img->d65_color_matrix));
-    else
-      img->d65_color_matrix[0] = NAN;
-    g_free(img->profile);
-    img->profile = NULL;
-    img->profile_size = 0;
-    img->colorspace = sqlite3_column_int(stmt, 23);
-    img->version = sqlite3_column_int(stmt, 24);
-    img->raw_black_level = sqlite3_column_int(stmt, 25);
-    for(uint8_t i = 0; i < 4; i++) img->raw_black_level_separate[i] = 0;
-    img->raw_white_point = sqlite3_column_int(stmt, 26);
-    if(sqlite3_column_type(stmt, 27) == SQLITE_FLOAT)
-      img->aspect_ratio = sqlite3_column_double(stmt, 27);
-    else
-      img->aspect_ratio = 0.0;
-
-    // buffer size? colorspace?
-    if(img->flags & DT_IMAGE_LDR)
-    {
-      img->buf_dsc.channels = 4;
-      img->buf_dsc.datatype = TYPE_FLOAT;
-      img->buf_dsc.cst = iop_cs_rgb;
-    }
-    else if(img->flags & DT_IMAGE_HDR)
-    {
-      if(img->flags & DT_IMAGE_RAW)
-      {
-        img->buf_dsc.channels = 1;
-        img->buf_dsc.datatype = TYPE_FLOAT;
-        img->buf_dsc.cst = iop_cs_RAW;
-      }
-      else
-      {
-        img->buf_dsc.channels = 4;
-        img->buf_dsc.datatype = TYPE_FLOAT;
-        img->buf_dsc.cst = iop_cs_rgb;
-      }
-    }
-    else
-    {
-      // raw
-      img->buf_dsc.channels = 1;
-      img->buf_dsc.datatype = TYPE_UINT16;
-      img->buf_dsc.cst = iop_cs_RAW;
-    }
+    _image_cache_fill(img, stmt);
   }
   else
   {
@@ -150,9 +178,7 @@ void dt_image_cache_allocate(void *data, dt_cache_entry_t *entry)
 
 void dt_image_cache_deallocate(void *data, dt_cache_entry_t *entry)
 {
-  dt_image_t *img = (dt_image_t *)entry->data;
-  g_free(img->profile);
-  g_free(img);
+  _image_free(entry->data);
 }
 
 void dt_image_cache_init(dt_image_cache_t *cache)
@@ -160,21 +186,25 @@ void dt_image_cache_init(dt_image_cache_t *cache)
   // the image cache does no serialization.
   // (unsafe. data should be in db/xmp, not in any other additional cache,
   // also, it should be relatively fast to get the image_t structs from sql.)
-  // TODO: actually an independent conf var?
-  //       too large: dangerous and wasteful?
-  //       can we get away with a fixed size?
-  const uint32_t max_mem = 50 * 1024 * 1024;
-  const uint32_t num = (uint32_t)(1.5f * max_mem / sizeof(dt_image_t));
+  const int64_t cache_memory = dt_conf_get_int64("cache_memory_images");
+  const size_t max_mem = CLAMPS(cache_memory, 4 * 1024 * 1024, 1024 * 1024 * 1024);
+  const uint32_t num = (uint32_t)(max_mem / sizeof(dt_image_t));
   dt_cache_init(&cache->cache, sizeof(dt_image_t), max_mem);
   dt_cache_set_allocate_callback(&cache->cache, &dt_image_cache_allocate, cache);
   dt_cache_set_cleanup_callback(&cache->cache, &dt_image_cache_deallocate, cache);
 
+  dt_pthread_mutex_init(&cache->prefetch_lock, NULL);
+  cache->prefetched = g_hash_table_new_full(NULL, NULL, NULL, _image_free);
+  cache->prefetch_generation = 0;
+
   dt_print(DT_DEBUG_CACHE, "[image_cache] has %d entries\n", num);
 }
 
 void dt_image_cache_cleanup(dt_image_cache_t *cache)
 {
   dt_cache_cleanup(&cache->cache);
+  g_hash_table_destroy(cache->prefetched);
+  dt_pthread_mutex_destroy(&cache->prefetch_lock);
 }
 
 void dt_image_cache_print(dt_image_cache_t *cache)
@@ -213,6 +243,15 @@ void dt_image_cache_read_release(dt_image_cache_t *cache, const dt_image_t *img)
   dt_cache_release(&cache->cache, img->cache_entry);
 }
 
+// a prefetched copy of this image would be outdated now
+static void _image_cache_invalidate_prefetched(dt_image_cache_t *cache, const uint32_t imgid)
+{
+  dt_pthread_mutex_lock(&cache->prefetch_lock);
+  cache->prefetch_generation++;
+  g_hash_table_remove(cache->prefetched, GINT_TO_POINTER(imgid));
+  dt_pthread_mutex_unlock(&cache->prefetch_lock);
+}
+
 // drops the write privileges on an image struct.
 // this triggers a write-through to sql, and if the setting
 // is present, also to xmp sidecar files (safe setting).
@@ -271,13 +310,14 @@ void dt_image_cache_write_release(dt_image_cache_t *cache, dt_image_t *img, dt_i
   const int rc = sqlite3_step(stmt);
   if(rc != SQLITE_DONE) fprintf(stderr, "[image_cache_write_release] sqlite3 error %d\n", rc);
   sqlite3_finalize(stmt);
+  _image_cache_invalidate_prefetched(cache, img->id);
 
   // TODO: make this work in relaxed mode, too.
   if(mode == DT_IMAGE_CACHE_SAFE)
   {
     // rest about sidecars:
-    // also synch dttags file:
-    dt_image_write_sidecar_file(img->id);
+    // also synch dttags file, in the background as bulk changes come through here one image at a time:
+    dt_control_queue_sidecar_file(img->id);
   }
   dt_cache_release(&cache->cache, img->cache_entry);
 }
@@ -286,9 +326,82 @@ void dt_image_cache_write_release(dt_image_cache_t *cache, dt_image_t *img, dt_i
 // remove the image from the cache
 void dt_image_cache_remove(dt_image_cache_t *cache, const uint32_t imgid)
 {
+  _image_cache_invalidate_prefetched(cache, imgid);
   dt_cache_remove(&cache->cache, imgid);
 }
 
+void dt_image_cache_prefetch(dt_image_cache_t *cache, const int *imgids, const int count)
+{
+  // only ask the database for the ones which are missing
+  gchar *ids = NULL;
+  int missing = 0;
+  for(int k = 0; k < count; k++)
+  {
+    if(imgids[k] <= 0 || dt_cache_contains(&cache->cache, imgids[k])) continue;
+    ids = dt_util_dstrcat(ids, missing ? ",%d" : "%d", imgids[k]);
+    missing++;
+  }
+  // a single one isn't loaded any faster than by the cache itself
+  if(missing < 2)
+  {
+    g_free(ids);
+    return;
+  }
+
+  // remember which write-throughs happened before our rows were read
+  dt_pthread_mutex_lock(&cache->prefetch_lock);
+  const uint64_t generation = cache->prefetch_generation;
+  dt_pthread_mutex_unlock(&cache->prefetch_lock);
+
+  gchar *query = g_strdup_printf("SELECT " DT_IMAGE_CACHE_COLUMNS " FROM main.images WHERE id IN (%s)", ids);
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  GList *images = NULL;
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    dt_image_t *img = (dt_image_t *)g_malloc(sizeof(dt_image_t));
+    dt_image_init(img);
+    _image_cache_fill(img, stmt);
+    dt_image_refresh_makermodel(img);
+    images = g_list_prepend(images, img);
+  }
+  sqlite3_finalize(stmt);
+  g_free(query);
+  g_free(ids);
+
+  // if any image got written meanwhile we can't tell whether our row is older than that.
+  // drop the whole batch then, the cache loads them one by one as usual.
+  GList *loaded = NULL;
+  dt_pthread_mutex_lock(&cache->prefetch_lock);
+  const gboolean current = generation == cache->prefetch_generation;
+  for(GList *l = images; l; l = g_list_next(l))
+  {
+    dt_image_t *img = (dt_image_t *)l->data;
+    if(current)
+    {
+      g_hash_table_replace(cache->prefetched, GINT_TO_POINTER(img->id), img);
+      loaded = g_list_prepend(loaded, GINT_TO_POINTER(img->id));
+    }
+    else
+      _image_free(img);
+  }
+  dt_pthread_mutex_unlock(&cache->prefetch_lock);
+  g_list_free(images);
+
+  // move them into the cache, the allocate callback takes them over
+  for(GList *l = loaded; l; l = g_list_next(l))
+  {
+    dt_cache_entry_t *entry = dt_cache_get(&cache->cache, GPOINTER_TO_INT(l->data), 'r');
+    dt_cache_release(&cache->cache, entry);
+  }
+
+  // drop what was cached by someone else meanwhile, it must not turn up later with stale data
+  dt_pthread_mutex_lock(&cache->prefetch_lock);
+  for(GList *l = loaded; l; l = g_list_next(l)) g_hash_table_remove(cache->prefetched, l->data);
+  dt_pthread_mutex_unlock(&cache->prefetch_lock);
+  g_list_free(loaded);
+}
+
 
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
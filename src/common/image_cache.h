@@ -24,6 +24,12 @@
 typedef struct dt_image_cache_t
 {
   dt_cache_t cache;
+
+  // images loaded by dt_image_cache_prefetch() on their way into the cache
+  dt_pthread_mutex_t prefetch_lock;
+  GHashTable *prefetched;
+  // bumped on every write-through, prefetched rows read before that are dropped
+  uint64_t prefetch_generation;
 }
 dt_image_cache_t;
 
@@ -66,6 +72,10 @@ void dt_image_cache_write_release(dt_image_cache_t *cache, dt_image_t *img, dt_i
 // remove the image from the cache
 void dt_image_cache_remove(dt_image_cache_t *cache, const uint32_t imgid);
 
+// loads all of the given images which are not in the cache yet with one query, instead of one query each
+// on their first dt_image_cache_get(). meant for views about to go through a whole page of images.
+void dt_image_cache_prefetch(dt_image_cache_t *cache, const int *imgids, const int count);
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -22,8 +22,10 @@
 #include "common/colorlabels.h"
 #include "common/colorspaces.h"
 #include "common/darktable.h"
+#include "common/database.h"
 #include "common/debug.h"
 #include "common/exif.h"
+#include "common/export_report.h"
 #include "common/image_cache.h"
 #include "common/imageio.h"
 #include "common/imageio_module.h"
@@ -72,38 +74,134 @@
 #endif
 
 // load a full-res thumbnail:
+// where the embedded jpeg thumbnail of an image has been found on an earlier visit
+static gboolean _thumbnail_location_get(const int imgid, const gint64 mtime, gint64 *offset, gint64 *size)
+{
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT offset, size FROM main.embedded_thumbnails WHERE imgid = ?1 AND mtime = ?2",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 2, mtime);
+  const gboolean found = sqlite3_step(stmt) == SQLITE_ROW;
+  if(found)
+  {
+    *offset = sqlite3_column_int64(stmt, 0);
+    *size = sqlite3_column_int64(stmt, 1);
+  }
+  sqlite3_finalize(stmt);
+  return found;
+}
+
+static void _thumbnail_location_set(const int imgid, const gint64 mtime, const gint64 offset, const gint64 size)
+{
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "INSERT OR REPLACE INTO main.embedded_thumbnails (imgid, offset, size, mtime) "
+                              "VALUES (?1, ?2, ?3, ?4)",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 2, offset);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 3, size);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 4, mtime);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+// checks that the thumbnail extracted by exiv2 starts where its tags say. they are relative to the tiff
+// header, which isn't at the start of every raw. comparing the first few kb only touches a page or two.
+static gint64 _thumbnail_check(const uint8_t *file, const size_t file_size, const gint64 offset,
+                               const uint8_t *thumb, const size_t thumb_size)
+{
+  if(!file || offset < 0 || thumb_size > file_size || (size_t)offset > file_size - thumb_size) return -1;
+  return memcmp(file + offset, thumb, MIN(thumb_size, 4096)) ? -1 : offset;
+}
+
+static int _thumbnail_decompress_jpeg(const uint8_t *buf, const size_t bufsize, const int min_width,
+                                      const int min_height, uint8_t **buffer, int32_t *width, int32_t *height,
+                                      dt_colorspaces_color_profile_type_t *color_space)
+{
+  // Decompress the JPG into our own memory format
+  dt_imageio_jpeg_t jpg;
+  if(dt_imageio_jpeg_decompress_header(buf, bufsize, &jpg)) return 1;
+  // no need to decode more pixels than the caller is going to downsample to anyway
+  dt_imageio_jpeg_decompress_scale(&jpg, min_width, min_height);
+  *buffer = (uint8_t *)dt_alloc_align(64, (size_t)sizeof(uint8_t) * jpg.width * jpg.height * 4);
+  if(!*buffer)
+  {
+    jpeg_destroy_decompress(&(jpg.dinfo));
+    return 1;
+  }
+
+  *width = jpg.width;
+  *height = jpg.height;
+  // TODO: check if the embedded thumbs have a color space set! currently we assume that it's always sRGB
+  *color_space = DT_COLORSPACE_SRGB;
+  if(dt_imageio_jpeg_decompress(&jpg, *buffer))
+  {
+    dt_free_align(*buffer);
+    *buffer = NULL;
+    return 1;
+  }
+  return 0;
+}
+
 int dt_imageio_large_thumbnail(const char *filename, uint8_t **buffer, int32_t *width, int32_t *height,
-                               dt_colorspaces_color_profile_type_t *color_space)
+                               dt_colorspaces_color_profile_type_t *color_space, const int imgid,
+                               const int min_width, const int min_height)
 {
   int res = 1;
 
   uint8_t *buf = NULL;
   char *mime_type = NULL;
   size_t bufsize;
+  GMappedFile *file = NULL;
+
+  // fast path: decode the thumbnail right where it sits in the raw, only touching the pages it spans
+  GStatBuf statbuf;
+  gint64 mtime = 0, offset = -1, size = 0;
+  int64_t tag_offset = -1;
+  gboolean known = FALSE;
+  if(imgid > 0 && !g_stat(filename, &statbuf))
+  {
+    mtime = statbuf.st_mtime;
+    known = _thumbnail_location_get(imgid, mtime, &offset, &size);
+  }
+  if(known && offset >= 0)
+  {
+    file = g_mapped_file_new(filename, FALSE, NULL);
+    if(file && offset + size <= g_mapped_file_get_length(file)
+       && !_thumbnail_decompress_jpeg((const uint8_t *)g_mapped_file_get_contents(file) + offset, size, min_width,
+                                      min_height, buffer, width, height, color_space))
+    {
+      res = 0;
+      goto error;
+    }
+    // the file changed behind our back, look again
+    known = FALSE;
+  }
 
   // get the biggest thumb from exif
-  if(dt_exif_get_thumbnail(filename, &buf, &bufsize, &mime_type)) goto error;
+  if(dt_exif_get_thumbnail_ext(filename, &buf, &bufsize, &mime_type, &tag_offset)) goto error;
 
   if(strcmp(mime_type, "image/jpeg") == 0)
   {
-    // Decompress the JPG into our own memory format
-    dt_imageio_jpeg_t jpg;
-    if(dt_imageio_jpeg_decompress_header(buf, bufsize, &jpg)) goto error;
-    *buffer = (uint8_t *)dt_alloc_align(64, (size_t)sizeof(uint8_t) * jpg.width * jpg.height * 4);
-    if(!*buffer) goto error;
-
-    *width = jpg.width;
-    *height = jpg.height;
-    // TODO: check if the embedded thumbs have a color space set! currently we assume that it's always sRGB
-    *color_space = DT_COLORSPACE_SRGB;
-    if(dt_imageio_jpeg_decompress(&jpg, *buffer))
-    {
-      dt_free_align(*buffer);
-      *buffer = NULL;
+    if(_thumbnail_decompress_jpeg(buf, bufsize, min_width, min_height, buffer, width, height, color_space))
       goto error;
-    }
 
     res = 0;
+
+    // remember where it is for the next time, if the tags told us
+    if(imgid > 0 && !known && mtime && tag_offset >= 0)
+    {
+      if(!file) file = g_mapped_file_new(filename, FALSE, NULL);
+      if(file)
+      {
+        const gint64 found = _thumbnail_check((const uint8_t *)g_mapped_file_get_contents(file),
+                                              g_mapped_file_get_length(file), tag_offset, buf, bufsize);
+        if(found >= 0) _thumbnail_location_set(imgid, mtime, found, bufsize);
+      }
+    }
   }
   else
   {
@@ -173,6 +271,7 @@ int dt_imageio_large_thumbnail(const char *filename, uint8_t **buffer, int32_t *
   }
 
 error:
+  if(file) g_mapped_file_unref(file);
   free(mime_type);
   free(buf);
   return res;
@@ -622,17 +721,66 @@ int dt_imageio_export(const uint32_t imgid, const char *filename, dt_imageio_mod
                                         storage_params, num, total, metadata);
 }
 
-// internal function: to avoid exif blob reading + 8-bit byteorder flag + high-quality override
-int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
-                                 dt_imageio_module_format_t *format, dt_imageio_module_data_t *format_params,
-                                 const gboolean ignore_exif, const gboolean display_byteorder,
-                                 const gboolean high_quality, const gboolean upscale, const gboolean thumbnail_export,
-                                 const char *filter, const gboolean copy_metadata,
-                                 dt_colorspaces_color_profile_type_t icc_type, const gchar *icc_filename,
-                                 dt_iop_color_intent_t icc_intent,
-                                 dt_imageio_module_storage_t *storage,
-                                 dt_imageio_module_data_t *storage_params, int num, int total, dt_export_metadata_t *metadata)
+// output of the modules which all renditions of an image have in common, see dt_imageio_export_renditions()
+typedef struct dt_imageio_shared_input_t
+{
+  float *buf;
+  int width, height;
+  dt_iop_buffer_dsc_t dsc;
+} dt_imageio_shared_input_t;
+
+// the first module whose output depends on the rendition
+#define DT_IMAGEIO_SHARED_UNTIL "colorout"
+
+// applies the style items on top of the history of dev, returns 1 if the style doesn't exist
+static int _export_apply_style(dt_develop_t *dev, const uint32_t imgid, const char *style, const gboolean append)
 {
+  GList *style_items = dt_styles_get_item_list(style, TRUE, -1);
+  if(!style_items)
+  {
+    dt_control_log(_("cannot find the style '%s' to apply during export."), style);
+    return 1;
+  }
+
+  GList *modules_used = NULL;
+
+  int imgid_iop_order_version = dt_image_get_iop_order_version(imgid);
+  GList *current_iop_list = dt_ioppr_get_iop_order_list(&imgid_iop_order_version);
+
+  dt_dev_pop_history_items_ext(dev, dev->history_end);
+
+  GList *st_items = g_list_last(style_items);
+  while(st_items)
+  {
+    dt_style_item_t *st_item = (dt_style_item_t *)(st_items->data);
+
+    // we need to adjust the iop-order for each item
+
+    st_item->iop_order =
+      dt_ioppr_get_iop_order(current_iop_list, st_item->operation) + (double)st_item->multi_priority / 100.0f;
+
+    dt_styles_apply_style_item(dev, st_item, &modules_used, append);
+
+    st_items = g_list_previous(st_items);
+  }
+
+  g_list_free(modules_used);
+  g_list_free_full(style_items, dt_style_item_free);
+  g_list_free_full(current_iop_list, free);
+  return 0;
+}
+
+static int _export_image(const uint32_t imgid, const char *filename, dt_imageio_module_format_t *format,
+                         dt_imageio_module_data_t *format_params, const gboolean ignore_exif,
+                         const gboolean display_byteorder, const gboolean high_quality, const gboolean upscale,
+                         const gboolean thumbnail_export, const char *filter, const gboolean copy_metadata,
+                         dt_colorspaces_color_profile_type_t icc_type, const gchar *icc_filename,
+                         dt_iop_color_intent_t icc_intent, dt_imageio_module_storage_t *storage,
+                         dt_imageio_module_data_t *storage_params, int num, int total,
+                         dt_export_metadata_t *metadata, const dt_imageio_shared_input_t *shared)
+{
+  dt_export_report_t *report = thumbnail_export ? NULL : dt_export_report_new(imgid, filename);
+
   dt_develop_t dev;
   dt_dev_init(&dev, 0);
   dt_dev_load_image(&dev, imgid);
@@ -640,15 +788,17 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
   const int buf_is_downscaled
       = (thumbnail_export && dt_conf_get_bool("plugins/lighttable/low_quality_thumbnails"));
 
-  dt_mipmap_buffer_t buf;
-  if(buf_is_downscaled)
-    dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, DT_MIPMAP_F, DT_MIPMAP_BLOCKING, 'r');
-  else
-    dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
+  // renditions which start from a shared buffer don't need the image itself
+  dt_mipmap_buffer_t buf = { 0 };
+  double stage_start = dt_get_wtime();
+  if(!shared)
+    dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, buf_is_downscaled ? DT_MIPMAP_F : DT_MIPMAP_FULL,
+                        DT_MIPMAP_BLOCKING, 'r');
+  dt_export_report_time(report, DT_EXPORT_REPORT_LOAD, dt_get_wtime() - stage_start);
 
   const dt_image_t *img = &dev.image_storage;
 
-  if(!buf.buf || !buf.width || !buf.height)
+  if(!shared && (!buf.buf || !buf.width || !buf.height))
   {
     fprintf(stderr, "allocation failed???\n");
     dt_control_log(_("image `%s' is not available!"), img->filename);
@@ -673,48 +823,25 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
         thumbnail_export ? C_("noun", "thumbnail export") : C_("noun", "export"));
     goto error;
   }
+  pipe.report = report;
 
   //  If a style is to be applied during export, add the iop params into the history
-  if(!thumbnail_export && format_params->style[0] != '\0')
-  {
-    GList *style_items = dt_styles_get_item_list(format_params->style, TRUE, -1);
-    if(!style_items)
-    {
-      dt_control_log(_("cannot find the style '%s' to apply during export."), format_params->style);
-      goto error;
-    }
-
-    GList *modules_used = NULL;
-
-    int imgid_iop_order_version = dt_image_get_iop_order_version(imgid);
-    GList *current_iop_list = dt_ioppr_get_iop_order_list(&imgid_iop_order_version);
-
-    dt_dev_pop_history_items_ext(&dev, dev.history_end);
-
-    GList *st_items = g_list_last(style_items);
-    while(st_items)
-    {
-      dt_style_item_t *st_item = (dt_style_item_t *)(st_items->data);
-
-      // we need to adjust the iop-order for each item
-
-      st_item->iop_order =
-        dt_ioppr_get_iop_order(current_iop_list, st_item->operation) + (double)st_item->multi_priority / 100.0f;
-
-      dt_styles_apply_style_item(&dev, st_item, &modules_used, format_params->style_append);
-
-      st_items = g_list_previous(st_items);
-    }
-
-    g_list_free(modules_used);
-    g_list_free_full(style_items, dt_style_item_free);
-    g_list_free_full(current_iop_list, free);
-  }
+  if(!thumbnail_export && format_params->style[0] != '\0'
+     && _export_apply_style(&dev, imgid, format_params->style, format_params->style_append))
+    goto error;
 
   dt_dev_pixelpipe_set_icc(&pipe, icc_type, icc_filename, icc_intent);
-  dt_dev_pixelpipe_set_input(&pipe, &dev, (float *)buf.buf, buf.width, buf.height, buf.iscale);
+  if(shared)
+  {
+    dt_dev_pixelpipe_set_input(&pipe, &dev, shared->buf, shared->width, shared->height, 1.0f);
+    // the modules up to the shared one already ran, the pipe continues from their output
+    pipe.image.buf_dsc = pipe.dsc = shared->dsc;
+  }
+  else
+    dt_dev_pixelpipe_set_input(&pipe, &dev, (float *)buf.buf, buf.width, buf.height, buf.iscale);
   dt_dev_pixelpipe_create_nodes(&pipe, &dev);
   dt_dev_pixelpipe_synch_all(&pipe, &dev);
+  if(shared) dt_dev_pixelpipe_disable_before(&pipe, DT_IMAGEIO_SHARED_UNTIL);
 
   if(filter)
   {
@@ -832,6 +959,7 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
 
     if(finalscale) finalscale->enabled = 1;
   }
+  dt_export_report_time(report, DT_EXPORT_REPORT_PIPE, dt_get_wtime() - start.clock);
   dt_show_times(&start, thumbnail_export ? "[dev_process_thumbnail] pixel pipeline processing"
                                          : "[dev_process_export] pixel pipeline processing");
 
@@ -911,6 +1039,13 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
   format_params->width = processed_width;
   format_params->height = processed_height;
 
+  const gboolean attach_xmp = copy_metadata && (format->flags(format_params) & FORMAT_FLAGS_SUPPORT_XMP);
+  // formats which embed the metadata while encoding get all of it up front, sparing a rewrite of the file
+  dt_exif_blobs_t *blobs = NULL;
+  // the time of the write block minus what went into reading and preparing the metadata is the encoding
+  const double write_start = dt_get_wtime();
+  double metadata_time = 0.0;
+
   if(!ignore_exif)
   {
     int length;
@@ -921,10 +1056,35 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
     gboolean from_cache = TRUE;
     dt_image_full_path(imgid, pathname, sizeof(pathname), &from_cache);
     // last param is dng mode, it's false here
+    stage_start = dt_get_wtime();
     length = dt_exif_read_blob(&exif_profile, pathname, imgid, sRGB, processed_width, processed_height, 0);
+    const double exif_time = dt_get_wtime() - stage_start;
+    dt_export_report_time(report, DT_EXPORT_REPORT_EXIF, exif_time);
+    metadata_time += exif_time;
 
-    res = format->write_image(format_params, filename, outbuf, icc_type, icc_filename, exif_profile, length, imgid,
-                              num, total, &pipe);
+    if(format->set_metadata)
+    {
+      stage_start = dt_get_wtime();
+      blobs = dt_exif_export_blobs(imgid, exif_profile, length, metadata, attach_xmp, TRUE);
+      if(blobs && format->set_metadata(format_params, blobs))
+      {
+        dt_exif_blobs_free(blobs);
+        blobs = NULL;
+      }
+      const double blobs_time = dt_get_wtime() - stage_start;
+      dt_export_report_time(report, DT_EXPORT_REPORT_METADATA, blobs_time);
+      metadata_time += blobs_time;
+    }
+
+    if(blobs)
+    {
+      res = format->write_image(format_params, filename, outbuf, icc_type, icc_filename, NULL, 0, imgid, num,
+                                total, &pipe);
+      format->set_metadata(format_params, NULL);
+    }
+    else
+      res = format->write_image(format_params, filename, outbuf, icc_type, icc_filename, exif_profile, length,
+                                imgid, num, total, &pipe);
 
     free(exif_profile);
   }
@@ -933,17 +1093,21 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
     res = format->write_image(format_params, filename, outbuf, icc_type, icc_filename, NULL, 0, imgid, num, total,
                               &pipe);
   }
+  dt_export_report_time(report, DT_EXPORT_REPORT_ENCODE, dt_get_wtime() - write_start - metadata_time);
 
   dt_dev_pixelpipe_cleanup(&pipe);
   dt_dev_cleanup(&dev);
-  dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+  if(!shared) dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
 
-  /* now write xmp into that container, if possible */
-  if(copy_metadata && (format->flags(format_params) & FORMAT_FLAGS_SUPPORT_XMP))
+  /* now write xmp into that container, if possible and not done already */
+  if(attach_xmp && !blobs)
   {
+    stage_start = dt_get_wtime();
     dt_exif_xmp_attach_export(imgid, filename, metadata);
     // no need to cancel the export if this fail
+    dt_export_report_time(report, DT_EXPORT_REPORT_METADATA, dt_get_wtime() - stage_start);
   }
+  dt_exif_blobs_free(blobs);
 
   if(!thumbnail_export && strcmp(format->mime(format_params), "memory")
     && !(format->flags(format_params) & FORMAT_FLAGS_NO_TMPFILE))
@@ -974,16 +1138,154 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
                             format_params, storage, storage_params);
   }
 
+  dt_export_report_finish(report, res);
   return res;
 
 error:
   dt_dev_pixelpipe_cleanup(&pipe);
 error_early:
   dt_dev_cleanup(&dev);
-  dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+  if(!shared) dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+  dt_export_report_finish(report, 1);
   return 1;
 }
 
+// internal function: to avoid exif blob reading + 8-bit byteorder flag + high-quality override
+int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
+                                 dt_imageio_module_format_t *format, dt_imageio_module_data_t *format_params,
+                                 const gboolean ignore_exif, const gboolean display_byteorder,
+                                 const gboolean high_quality, const gboolean upscale, const gboolean thumbnail_export,
+                                 const char *filter, const gboolean copy_metadata,
+                                 dt_colorspaces_color_profile_type_t icc_type, const gchar *icc_filename,
+                                 dt_iop_color_intent_t icc_intent,
+                                 dt_imageio_module_storage_t *storage,
+                                 dt_imageio_module_data_t *storage_params, int num, int total, dt_export_metadata_t *metadata)
+{
+  return _export_image(imgid, filename, format, format_params, ignore_exif, display_byteorder, high_quality,
+                       upscale, thumbnail_export, filter, copy_metadata, icc_type, icc_filename, icc_intent, storage,
+                       storage_params, num, total, metadata, NULL);
+}
+
+// processes the modules before DT_IMAGEIO_SHARED_UNTIL at full resolution, returns 0 on success
+static int _export_shared_input(const uint32_t imgid, const char *style, const gboolean style_append,
+                                dt_imageio_shared_input_t *shared)
+{
+  int res = 1;
+  // the shared part gets a report line of its own, the renditions only account for what they did themselves
+  dt_export_report_t *report = dt_export_report_new(imgid, NULL);
+  dt_develop_t dev;
+  dt_dev_init(&dev, 0);
+  dt_dev_load_image(&dev, imgid);
+
+  dt_mipmap_buffer_t buf;
+  const double load_start = dt_get_wtime();
+  dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
+  dt_export_report_time(report, DT_EXPORT_REPORT_LOAD, dt_get_wtime() - load_start);
+  if(!buf.buf || !buf.width || !buf.height)
+  {
+    dt_control_log(_("image `%s' is not available!"), dev.image_storage.filename);
+    goto error_early;
+  }
+
+  dt_times_t start;
+  dt_get_times(&start);
+  dt_dev_pixelpipe_t pipe;
+  if(!dt_dev_pixelpipe_init_export(&pipe, dev.image_storage.width, dev.image_storage.height,
+                                   IMAGEIO_RGB | IMAGEIO_FLOAT, FALSE))
+    goto error;
+  pipe.report = report;
+
+  if(style[0] != '\0' && _export_apply_style(&dev, imgid, style, style_append)) goto error;
+
+  dt_dev_pixelpipe_set_input(&pipe, &dev, (float *)buf.buf, buf.width, buf.height, buf.iscale);
+  dt_dev_pixelpipe_create_nodes(&pipe, &dev);
+  dt_dev_pixelpipe_synch_all(&pipe, &dev);
+
+  // everything from the first rendition dependent module on is left to the renditions
+  for(GList *nodes = g_list_last(pipe.nodes); nodes; nodes = g_list_previous(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    piece->enabled = 0;
+    if(!strcmp(piece->module->op, DT_IMAGEIO_SHARED_UNTIL)) break;
+  }
+
+  dt_dev_pixelpipe_get_dimensions(&pipe, &dev, pipe.iwidth, pipe.iheight, &pipe.processed_width,
+                                  &pipe.processed_height);
+  const int width = pipe.processed_width;
+  const int height = pipe.processed_height;
+  if(dt_dev_pixelpipe_process_no_gamma(&pipe, &dev, 0, 0, width, height, 1.0f) || !pipe.backbuf) goto error;
+  dt_export_report_time(report, DT_EXPORT_REPORT_PIPE, dt_get_wtime() - start.clock);
+
+  shared->buf = dt_alloc_align(64, sizeof(float) * 4 * width * height);
+  if(!shared->buf) goto error;
+  memcpy(shared->buf, pipe.backbuf, sizeof(float) * 4 * width * height);
+  shared->width = width;
+  shared->height = height;
+  shared->dsc = pipe.dsc;
+  res = 0;
+  dt_show_times_f(&start, "[export]", "processing shared part of the renditions (%dx%d)", width, height);
+
+error:
+  dt_dev_pixelpipe_cleanup(&pipe);
+error_early:
+  dt_dev_cleanup(&dev);
+  dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+  dt_export_report_finish(report, res);
+  return res;
+}
+
+// renditions which can start from the same shared buffer as reference
+static gboolean _rendition_shares(const dt_imageio_rendition_t *r, const dt_imageio_rendition_t *reference)
+{
+  return r->high_quality && strcmp(r->format->mime(r->format_params), "x-copy")
+         && !strcmp(r->format_params->style, reference->format_params->style)
+         && (r->format_params->style[0] == '\0'
+             || r->format_params->style_append == reference->format_params->style_append);
+}
+
+int dt_imageio_export_renditions(const uint32_t imgid, const dt_imageio_rendition_t *renditions, const int count,
+                                 dt_export_metadata_t *metadata)
+{
+  // the first high quality rendition decides which style the shared part is processed with
+  const dt_imageio_rendition_t *reference = NULL;
+  int sharing = 0;
+  for(int k = 0; k < count; k++)
+  {
+    if(!reference && renditions[k].high_quality) reference = &renditions[k];
+    if(reference && _rendition_shares(&renditions[k], reference)) sharing++;
+  }
+
+  dt_imageio_shared_input_t shared = { 0 };
+  if(sharing > 1
+     && _export_shared_input(imgid, reference->format_params->style, reference->format_params->style_append,
+                             &shared))
+    fprintf(stderr, "[export] failed to process the shared part of image %d, exporting renditions one by one\n",
+            imgid);
+
+  int failed = 0;
+  for(int k = 0; k < count; k++)
+  {
+    const dt_imageio_rendition_t *r = &renditions[k];
+    if(shared.buf && _rendition_shares(r, reference))
+      failed += _export_image(imgid, r->filename, r->format, r->format_params, FALSE, FALSE, r->high_quality,
+                              r->upscale, FALSE, NULL, TRUE, r->icc_type, r->icc_filename, r->icc_intent, NULL,
+                              NULL, k + 1, count, metadata, &shared)
+                ? 1
+                : 0;
+    else
+      failed += dt_imageio_export(imgid, r->filename, r->format, r->format_params, r->high_quality, r->upscale,
+                                  TRUE, r->icc_type, r->icc_filename, r->icc_intent, NULL, NULL, k + 1, count,
+                                  metadata)
+                ? 1
+                : 0;
+  }
+
+  dt_free_align(shared.buf);
+  return failed;
+}
+
+#undef DT_IMAGEIO_SHARED_UNTIL
+
 
 // fallback read method in case file could not be opened yet.
 // use GraphicsMagick (if supported) to read exotic LDRs
@@ -80,6 +80,25 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
                                  dt_iop_color_intent_t icc_intent, dt_imageio_module_storage_t *storage,
                                  dt_imageio_module_data_t *storage_params, int num, int total, dt_export_metadata_t *metadata);
 
+/** one output of dt_imageio_export_renditions(). */
+typedef struct dt_imageio_rendition_t
+{
+  const char *filename;
+  struct dt_imageio_module_format_t *format;
+  struct dt_imageio_module_data_t *format_params;
+  gboolean high_quality;
+  gboolean upscale;
+  dt_colorspaces_color_profile_type_t icc_type;
+  const gchar *icc_filename;
+  dt_iop_color_intent_t icc_intent;
+} dt_imageio_rendition_t;
+
+/** exports one image to several outputs. the modules in front of the output color profile are processed only once
+ * at full resolution for all high quality renditions with the same style, those continue from that buffer.
+ * returns the number of renditions which failed. */
+int dt_imageio_export_renditions(const uint32_t imgid, const dt_imageio_rendition_t *renditions, const int count,
+                                 dt_export_metadata_t *metadata);
+
 size_t dt_imageio_write_pos(int i, int j, int wd, int ht, float fwd, float fht,
                             dt_image_orientation_t orientation);
 
@@ -99,8 +118,11 @@ void dt_imageio_flip_buffers_ui8_to_float(float *out, const uint8_t *in, const f
                                           const dt_image_orientation_t orientation);
 
 // allocate buffer and return 0 on success along with largest jpg thumbnail from raw.
+// jpegs are decoded at a reduced size if they still cover min_width x min_height, 0 for full size.
+// with imgid > 0 the thumbnail's position in the file is remembered to read it directly next time.
 int dt_imageio_large_thumbnail(const char *filename, uint8_t **buffer, int32_t *width, int32_t *height,
-                               dt_colorspaces_color_profile_type_t *color_space);
+                               dt_colorspaces_color_profile_type_t *color_space, const int imgid,
+                               const int min_width, const int min_height);
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -44,6 +44,9 @@ typedef struct dt_imageio_jpeg_t
 
 /** reads the header and fills width/height in jpg struct. */
 int dt_imageio_jpeg_decompress_header(const void *in, size_t length, dt_imageio_jpeg_t *jpg);
+/** lets libjpeg scale the image down by 1/2, 1/4 or 1/8 while decompressing, as far as it still covers
+ * min_width x min_height in either orientation. updates width/height in jpg. to be called after reading the header. */
+void dt_imageio_jpeg_decompress_scale(dt_imageio_jpeg_t *jpg, const int min_width, const int min_height);
 /** reads the whole image to the out buffer, which has to be large enough. */
 int dt_imageio_jpeg_decompress(dt_imageio_jpeg_t *jpg, uint8_t *out);
 /** compresses in to out buffer with given quality (0..100). out buffer must be large enough. returns actual
@@ -115,6 +115,8 @@ static int dt_imageio_load_module_format(dt_imageio_module_format_t *module, con
     module->flags = _default_format_flags;
   if(!g_module_symbol(module->module, "levels", (gpointer) & (module->levels)))
     module->levels = _default_format_levels;
+  if(!g_module_symbol(module->module, "set_metadata", (gpointer) & (module->set_metadata)))
+    module->set_metadata = NULL;
   if(!g_module_symbol(module->module, "read_image", (gpointer) & (module->read_image)))
     module->read_image = NULL;
 
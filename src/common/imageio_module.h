@@ -64,6 +64,7 @@ typedef struct dt_imageio_module_data_t
 
 struct dt_imageio_module_format_t;
 struct dt_dev_pixelpipe_t;
+struct dt_exif_blobs_t;
 /* responsible for image encoding, such as jpg,png,etc */
 typedef struct dt_imageio_module_format_t
 {
@@ -125,6 +126,9 @@ typedef struct dt_imageio_module_format_t
 
   // sometimes we want to tell the world about what we can do
   int (*flags)(dt_imageio_module_data_t *data);
+  /* optional: embed the given metadata during the next write_image() instead of having it written into the
+   * file afterwards. return != 0 if that isn't possible. NULL resets it. */
+  int (*set_metadata)(dt_imageio_module_data_t *data, const struct dt_exif_blobs_t *blobs);
 
   int (*read_image)(dt_imageio_module_data_t *data, uint8_t *out);
   luaA_Type parameter_lua_type;
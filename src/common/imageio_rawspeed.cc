@@ -144,9 +144,9 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
     const auto errors = r->getErrors();
     for(const auto &error : errors) fprintf(stderr, "[rawspeed] (%s) %s\n", img->filename, error.c_str());
 
-    g_strlcpy(img->camera_maker, r->metadata.canonical_make.c_str(), sizeof(img->camera_maker));
-    g_strlcpy(img->camera_model, r->metadata.canonical_model.c_str(), sizeof(img->camera_model));
-    g_strlcpy(img->camera_alias, r->metadata.canonical_alias.c_str(), sizeof(img->camera_alias));
+    img->camera_maker = g_intern_string(r->metadata.canonical_make.c_str());
+    img->camera_model = g_intern_string(r->metadata.canonical_model.c_str());
+    img->camera_alias = g_intern_string(r->metadata.canonical_alias.c_str());
     dt_image_refresh_makermodel(img);
 
     // We used to partial match the Canon local rebrandings so lets pass on
@@ -187,7 +187,7 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
 
     for(uint32_t i = 0; i < (sizeof(legacy_aliases) / sizeof(legacy_aliases[1])); i++)
       if (!strcmp(legacy_aliases[i].origname, r->metadata.model.c_str())) {
-        g_strlcpy(img->camera_legacy_makermodel, legacy_aliases[i].mungedname, sizeof(img->camera_legacy_makermodel));
+        img->camera_legacy_makermodel = g_intern_static_string(legacy_aliases[i].mungedname);
         break;
       }
 
@@ -1664,8 +1664,9 @@ static int _ioppr_migrate_iop_order(const int imgid, const int current_iop_order
   }
 
   // Now write history
-
-  sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+  // a bulk history paste might already have opened a transaction for us.
+  const gboolean own_transaction = sqlite3_get_autocommit(dt_database_get(darktable.db));
+  if(own_transaction) sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
   for (int i=0; i<history_size; i++)
   {
     struct dt_onthefly_history_t *this = &myhistory[i];
@@ -1688,7 +1689,7 @@ static int _ioppr_migrate_iop_order(const int imgid, const int current_iop_order
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
 
-  sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+  if(own_transaction) sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
 
   free(myhistory);
 
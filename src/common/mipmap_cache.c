@@ -85,6 +85,7 @@ struct dt_mipmap_buffer_dsc
   uint32_t width;
   uint32_t height;
   float iscale;
+  uint32_t generation; // changes whenever the pixels do, fits into the padding before size
   size_t size;
   dt_mipmap_buffer_dsc_flags flags;
   dt_colorspaces_color_profile_type_t color_space;
@@ -182,6 +183,14 @@ static inline int32_t buffer_is_broken(dt_mipmap_buffer_t *buf)
 }
 #endif
 
+// source of dt_mipmap_buffer_t.generation, unique over all entries so a recycled entry never repeats one
+static uint32_t _generation = 0;
+
+static inline uint32_t _next_generation()
+{
+  return __sync_add_and_fetch(&_generation, 1);
+}
+
 static inline uint32_t get_key(const uint32_t imgid, const dt_mipmap_size_t size)
 {
   // imgid can't be >= 2^28 (~250 million images)
@@ -416,6 +425,7 @@ read_error:
   if(!loaded_from_disk)
     dsc->flags = DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
   else dsc->flags = 0;
+  dsc->generation = _next_generation();
 
   // cost is just flat one for the buffer, as the buffers might have different sizes,
   // to make sure quota is meaningful.
@@ -698,6 +708,7 @@ void dt_mipmap_cache_get_with_caller(
       buf->height = dsc->height;
       buf->iscale = dsc->iscale;
       buf->color_space = dsc->color_space;
+      buf->generation = dsc->generation;
       buf->imgid = imgid;
       buf->size = mip;
 
@@ -713,6 +724,7 @@ void dt_mipmap_cache_get_with_caller(
       buf->iscale = 0.0f;
       buf->imgid = 0;
       buf->color_space = DT_COLORSPACE_NONE;
+      buf->generation = 0;
       buf->size = DT_MIPMAP_NONE;
       buf->buf = NULL;
     }
@@ -820,6 +832,9 @@ void dt_mipmap_cache_get_with_caller(
       dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
     }
 
+    // whoever asks for write access is going to change the pixels
+    if(mipmap_generated || mode == 'w') dsc->generation = _next_generation();
+
     // image cache is leaving the write lock in place in case the image has been newly allocated.
     // this leads to a slight increase in thread contention, so we opt for dropping the write lock
     // and acquiring a read lock immediately after. since this opens a small window for other threads
@@ -859,6 +874,7 @@ void dt_mipmap_cache_get_with_caller(
     buf->height = dsc->height;
     buf->iscale = dsc->iscale;
     buf->color_space = dsc->color_space;
+    buf->generation = dsc->generation;
     buf->imgid = imgid;
     buf->size = mip;
 
@@ -927,6 +943,7 @@ void dt_mipmap_cache_get_with_caller(
     buf->width = buf->height = 0;
     buf->iscale = 0.0f;
     buf->color_space = DT_COLORSPACE_NONE;
+    buf->generation = 0;
   }
 }
 
@@ -1197,7 +1214,7 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *isca
     {
       uint8_t *tmp = 0;
       int32_t thumb_width, thumb_height;
-      res = dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height, color_space);
+      res = dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height, color_space, imgid, wd, ht);
       if(!res)
       {
         // if the thumbnail is not large enough, we compute one
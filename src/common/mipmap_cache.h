@@ -68,6 +68,7 @@ typedef struct dt_mipmap_buffer_t
   float iscale;
   uint8_t *buf;
   dt_colorspaces_color_profile_type_t color_space;
+  uint32_t generation; // changes with the pixels, for users keeping something derived from them
   dt_cache_entry_t *cache_entry;
 } dt_mipmap_buffer_t;
 
@@ -19,8 +19,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <gmodule.h>
+#include <glib/gstdio.h>
 
 #include "config.h"
+#include "common/darktable.h"
+#include "common/database.h"
+#include "common/debug.h"
 #include "common/file_location.h"
 #include "common/module.h"
 
@@ -65,6 +69,78 @@ GList *dt_module_load_modules(const char *subdir, size_t module_size,
  return plugin_list;
 }
 
+uint64_t dt_module_manifest_hash(GModule *module, const int version, const char *extra)
+{
+  // the module file changes with every build, the preset names with the language
+  GStatBuf st = { 0 };
+  const gchar *filename = module ? g_module_name(module) : NULL;
+  if(filename) g_stat(filename, &st);
+  gchar *key = g_strdup_printf("%s|%d|%" G_GINT64_FORMAT "|%" G_GINT64_FORMAT "|%s|%s", darktable_package_version,
+                               version, (gint64)st.st_size, (gint64)st.st_mtime, g_get_language_names()[0],
+                               extra ? extra : "");
+
+  // 64 bit fnv-1a
+  uint64_t hash = 14695981039346656037ull;
+  for(const char *c = key; *c; c++) hash = (hash ^ (uint8_t)*c) * 1099511628211ull;
+  g_free(key);
+  return hash;
+}
+
+static gboolean _manifest_current(const char *kind, const char *op, const uint64_t hash)
+{
+  gboolean current = FALSE;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT hash FROM data.module_manifest WHERE kind = ?1 AND operation = ?2", -1,
+                              &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, kind, -1, SQLITE_STATIC);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, op, -1, SQLITE_STATIC);
+  if(sqlite3_step(stmt) == SQLITE_ROW) current = ((uint64_t)sqlite3_column_int64(stmt, 0) == hash);
+  sqlite3_finalize(stmt);
+  return current;
+}
+
+gboolean dt_module_presets_outdated(const char *kind, const char *op, const uint64_t hash, const int version,
+                                    const int blend_version)
+{
+  if(!_manifest_current(kind, op, hash)) return TRUE;
+
+  // presets can also be imported with older params, those still need an upgrade
+  sqlite3_stmt *stmt;
+  if(blend_version >= 0)
+  {
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT 1 FROM data.presets WHERE operation = ?1"
+                                " AND (op_version < ?2 OR blendop_version < ?3 OR blendop_params IS NULL) LIMIT 1",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, blend_version);
+  }
+  else
+  {
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT 1 FROM data.presets WHERE operation = ?1 AND op_version < ?2 LIMIT 1", -1,
+                                &stmt, NULL);
+  }
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, op, -1, SQLITE_STATIC);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, version);
+  const gboolean outdated = (sqlite3_step(stmt) == SQLITE_ROW);
+  sqlite3_finalize(stmt);
+  return outdated;
+}
+
+void dt_module_manifest_store(const char *kind, const char *op, const uint64_t hash)
+{
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "INSERT OR REPLACE INTO data.module_manifest (kind, operation, hash) VALUES (?1, ?2, ?3)",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, kind, -1, SQLITE_STATIC);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, op, -1, SQLITE_STATIC);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 3, (sqlite3_int64)hash);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
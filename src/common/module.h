@@ -19,12 +19,29 @@
 #pragma once
 
 #include <glib.h>
+#include <gmodule.h>
+#include <stdint.h>
 
 GList *dt_module_load_modules(const char *subdir, size_t module_size,
                               int (*load_module_so)(void *module, const char *libname, const char *plugin_name),
                               void (*init_module)(void *module),
                               gint (*sort_modules)(gconstpointer a, gconstpointer b));
 
+/** the startup manifest in data.db remembers what the presets of each module were last initialized for, so
+ * init_presets() only has to run again when that changed. kind tells iops ("iop") and lib modules ("lib")
+ * apart. */
+
+/** hash of the module file, its version, the darktable version and the language of the preset names. extra
+ * takes anything else the presets of the caller depend on, it can be NULL. */
+uint64_t dt_module_manifest_hash(GModule *module, const int version, const char *extra);
+/** returns TRUE if the presets of op have to be initialized again: they were created for another hash, or
+ * stored presets still carry params older than version. with blend_version >= 0 presets with older blend params
+ * count as well. */
+gboolean dt_module_presets_outdated(const char *kind, const char *op, const uint64_t hash, const int version,
+                                    const int blend_version);
+/** records that the presets of op are initialized for hash. */
+void dt_module_manifest_store(const char *kind, const char *op, const uint64_t hash);
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
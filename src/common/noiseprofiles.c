@@ -21,6 +21,8 @@
 #include "common/file_location.h"
 #include "control/control.h"
 
+#include <glib/gstdio.h>
+
 // bump this when the noiseprofiles are getting a different layout or meaning (raw-raw data, ...)
 #define DT_NOISE_PROFILE_VERSION 0
 
@@ -28,7 +30,61 @@ const dt_noiseprofile_t dt_noiseprofile_generic = {N_("generic poissonian"), "",
 
 static gboolean dt_noiseprofile_verify(JsonParser *parser);
 
-JsonParser *dt_noiseprofile_init(const char *alternative)
+// the compiled profiles, as kept in memory and in the cache file:
+// header | cameras | profiles (sorted by iso per camera) | strings
+#define DT_NOISE_PROFILE_CACHE_MAGIC "dtnoise"
+#define DT_NOISE_PROFILE_CACHE_VERSION 1
+
+typedef struct dt_noiseprofile_cache_header_t
+{
+  char magic[8];
+  int32_t version;
+  uint32_t source;  // hash of the json file name
+  int64_t mtime;    // and its modification time
+  int64_t size;     // and size
+  uint32_t n_cameras;
+  uint32_t n_profiles;
+  uint32_t strings_size;
+  uint32_t padding;
+} dt_noiseprofile_cache_header_t;
+
+typedef struct dt_noiseprofile_camera_t
+{
+  uint32_t maker, model; // offsets into the strings
+  uint32_t first, count; // range in the profiles
+  uint32_t next;         // 1 + index of the next camera with the same model name, 0 for none
+} dt_noiseprofile_camera_t;
+
+typedef struct dt_noiseprofile_entry_t
+{
+  uint32_t name;
+  int32_t iso;
+  float a[3];
+  float b[3];
+} dt_noiseprofile_entry_t;
+
+struct dt_noiseprofile_table_t
+{
+  gchar *blob;
+  const dt_noiseprofile_camera_t *cameras;
+  const dt_noiseprofile_entry_t *profiles;
+  const char *strings;
+  GHashTable *models; // model name -> 1 + index of the first camera with it
+};
+
+static dt_noiseprofile_table_t *_table_compile(JsonParser *parser, const dt_noiseprofile_cache_header_t *source,
+                                               gsize *blob_size);
+static dt_noiseprofile_table_t *_table_from_blob(gchar *blob, const gsize size,
+                                                 const dt_noiseprofile_cache_header_t *source);
+
+static void _cache_filename(char *filename, size_t size)
+{
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  snprintf(filename, size, "%s/%s", cachedir, "noiseprofiles.cache");
+}
+
+dt_noiseprofile_table_t *dt_noiseprofile_init(const char *alternative)
 {
   GError *error = NULL;
   char filename[PATH_MAX] = { 0 };
@@ -44,9 +100,26 @@ JsonParser *dt_noiseprofile_init(const char *alternative)
     snprintf(filename, sizeof(filename), "%s", alternative);
 
   dt_print(DT_DEBUG_CONTROL, "[noiseprofile] loading noiseprofiles from `%s'\n", filename);
-  if(!g_file_test(filename, G_FILE_TEST_EXISTS)) return NULL;
+  GStatBuf st;
+  if(g_stat(filename, &st)) return NULL;
+
+  // the compiled profiles are cached as long as the json file doesn't change
+  dt_noiseprofile_cache_header_t source = { DT_NOISE_PROFILE_CACHE_MAGIC, DT_NOISE_PROFILE_CACHE_VERSION,
+                                            g_str_hash(filename), st.st_mtime, st.st_size };
+  char cachename[PATH_MAX] = { 0 };
+  _cache_filename(cachename, sizeof(cachename));
+  gchar *blob = NULL;
+  gsize blob_size = 0;
+  if(g_file_get_contents(cachename, &blob, &blob_size, NULL))
+  {
+    dt_noiseprofile_table_t *table = _table_from_blob(blob, blob_size, &source);
+    if(table)
+    {
+      dt_print(DT_DEBUG_CONTROL, "[noiseprofile] using cached profiles from `%s'\n", cachename);
+      return table;
+    }
+  }
 
-  // TODO: shall we cache the content? for now this looks fast enough(TM)
   JsonParser *parser = json_parser_new();
   if(!json_parser_load_from_file(parser, filename, &error))
   {
@@ -65,7 +138,24 @@ JsonParser *dt_noiseprofile_init(const char *alternative)
     return NULL;
   }
 
-  return parser;
+  dt_noiseprofile_table_t *table = _table_compile(parser, &source, &blob_size);
+  g_object_unref(parser);
+
+  if(table && !g_file_set_contents(cachename, table->blob, blob_size, &error))
+  {
+    dt_print(DT_DEBUG_CONTROL, "[noiseprofile] can't write `%s': %s\n", cachename, error->message);
+    g_error_free(error);
+  }
+
+  return table;
+}
+
+void dt_noiseprofile_cleanup(dt_noiseprofile_table_t *table)
+{
+  if(!table) return;
+  g_hash_table_destroy(table->models);
+  g_free(table->blob);
+  free(table);
 }
 
 int is_member(gchar** names, char* name)
@@ -79,10 +169,10 @@ int is_member(gchar** names, char* name)
   return 0;
 }
 
-static gint _sort_by_iso(gconstpointer a, gconstpointer b)
+static gint _sort_by_iso(gconstpointer a, gconstpointer b, gpointer user_data)
 {
-  const dt_noiseprofile_t *profile_a = (dt_noiseprofile_t *)a;
-  const dt_noiseprofile_t *profile_b = (dt_noiseprofile_t *)b;
+  const dt_noiseprofile_entry_t *profile_a = (dt_noiseprofile_entry_t *)a;
+  const dt_noiseprofile_entry_t *profile_b = (dt_noiseprofile_entry_t *)b;
 
   return profile_a->iso - profile_b->iso;
 }
@@ -224,142 +314,299 @@ end:
 }
 #undef _ERROR
 
-GList *dt_noiseprofile_get_matching(const dt_image_t *cimg)
+// turns the verified json into the flat table, skipping the profiles marked as such
+static dt_noiseprofile_table_t *_table_compile(JsonParser *parser, const dt_noiseprofile_cache_header_t *source,
+                                               gsize *blob_size)
 {
-  JsonParser *parser = darktable.noiseprofile_parser;
-  JsonReader *reader = NULL;
-  GList *result = NULL;
-
-  if(!parser) goto end;
-
-  dt_print(DT_DEBUG_CONTROL, "[noiseprofile] looking for maker `%s', model `%s'\n", cimg->camera_maker, cimg->camera_model);
-
-  JsonNode *root = json_parser_get_root(parser);
-
-  reader = json_reader_new(root);
+  GArray *cameras = g_array_new(FALSE, FALSE, sizeof(dt_noiseprofile_camera_t));
+  GArray *profiles = g_array_new(FALSE, FALSE, sizeof(dt_noiseprofile_entry_t));
+  GString *strings = g_string_new(NULL);
 
+  JsonReader *reader = json_reader_new(json_parser_get_root(parser));
   json_reader_read_member(reader, "noiseprofiles");
 
-  // go through all makers
   const int n_makers = json_reader_count_elements(reader);
-  dt_print(DT_DEBUG_CONTROL, "[noiseprofile] found %d makers\n", n_makers);
   for(int i = 0; i < n_makers; i++)
   {
     json_reader_read_element(reader, i);
 
     json_reader_read_member(reader, "maker");
+    const uint32_t maker = strings->len;
+    g_string_append_len(strings, json_reader_get_string_value(reader),
+                        strlen(json_reader_get_string_value(reader)) + 1);
+    json_reader_end_member(reader);
 
-    if(g_strstr_len(cimg->camera_maker, -1, json_reader_get_string_value(reader)))
+    json_reader_read_member(reader, "models");
+    const int n_models = json_reader_count_elements(reader);
+    for(int j = 0; j < n_models; j++)
     {
-      dt_print(DT_DEBUG_CONTROL, "[noiseprofile] found `%s' as `%s'\n", cimg->camera_maker, json_reader_get_string_value(reader));
-      // go through all models and check those
-      json_reader_end_member(reader);
+      json_reader_read_element(reader, j);
 
-      json_reader_read_member(reader, "models");
+      dt_noiseprofile_camera_t camera = { .maker = maker, .first = profiles->len };
+      json_reader_read_member(reader, "model");
+      camera.model = strings->len;
+      g_string_append_len(strings, json_reader_get_string_value(reader),
+                          strlen(json_reader_get_string_value(reader)) + 1);
+      json_reader_end_member(reader);
 
-      const int n_models = json_reader_count_elements(reader);
-      dt_print(DT_DEBUG_CONTROL, "[noiseprofile] found %d models\n", n_models);
-      for(int j = 0; j < n_models; j++)
+      json_reader_read_member(reader, "profiles");
+      const int n_profiles = json_reader_count_elements(reader);
+      for(int k = 0; k < n_profiles; k++)
       {
-        json_reader_read_element(reader, j);
+        json_reader_read_element(reader, k);
 
-        json_reader_read_member(reader, "model");
+        gchar** member_names = json_reader_list_members(reader);
 
-        if(!g_strcmp0(cimg->camera_model, json_reader_get_string_value(reader)))
+        // do we want to skip this entry?
+        gboolean skip = FALSE;
+        if(is_member(member_names, "skip"))
         {
-          dt_print(DT_DEBUG_CONTROL, "[noiseprofile] found %s\n", cimg->camera_model);
-          // we got a match, return at most bufsize elements
+          json_reader_read_member(reader, "skip");
+          skip = json_reader_get_boolean_value(reader);
           json_reader_end_member(reader);
+        }
+        g_strfreev(member_names);
+        if(skip)
+        {
+          json_reader_end_element(reader);
+          continue;
+        }
+
+        dt_noiseprofile_entry_t profile = { 0 };
+
+        json_reader_read_member(reader, "name");
+        profile.name = strings->len;
+        g_string_append_len(strings, json_reader_get_string_value(reader),
+                            strlen(json_reader_get_string_value(reader)) + 1);
+        json_reader_end_member(reader);
+
+        json_reader_read_member(reader, "iso");
+        profile.iso = json_reader_get_double_value(reader);
+        json_reader_end_member(reader);
 
-          json_reader_read_member(reader, "profiles");
-
-          const int n_profiles = json_reader_count_elements(reader);
-          dt_print(DT_DEBUG_CONTROL, "[noiseprofile] found %d profiles\n", n_profiles);
-          for(int k = 0; k < n_profiles; k++)
-          {
-            dt_noiseprofile_t tmp_profile = { 0 };
-
-            json_reader_read_element(reader, k);
-
-            gchar** member_names = json_reader_list_members(reader);
-
-            // do we want to skip this entry?
-            if(is_member(member_names, "skip"))
-            {
-              json_reader_read_member(reader, "skip");
-              gboolean skip = json_reader_get_boolean_value(reader);
-              json_reader_end_member(reader);
-              if(skip)
-              {
-                json_reader_end_element(reader);
-                g_strfreev(member_names);
-                continue;
-              }
-            }
-
-            // maker
-            tmp_profile.maker = g_strdup(cimg->camera_maker);
-
-            // model
-            tmp_profile.model = g_strdup(cimg->camera_model);
-
-            // name
-            json_reader_read_member(reader, "name");
-            tmp_profile.name = g_strdup(json_reader_get_string_value(reader));
-            json_reader_end_member(reader);
-
-            // iso
-            json_reader_read_member(reader, "iso");
-            tmp_profile.iso = json_reader_get_double_value(reader);
-            json_reader_end_member(reader);
-
-            // a
-            json_reader_read_member(reader, "a");
-            for(int a = 0; a < 3; a++)
-            {
-              json_reader_read_element(reader, a);
-              tmp_profile.a[a] = json_reader_get_double_value(reader);
-              json_reader_end_element(reader);
-            }
-            json_reader_end_member(reader);
-
-            // b
-            json_reader_read_member(reader, "b");
-            for(int b = 0; b < 3; b++)
-            {
-              json_reader_read_element(reader, b);
-              tmp_profile.b[b] = json_reader_get_double_value(reader);
-              json_reader_end_element(reader);
-            }
-            json_reader_end_member(reader);
-
-            json_reader_end_element(reader);
-
-            // everything worked out, add tmp_profile to result
-            dt_noiseprofile_t *new_profile = (dt_noiseprofile_t *)malloc(sizeof(dt_noiseprofile_t));
-            *new_profile = tmp_profile;
-            result = g_list_append(result, new_profile);
-
-            g_strfreev(member_names);
-          } // profiles
-
-          goto end;
+        json_reader_read_member(reader, "a");
+        for(int a = 0; a < 3; a++)
+        {
+          json_reader_read_element(reader, a);
+          profile.a[a] = json_reader_get_double_value(reader);
+          json_reader_end_element(reader);
         }
+        json_reader_end_member(reader);
 
+        json_reader_read_member(reader, "b");
+        for(int b = 0; b < 3; b++)
+        {
+          json_reader_read_element(reader, b);
+          profile.b[b] = json_reader_get_double_value(reader);
+          json_reader_end_element(reader);
+        }
         json_reader_end_member(reader);
+
         json_reader_end_element(reader);
-      } // models
-    }
+        g_array_append_val(profiles, profile);
+      } // profiles
+      json_reader_end_member(reader);
 
+      camera.count = profiles->len - camera.first;
+      // lookups rely on the isos being sorted, g_qsort_with_data() is stable so equal ones keep their order
+      if(camera.count > 1)
+        g_qsort_with_data(&g_array_index(profiles, dt_noiseprofile_entry_t, camera.first), camera.count,
+                          sizeof(dt_noiseprofile_entry_t), _sort_by_iso, NULL);
+      g_array_append_val(cameras, camera);
+
+      json_reader_end_element(reader);
+    } // models
     json_reader_end_member(reader);
+
     json_reader_end_element(reader);
   } // makers
-
   json_reader_end_member(reader);
+  g_object_unref(reader);
 
-end:
-  if(reader) g_object_unref(reader);
-  if(result) result = g_list_sort(result, _sort_by_iso);
+  // chain cameras which share a model name, in file order
+  for(int i = (int)cameras->len - 1; i >= 0; i--)
+  {
+    dt_noiseprofile_camera_t *camera = &g_array_index(cameras, dt_noiseprofile_camera_t, i);
+    for(guint j = i + 1; j < cameras->len; j++)
+    {
+      if(!strcmp(strings->str + camera->model,
+                 strings->str + g_array_index(cameras, dt_noiseprofile_camera_t, j).model))
+      {
+        camera->next = j + 1;
+        break;
+      }
+    }
+  }
+
+  dt_noiseprofile_cache_header_t header = *source;
+  header.n_cameras = cameras->len;
+  header.n_profiles = profiles->len;
+  header.strings_size = strings->len;
+
+  const gsize cameras_size = sizeof(dt_noiseprofile_camera_t) * cameras->len;
+  const gsize profiles_size = sizeof(dt_noiseprofile_entry_t) * profiles->len;
+  *blob_size = sizeof(header) + cameras_size + profiles_size + strings->len;
+  gchar *blob = g_malloc(*blob_size);
+  gchar *pos = blob;
+  memcpy(pos, &header, sizeof(header));
+  pos += sizeof(header);
+  memcpy(pos, cameras->data, cameras_size);
+  pos += cameras_size;
+  memcpy(pos, profiles->data, profiles_size);
+  pos += profiles_size;
+  memcpy(pos, strings->str, strings->len);
+
+  dt_print(DT_DEBUG_CONTROL, "[noiseprofile] compiled %u profiles of %u cameras\n", header.n_profiles,
+           header.n_cameras);
+
+  g_array_free(cameras, TRUE);
+  g_array_free(profiles, TRUE);
+  g_string_free(strings, TRUE);
+
+  return _table_from_blob(blob, *blob_size, source);
+}
+
+// takes ownership of blob. returns NULL if it doesn't belong to source or is broken
+static dt_noiseprofile_table_t *_table_from_blob(gchar *blob, const gsize size,
+                                                 const dt_noiseprofile_cache_header_t *source)
+{
+  const dt_noiseprofile_cache_header_t *header = (dt_noiseprofile_cache_header_t *)blob;
+  if(size < sizeof(dt_noiseprofile_cache_header_t) || memcmp(header->magic, source->magic, sizeof(header->magic))
+     || header->version != source->version || header->source != source->source || header->mtime != source->mtime
+     || header->size != source->size
+     || size != sizeof(dt_noiseprofile_cache_header_t) + sizeof(dt_noiseprofile_camera_t) * header->n_cameras
+                    + sizeof(dt_noiseprofile_entry_t) * header->n_profiles + header->strings_size
+     || (header->strings_size && blob[size - 1] != '\0'))
+    goto error;
+
+  dt_noiseprofile_table_t *table = (dt_noiseprofile_table_t *)calloc(1, sizeof(dt_noiseprofile_table_t));
+  table->blob = blob;
+  table->cameras = (dt_noiseprofile_camera_t *)(blob + sizeof(dt_noiseprofile_cache_header_t));
+  table->profiles = (dt_noiseprofile_entry_t *)(table->cameras + header->n_cameras);
+  table->strings = (const char *)(table->profiles + header->n_profiles);
+  table->models = g_hash_table_new(g_str_hash, g_str_equal);
+
+  for(uint32_t i = 0; i < header->n_cameras; i++)
+  {
+    const dt_noiseprofile_camera_t *camera = &table->cameras[i];
+    if(camera->maker >= header->strings_size || camera->model >= header->strings_size
+       || camera->first > header->n_profiles || camera->count > header->n_profiles - camera->first
+       || camera->next > header->n_cameras)
+    {
+      g_hash_table_destroy(table->models);
+      free(table);
+      goto error;
+    }
+    for(uint32_t k = camera->first; k < camera->first + camera->count; k++)
+      if(table->profiles[k].name >= header->strings_size)
+      {
+        g_hash_table_destroy(table->models);
+        free(table);
+        goto error;
+      }
+
+    // the first camera of a model leads its chain
+    const char *model = table->strings + camera->model;
+    if(!g_hash_table_contains(table->models, model))
+      g_hash_table_insert(table->models, (gpointer)model, GUINT_TO_POINTER(i + 1));
+  }
+
+  return table;
+
+error:
+  g_free(blob);
+  return NULL;
+}
+
+// same as before the table: the first camera in file order with the exact model name whose maker is part of
+// the image's one
+static const dt_noiseprofile_camera_t *_find_camera(const dt_noiseprofile_table_t *table, const dt_image_t *cimg)
+{
+  if(!table) return NULL;
+
+  dt_print(DT_DEBUG_CONTROL, "[noiseprofile] looking for maker `%s', model `%s'\n", cimg->camera_maker, cimg->camera_model);
+
+  guint index = GPOINTER_TO_UINT(g_hash_table_lookup(table->models, cimg->camera_model));
+  while(index)
+  {
+    const dt_noiseprofile_camera_t *camera = &table->cameras[index - 1];
+    if(g_strstr_len(cimg->camera_maker, -1, table->strings + camera->maker))
+    {
+      dt_print(DT_DEBUG_CONTROL, "[noiseprofile] found %s %s with %u profiles\n", table->strings + camera->maker,
+               cimg->camera_model, camera->count);
+      return camera;
+    }
+    index = camera->next;
+  }
+  return NULL;
+}
+
+GList *dt_noiseprofile_get_matching(const dt_image_t *cimg)
+{
+  const dt_noiseprofile_table_t *table = darktable.noiseprofiles;
+  const dt_noiseprofile_camera_t *camera = _find_camera(table, cimg);
+  if(!camera) return NULL;
+
+  GList *result = NULL;
+  for(uint32_t k = camera->first + camera->count; k > camera->first; k--)
+  {
+    const dt_noiseprofile_entry_t *entry = &table->profiles[k - 1];
+    dt_noiseprofile_t *profile = (dt_noiseprofile_t *)malloc(sizeof(dt_noiseprofile_t));
+    profile->name = g_strdup(table->strings + entry->name);
+    profile->maker = g_strdup(cimg->camera_maker);
+    profile->model = g_strdup(cimg->camera_model);
+    profile->iso = entry->iso;
+    memcpy(profile->a, entry->a, sizeof(profile->a));
+    memcpy(profile->b, entry->b, sizeof(profile->b));
+    result = g_list_prepend(result, profile);
+  }
+  return result;
+}
+
+dt_noiseprofile_t dt_noiseprofile_get_auto(const dt_image_t *cimg)
+{
+  dt_noiseprofile_t result = dt_noiseprofile_generic; // default to generic poissonian
+
+  const dt_noiseprofile_table_t *table = darktable.noiseprofiles;
+  const dt_noiseprofile_camera_t *camera = _find_camera(table, cimg);
+  if(!camera) return result;
+
+  // first profile with an iso >= the image's one
+  const dt_noiseprofile_entry_t *profiles = table->profiles + camera->first;
+  const int iso = cimg->exif_iso;
+  uint32_t lo = 0, hi = camera->count;
+  while(lo < hi)
+  {
+    const uint32_t mid = lo + (hi - lo) / 2;
+    if(profiles[mid].iso < iso)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if(lo == camera->count) return result;
+
+  // no extrapolation, images outside of the measured range get the generic profile
+  const dt_noiseprofile_entry_t *upper = &profiles[lo];
+  if(upper->iso == iso)
+  {
+    result.name = (char *)(table->strings + upper->name);
+    result.iso = upper->iso;
+    memcpy(result.a, upper->a, sizeof(result.a));
+    memcpy(result.b, upper->b, sizeof(result.b));
+  }
+  else if(lo > 0)
+  {
+    const dt_noiseprofile_entry_t *lower = &profiles[lo - 1];
+    dt_noiseprofile_t p1 = { 0 }, p2 = { 0 };
+    p1.iso = lower->iso;
+    memcpy(p1.a, lower->a, sizeof(p1.a));
+    memcpy(p1.b, lower->b, sizeof(p1.b));
+    p2.iso = upper->iso;
+    memcpy(p2.a, upper->a, sizeof(p2.a));
+    memcpy(p2.b, upper->b, sizeof(p2.b));
+    result.iso = iso;
+    dt_noiseprofile_interpolate(&p1, &p2, &result);
+  }
   return result;
 }
 
@@ -36,8 +36,13 @@ dt_noiseprofile_t;
 
 extern const dt_noiseprofile_t dt_noiseprofile_generic;
 
-/** read the noiseprofile file once on startup (kind of)*/
-JsonParser *dt_noiseprofile_init(const char *alternative);
+/** the profiles of all cameras, indexed by model and sorted by iso */
+typedef struct dt_noiseprofile_table_t dt_noiseprofile_table_t;
+
+/** read the noiseprofile file once on startup. the compiled table is cached in the user cache dir until the
+ * file changes. */
+dt_noiseprofile_table_t *dt_noiseprofile_init(const char *alternative);
+void dt_noiseprofile_cleanup(dt_noiseprofile_table_t *table);
 
 /*
  * returns the noiseprofiles matching the image's exif data.
@@ -45,6 +50,12 @@ JsonParser *dt_noiseprofile_init(const char *alternative);
  */
 GList *dt_noiseprofile_get_matching(const dt_image_t *cimg);
 
+/*
+ * returns the profile for the image's iso, interpolated between the two closest ones, or the generic profile if
+ * there is none for the camera or the iso is out of the measured range. name points to the table, don't free.
+ */
+dt_noiseprofile_t dt_noiseprofile_get_auto(const dt_image_t *cimg);
+
 /** convenience function to free a list of noiseprofiles */
 void dt_noiseprofile_free(gpointer data);
 
@@ -39,6 +39,163 @@ typedef struct dt_undo_tags_t
 
 static void dt_set_darktable_tags();
 
+// in-memory index of all tags with their image counts. it saves the tagging and collect modules from going
+// through the database on every key stroke. it is built on first use, attaching and detaching tags only
+// adjusts the counts while any other change to the tags drops it until it is needed again.
+typedef struct dt_tag_index_entry_t
+{
+  guint id;
+  gchar *name;
+  gchar *synonyms;
+  gchar *name_folded;
+  gchar *synonyms_folded;
+  gint flags;
+  guint count;
+} dt_tag_index_entry_t;
+
+static GMutex _index_lock;
+static GPtrArray *_index = NULL;       // entries sorted by name
+static GHashTable *_index_ids = NULL;  // tag id -> entry
+
+static void _index_entry_free(gpointer data)
+{
+  dt_tag_index_entry_t *e = (dt_tag_index_entry_t *)data;
+  g_free(e->name);
+  g_free(e->synonyms);
+  g_free(e->name_folded);
+  g_free(e->synonyms_folded);
+  g_free(e);
+}
+
+// _index_lock has to be held
+static void _index_build()
+{
+  if(_index) return;
+
+  _index = g_ptr_array_new_with_free_func(_index_entry_free);
+  _index_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT T.id, T.name, T.flags, T.synonyms, "
+                              "(SELECT COUNT(*) FROM main.tagged_images AS TI WHERE TI.tagid = T.id) "
+                              "FROM data.tags AS T "
+                              "ORDER BY T.name",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const char *name = (const char *)sqlite3_column_text(stmt, 1);
+    if(!name) continue; // safeguard against degenerated db entries
+    const char *synonyms = (const char *)sqlite3_column_text(stmt, 3);
+
+    dt_tag_index_entry_t *e = g_malloc0(sizeof(dt_tag_index_entry_t));
+    e->id = sqlite3_column_int(stmt, 0);
+    e->name = g_strdup(name);
+    e->name_folded = g_utf8_strdown(name, -1);
+    e->synonyms = g_strdup(synonyms);
+    if(synonyms && synonyms[0]) e->synonyms_folded = g_utf8_strdown(synonyms, -1);
+    e->flags = sqlite3_column_int(stmt, 2);
+    e->count = sqlite3_column_int(stmt, 4);
+    g_ptr_array_add(_index, e);
+    g_hash_table_insert(_index_ids, GUINT_TO_POINTER(e->id), e);
+  }
+  sqlite3_finalize(stmt);
+}
+
+void dt_tag_index_invalidate()
+{
+  g_mutex_lock(&_index_lock);
+  if(_index)
+  {
+    g_hash_table_destroy(_index_ids);
+    g_ptr_array_free(_index, TRUE);
+    _index_ids = NULL;
+    _index = NULL;
+  }
+  g_mutex_unlock(&_index_lock);
+}
+
+static void _index_update_counts(GList *tags, const int delta)
+{
+  g_mutex_lock(&_index_lock);
+  gboolean stale = FALSE;
+  for(GList *t = tags; t && _index; t = g_list_next(t))
+  {
+    dt_tag_index_entry_t *e = g_hash_table_lookup(_index_ids, t->data);
+    if(e)
+      e->count += delta;
+    else
+      stale = TRUE;
+  }
+  g_mutex_unlock(&_index_lock);
+  // a tag we don't know about yet
+  if(stale) dt_tag_index_invalidate();
+}
+
+GHashTable *dt_tag_index_find(const char *keyword, const gboolean synonyms)
+{
+  GHashTable *found = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  gchar *needle = g_utf8_strdown(keyword ? keyword : "", -1);
+
+  g_mutex_lock(&_index_lock);
+  _index_build();
+  for(guint k = 0; k < _index->len; k++)
+  {
+    const dt_tag_index_entry_t *e = (dt_tag_index_entry_t *)g_ptr_array_index(_index, k);
+    if(strstr(e->name_folded, needle) || (synonyms && e->synonyms_folded && strstr(e->synonyms_folded, needle)))
+      g_hash_table_insert(found, g_strdup(e->name), GUINT_TO_POINTER(e->id));
+  }
+  g_mutex_unlock(&_index_lock);
+
+  g_free(needle);
+  return found;
+}
+
+// _index_lock has to be held, returns the first entry at or after name
+static guint _index_lower_bound(const char *name)
+{
+  guint lo = 0, hi = _index->len;
+  while(lo < hi)
+  {
+    const guint mid = lo + (hi - lo) / 2;
+    if(strcmp(((dt_tag_index_entry_t *)g_ptr_array_index(_index, mid))->name, name) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+GList *dt_tag_index_get_branch(const char *path)
+{
+  GList *tags = NULL;
+  if(!path) return tags;
+  const size_t len = strlen(path);
+
+  g_mutex_lock(&_index_lock);
+  _index_build();
+  // all names starting with path are next to each other, but "path x" sorts in between "path" and "path|x"
+  for(guint k = _index_lower_bound(path); k < _index->len; k++)
+  {
+    const dt_tag_index_entry_t *e = (dt_tag_index_entry_t *)g_ptr_array_index(_index, k);
+    if(strncmp(e->name, path, len)) break;
+    if(e->name[len] != '\0' && e->name[len] != '|') continue;
+
+    dt_tag_t *t = g_malloc0(sizeof(dt_tag_t));
+    t->id = e->id;
+    t->tag = g_strdup(e->name);
+    t->leave = g_strrstr(t->tag, "|");
+    t->leave = t->leave ? t->leave + 1 : t->tag;
+    t->synonym = g_strdup(e->synonyms);
+    t->flags = e->flags;
+    t->count = e->count;
+    tags = g_list_prepend(tags, t);
+  }
+  g_mutex_unlock(&_index_lock);
+
+  return g_list_reverse(tags);
+}
+
 #if 0
 static gchar *_get_list_string_values(GList *list)
 {
@@ -87,32 +244,36 @@ static gchar *_get_tb_added_tag_string_values(const int img, GList *before, GLis
   return tag_list;
 }
 
-static void _bulk_remove_tags(const int img, const gchar *tag_list)
+static gboolean _bulk_remove_tags(const int img, const gchar *tag_list)
 {
+  gboolean done = TRUE;
   if(img > 0 && tag_list)
   {
     char *query = NULL;
     sqlite3_stmt *stmt;
     query = dt_util_dstrcat(query, "DELETE FROM main.tagged_images WHERE imgid = %d AND tagid IN (%s)", img, tag_list);
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-    sqlite3_step(stmt);
+    done = (sqlite3_step(stmt) == SQLITE_DONE);
     sqlite3_finalize(stmt);
     g_free(query);
   }
+  return done;
 }
 
-static void _bulk_add_tags(const gchar *tag_list)
+static gboolean _bulk_add_tags(const gchar *tag_list)
 {
+  gboolean done = TRUE;
   if(tag_list)
   {
     char *query = NULL;
     sqlite3_stmt *stmt;
     query = dt_util_dstrcat(query, "INSERT INTO main.tagged_images (imgid, tagid) VALUES %s", tag_list);
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-    sqlite3_step(stmt);
+    done = (sqlite3_step(stmt) == SQLITE_DONE);
     sqlite3_finalize(stmt);
     g_free(query);
   }
+  return done;
 }
 
 static void _pop_undo_execute(const int imgid, GList *before, GList *after)
@@ -120,8 +281,24 @@ static void _pop_undo_execute(const int imgid, GList *before, GList *after)
   gchar *tobe_removed_list = _get_tb_removed_tag_string_values(before, after);
   gchar *tobe_added_list = _get_tb_added_tag_string_values(imgid, before, after);
 
-  _bulk_remove_tags(imgid, tobe_removed_list);
-  _bulk_add_tags(tobe_added_list);
+  const gboolean removed = _bulk_remove_tags(imgid, tobe_removed_list);
+  const gboolean added = _bulk_add_tags(tobe_added_list);
+
+  // keep the image counts of the tag index in step
+  if(removed && added)
+  {
+    GList *gone = NULL, *gained = NULL;
+    for(GList *b = before; b; b = g_list_next(b))
+      if(!g_list_find(after, b->data)) gone = g_list_prepend(gone, b->data);
+    for(GList *a = after; a; a = g_list_next(a))
+      if(!g_list_find(before, a->data)) gained = g_list_prepend(gained, a->data);
+    _index_update_counts(gone, -1);
+    _index_update_counts(gained, 1);
+    g_list_free(gone);
+    g_list_free(gained);
+  }
+  else
+    dt_tag_index_invalidate();
 
   g_free(tobe_removed_list);
   g_free(tobe_added_list);
@@ -229,6 +406,7 @@ gboolean dt_tag_new(const char *name, guint *tagid)
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, name, -1, SQLITE_TRANSIENT);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
+  dt_tag_index_invalidate();
 
   if(tagid != NULL)
   {
@@ -277,6 +455,7 @@ guint dt_tag_remove(const guint tagid, gboolean final)
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, tagid);
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
+    dt_tag_index_invalidate();
 
     /* raise signal of tags change to refresh keywords module */
     dt_control_signal_raise(darktable.signals, DT_SIGNAL_TAG_CHANGED);
@@ -302,6 +481,7 @@ void dt_tag_delete_tag_batch(const char *flatlist)
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
   g_free(query);
+  dt_tag_index_invalidate();
 }
 
 guint dt_tag_remove_list(GList *tag_list)
@@ -366,7 +546,7 @@ void dt_tag_rename(const guint tagid, const gchar *new_tagname)
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, new_tagname, -1, SQLITE_TRANSIENT);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
-
+  dt_tag_index_invalidate();
 }
 
 gboolean dt_tag_exists(const char *name, guint *tagid)
@@ -1127,6 +1307,26 @@ uint32_t dt_tag_get_suggestions(GList **result)
   return count;
 }
 
+// puts the ids of tags into memory.similar_tags, returns their number
+static int _fill_similar_tags(GList *tags)
+{
+  sqlite3_stmt *stmt;
+  int count = 0;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "INSERT INTO memory.similar_tags (tagid) VALUES (?1)",
+                              -1, &stmt, NULL);
+  for(GList *t = tags; t; t = g_list_next(t))
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, ((dt_tag_t *)t->data)->id);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    count++;
+  }
+  sqlite3_finalize(stmt);
+  return count;
+}
+
 void dt_tag_count_tags_images(const gchar *keyword, int *tag_count, int *img_count)
 {
   sqlite3_stmt *stmt;
@@ -1134,26 +1334,10 @@ void dt_tag_count_tags_images(const gchar *keyword, int *tag_count, int *img_cou
   *img_count = 0;
 
   if(!keyword) return;
-  gchar *keyword_expr = g_strdup_printf("%s|", keyword);
-
   /* Only select tags that are equal or child to the one we are looking for once. */
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "INSERT INTO memory.similar_tags (tagid) SELECT id FROM data.tags "
-                              "WHERE name = ?1 OR SUBSTR(name, 1, LENGTH(?2)) = ?2 ",
-                              -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, keyword, -1, SQLITE_TRANSIENT);
-  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, keyword_expr, -1, SQLITE_TRANSIENT);
-  sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
-
-  g_free(keyword_expr);
-
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT COUNT(DISTINCT tagid) FROM memory.similar_tags",
-                              -1, &stmt, NULL);
-  sqlite3_step(stmt);
-  *tag_count = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
+  GList *tags = dt_tag_index_get_branch(keyword);
+  *tag_count = _fill_similar_tags(tags);
+  dt_tag_free_result(&tags);
 
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "SELECT COUNT(DISTINCT ti.imgid) FROM main.tagged_images AS ti "
@@ -1172,33 +1356,10 @@ void dt_tag_get_tags_images(const gchar *keyword, GList **tag_list, GList **img_
   sqlite3_stmt *stmt;
 
   if(!keyword) return;
-  gchar *keyword_expr = g_strdup_printf("%s|", keyword);
-
-/* Only select tags that are equal or child to the one we are looking for once. */
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "INSERT INTO memory.similar_tags (tagid) SELECT id FROM data.tags "
-                              "WHERE name = ?1 OR SUBSTR(name, 1, LENGTH(?2)) = ?2 ",
-                              -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, keyword, -1, SQLITE_TRANSIENT);
-  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, keyword_expr, -1, SQLITE_TRANSIENT);
-  sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
-
-  g_free(keyword_expr);
-
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT ST.tagid, T.name FROM memory.similar_tags ST "
-                              "JOIN data.tags T ON T.id = ST.tagid ",
-                              -1, &stmt, NULL);
-
-  while(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    dt_tag_t *t = g_malloc0(sizeof(dt_tag_t));
-    t->id = sqlite3_column_int(stmt, 0);
-    t->tag = g_strdup((char *)sqlite3_column_text(stmt, 1));
-    *tag_list = g_list_append((*tag_list), t);
-  }
-  sqlite3_finalize(stmt);
+  /* Only select tags that are equal or child to the one we are looking for once. */
+  GList *tags = dt_tag_index_get_branch(keyword);
+  _fill_similar_tags(tags);
+  *tag_list = g_list_concat(*tag_list, tags);
 
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "SELECT DISTINCT ti.imgid FROM main.tagged_images AS ti "
@@ -1245,55 +1406,52 @@ uint32_t dt_tag_get_with_usage(GList **result)
 {
   sqlite3_stmt *stmt;
 
-  dt_set_darktable_tags();
-
-  /* Select tags that are similar to the keyword and are actually used to tag images*/
+  /* only the tags of the selected images are counted here, the totals come from the index */
+  GHashTable *selected = g_hash_table_new(g_direct_hash, g_direct_equal);
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "INSERT INTO memory.taglist (id, count) SELECT tagid, COUNT(*) "
-                              "FROM main.tagged_images "
-                              "GROUP BY tagid",
+                              "SELECT TI.tagid, COUNT(*) "
+                              "FROM main.selected_images AS S "
+                              "JOIN main.tagged_images AS TI ON TI.imgid = S.imgid "
+                              "GROUP BY TI.tagid",
                               -1, &stmt, NULL);
-  sqlite3_step(stmt);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    g_hash_table_insert(selected, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)),
+                        GINT_TO_POINTER(sqlite3_column_int(stmt, 1)));
   sqlite3_finalize(stmt);
 
   const uint32_t nb_selected = dt_selected_images_count();
 
-  /* Now put all the bits together */
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT T.name, T.id, MT.count, CT.imgnb, T.flags, T.synonyms "
-                              "FROM data.tags T "
-                              "LEFT JOIN memory.taglist MT ON MT.id = T.id "
-                              "LEFT JOIN (SELECT tagid, COUNT(DISTINCT imgid) AS imgnb FROM main.tagged_images "
-                                "WHERE imgid IN (SELECT imgid FROM main.selected_images) GROUP BY tagid) AS CT "
-                                "ON CT.tagid = T.id "
-                              "WHERE T.id NOT IN memory.darktable_tags "
-                              "ORDER BY T.name ",
-                              -1, &stmt, NULL);
-
   /* ... and create the result list to send upwards */
   uint32_t count = 0;
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  GList *tags = NULL;
+  g_mutex_lock(&_index_lock);
+  _index_build();
+  for(guint k = 0; k < _index->len; k++)
   {
+    const dt_tag_index_entry_t *e = (dt_tag_index_entry_t *)g_ptr_array_index(_index, k);
+    // same as the LIKE 'darktable|%' of memory.darktable_tags
+    if(!g_ascii_strncasecmp(e->name, "darktable|", strlen("darktable|"))) continue;
+
     dt_tag_t *t = g_malloc0(sizeof(dt_tag_t));
-    t->tag = g_strdup((char *)sqlite3_column_text(stmt, 0));
+    t->tag = g_strdup(e->name);
     t->leave = g_strrstr(t->tag, "|");
     t->leave = t->leave ? t->leave + 1 : t->tag;
-    t->id = sqlite3_column_int(stmt, 1);
-    t->count = sqlite3_column_int(stmt, 2);
-    uint32_t imgnb = sqlite3_column_int(stmt, 3);
+    t->id = e->id;
+    t->count = e->count;
+    const uint32_t imgnb = GPOINTER_TO_INT(g_hash_table_lookup(selected, GUINT_TO_POINTER(e->id)));
     // 0: no selection or no tag not attached
     // 1: tag attached on some selected images
     // 2: tag attached on all selected images
     t->select = (nb_selected == 0) ? 0 : (imgnb == nb_selected) ? 2 : (imgnb == 0) ? 0 : 1;
-    t->flags = sqlite3_column_int(stmt, 4);
-    t->synonym = g_strdup((char *)sqlite3_column_text(stmt, 5));
-    *result = g_list_append(*result, t);
+    t->flags = e->flags;
+    t->synonym = g_strdup(e->synonyms);
+    tags = g_list_prepend(tags, t);
     count++;
   }
+  g_mutex_unlock(&_index_lock);
+  g_hash_table_destroy(selected);
 
-  sqlite3_finalize(stmt);
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "DELETE FROM memory.taglist", NULL, NULL, NULL);
-
+  *result = g_list_concat(*result, g_list_reverse(tags));
   return count;
 }
 
@@ -1365,6 +1523,7 @@ void dt_tag_set_synonyms(gint tagid, gchar *synonyms_entry)
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
   g_free(synonyms);
+  dt_tag_index_invalidate();
 }
 
 gint dt_tag_get_flags(gint tagid)
@@ -1396,6 +1555,7 @@ void dt_tag_set_flags(gint tagid, gint flags)
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, flags);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
+  dt_tag_index_invalidate();
 }
 
 void dt_tag_add_synonym(gint tagid, gchar *synonym)
@@ -1418,6 +1578,7 @@ void dt_tag_add_synonym(gint tagid, gchar *synonym)
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
   g_free(synonyms);
+  dt_tag_index_invalidate();
 }
 
 static void _free_result_item(dt_tag_t *t, gpointer unused)
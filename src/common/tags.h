@@ -174,6 +174,18 @@ uint32_t dt_selected_images_count();
 /** get number of images affected with that tag */
 uint32_t dt_tag_images_count(gint tagid);
 
+/** drops the in-memory tag index, to be called after changing data.tags or main.tagged_images directly. the
+ * functions here keep it up to date themselves. */
+void dt_tag_index_invalidate();
+
+/** returns the tags containing keyword in their name, or with synonyms also in their synonyms, ignoring case.
+ * the keys of the hash table are the tag names, the values their ids. */
+GHashTable *dt_tag_index_find(const char *keyword, const gboolean synonyms);
+
+/** returns the tag path and all tags below it as a list of dt_tag_t, sorted by name and with their image
+ * counts. */
+GList *dt_tag_index_get_branch(const char *path);
+
 /** retrieves the subtag of requested level for the requested category */
 char *dt_tag_get_subtag(const gint imgid, const char *category, const int level);
 
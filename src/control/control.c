@@ -66,6 +66,12 @@ void dt_control_init(dt_control_t *s)
   dt_pthread_mutex_init(&(s->global_mutex), NULL);
   dt_pthread_mutex_init(&(s->progress_system.mutex), NULL);
 
+  dt_pthread_mutex_init(&s->sidecar.mutex, NULL);
+  pthread_cond_init(&s->sidecar.cond, NULL);
+  s->sidecar.pending = g_hash_table_new(NULL, NULL);
+  s->sidecar.writing = g_hash_table_new(NULL, NULL);
+  s->sidecar.scheduled = FALSE;
+
   // start threads
   dt_control_jobs_init(s);
 
@@ -177,6 +183,11 @@ void dt_control_cleanup(dt_control_t *s)
   dt_pthread_mutex_destroy(&s->res_mutex);
   dt_pthread_mutex_destroy(&s->run_mutex);
   dt_pthread_mutex_destroy(&s->progress_system.mutex);
+  g_hash_table_destroy(s->sidecar.pending);
+  g_hash_table_destroy(s->sidecar.writing);
+  s->sidecar.pending = s->sidecar.writing = NULL;
+  pthread_cond_destroy(&s->sidecar.cond);
+  dt_pthread_mutex_destroy(&s->sidecar.mutex);
   if(s->accelerator_list)
   {
     g_slist_free_full(s->accelerator_list, g_free);
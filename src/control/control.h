@@ -191,6 +191,16 @@ typedef struct dt_control_t
   uint8_t new_res[DT_CTL_WORKER_RESERVED];
   pthread_t thread_res[DT_CTL_WORKER_RESERVED];
 
+  // xmp sidecar writes, coalesced per image and written in the background
+  struct
+  {
+    dt_pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    GHashTable *pending; // images waiting to be written
+    GHashTable *writing; // images being written right now
+    gboolean scheduled;  // a job is on its way to pick up the pending images
+  } sidecar;
+
   struct
   {
     GList *list;
@@ -24,11 +24,17 @@
 
 #include "common/darktable.h"
 #include "common/database.h"
+#include "common/file_location.h"
 #include "common/history.h"
 #include "common/image.h"
+#include "common/image_cache.h"
 #include "control/conf.h"
+#include "control/control.h"
+#include "control/jobs.h"
 #include "crawler.h"
+#include "develop/develop.h"
 #include "gui/gtk.h"
+#include "views/view.h"
 #ifdef GDK_WINDOWING_QUARTZ
 #include "osx/osx.h"
 #endif
@@ -54,131 +60,381 @@ typedef struct dt_control_crawler_result_t
 } dt_control_crawler_result_t;
 
 
-GList *dt_control_crawler_run()
+// stat() calls in flight at a time. they mostly wait for the disk or the network, so this is independent of
+// the number of cpus.
+#define DT_CRAWLER_THREADS 8
+// images checked between two looks at the cancel button
+#define DT_CRAWLER_BATCH 256
+
+// one image to check, with what the check found
+typedef struct dt_control_crawler_image_t
 {
-  sqlite3_stmt *stmt, *inner_stmt;
-  GList *result = NULL;
-  gboolean look_for_xmp = dt_conf_get_bool("write_sidecar_files");
+  int id, version, flags;
+  time_t timestamp;
+  gchar *image_path; // in locale encoding
 
-  sqlite3_prepare_v2(dt_database_get(darktable.db),
-                     "SELECT i.id, write_timestamp, version, folder || '" G_DIR_SEPARATOR_S "' || filename, flags "
-                     "FROM main.images i, main.film_rolls f ON i.film_id = f.id ORDER BY f.id, filename",
-                     -1, &stmt, NULL);
-  sqlite3_prepare_v2(dt_database_get(darktable.db), "UPDATE main.images SET flags = ?1 WHERE id = ?2", -1,
-                     &inner_stmt, NULL);
+  time_t timestamp_xmp; // of the xmp file, if that is newer than the db entry
+  gchar *xmp_path;
+  int extra_flags;      // DT_IMAGE_HAS_TXT and DT_IMAGE_HAS_WAV as found on disk
+} dt_control_crawler_image_t;
 
-  // let's wrap this into a transaction, it might make it a little faster.
-  sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+typedef struct dt_control_crawler_folder_t
+{
+  gchar *folder;
+  gint64 mtime;
+  int last; // index of its last image to check
+} dt_control_crawler_folder_t;
+
+/* the state of the last crawl is the mtime each folder had when its images were checked. adding, removing or
+ * renaming a file changes the mtime of its folder, but writing to an existing file doesn't, and xmp files are
+ * overwritten in place (dt_exif_xmp_write() just opens them with "wb", as do most other tools). so skipping the
+ * folders with the same mtime as before misses edited xmp files and only notices new or removed ones. that is
+ * why it is an option, off by default, for big collections on slow disks. */
+
+static gchar *_crawler_state_filename()
+{
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  return g_build_filename(cachedir, "crawler.cache", NULL);
+}
 
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+// folder -> mtime, one "mtime folder" line each
+static GHashTable *_crawler_state_read()
+{
+  GHashTable *state = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  gchar *filename = _crawler_state_filename();
+  gchar *contents = NULL;
+  if(g_file_get_contents(filename, &contents, NULL, NULL))
   {
-    const int id = sqlite3_column_int(stmt, 0);
-    const time_t timestamp = sqlite3_column_int(stmt, 1);
-    const int version = sqlite3_column_int(stmt, 2);
-    gchar *image_path = g_locale_from_utf8((gchar *)sqlite3_column_text(stmt, 3),-1,NULL,NULL,NULL);
-    int flags = sqlite3_column_int(stmt, 4);
-
-    // no need to look for xmp files if none get written anyway.
-    if(look_for_xmp)
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    for(gchar **line = lines; *line; line++)
     {
-      // construct the xmp filename for this image
-      gchar xmp_path[PATH_MAX] = { 0 };
-      g_strlcpy(xmp_path, image_path, sizeof(xmp_path));
-      dt_image_path_append_version_no_db(version, xmp_path, sizeof(xmp_path));
-      size_t len = strlen(xmp_path);
-      if(len + 4 >= PATH_MAX) continue;
-      xmp_path[len++] = '.';
-      xmp_path[len++] = 'x';
-      xmp_path[len++] = 'm';
-      xmp_path[len++] = 'p';
-      xmp_path[len] = '\0';
-
-      struct stat statbuf;
-      if(stat(xmp_path, &statbuf) == -1) continue; // TODO: shall we report these?
-
-      // step 1: check if the xmp is newer than our db entry
-      // FIXME: allow for a few seconds difference?
-      if(timestamp < statbuf.st_mtime)
-      {
-        dt_control_crawler_result_t *item
-            = (dt_control_crawler_result_t *)malloc(sizeof(dt_control_crawler_result_t));
-        item->id = id;
-        item->timestamp_xmp = statbuf.st_mtime;
-        item->timestamp_db = timestamp;
-        item->image_path = g_strdup(image_path);
-        item->xmp_path = g_strdup(xmp_path);
-
-        result = g_list_append(result, item);
-        dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is a newer xmp file.\n", xmp_path, id);
-      }
-      // older timestamps are the case for all images after the db upgrade. better not report these
-      //       else if(timestamp > statbuf.st_mtime)
-      //         printf("`%s' (%d) has an older xmp file.\n", image_path, id);
+      char *folder = NULL;
+      const gint64 mtime = g_ascii_strtoll(*line, &folder, 10);
+      if(folder == *line || *folder != ' ') continue;
+      gint64 *value = g_new(gint64, 1);
+      *value = mtime;
+      g_hash_table_insert(state, g_strdup(folder + 1), value);
     }
+    g_strfreev(lines);
+    g_free(contents);
+  }
+  g_free(filename);
+  return state;
+}
 
-    // step 2: check if the image has associated files (.txt, .wav)
-    size_t len = strlen(image_path);
-    char *c = image_path + len;
-    while((c > image_path) && (*c != '.')) *c-- = '\0';
-    len = c - image_path + 1;
+static void _crawler_state_write(GHashTable *state)
+{
+  gchar *filename = _crawler_state_filename();
+  FILE *f = g_fopen(filename, "wb");
+  if(f)
+  {
+    GHashTableIter it;
+    gpointer key, value;
+    g_hash_table_iter_init(&it, state);
+    while(g_hash_table_iter_next(&it, &key, &value))
+      fprintf(f, "%" G_GINT64_FORMAT " %s\n", *(gint64 *)value, (const char *)key);
+    fclose(f);
+  }
+  g_free(filename);
+}
 
-    char *extra_path = g_strndup(image_path, len + 3);
+static void _crawler_state_set(GHashTable *state, const char *folder, const gint64 mtime)
+{
+  gint64 *value = g_new(gint64, 1);
+  *value = mtime;
+  g_hash_table_insert(state, g_strdup(folder), value);
+}
 
-    extra_path[len] = 't';
-    extra_path[len + 1] = 'x';
-    extra_path[len + 2] = 't';
-    gboolean has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+// looks at the files of one image, this is what runs in parallel
+static void _crawler_check_image(dt_control_crawler_image_t *image, const gboolean look_for_xmp)
+{
+  gchar *image_path = image->image_path;
 
-    if(!has_txt)
+  // no need to look for xmp files if none get written anyway.
+  if(look_for_xmp)
+  {
+    // construct the xmp filename for this image
+    gchar xmp_path[PATH_MAX] = { 0 };
+    g_strlcpy(xmp_path, image_path, sizeof(xmp_path));
+    dt_image_path_append_version_no_db(image->version, xmp_path, sizeof(xmp_path));
+    size_t len = strlen(xmp_path);
+    if(len + 4 >= PATH_MAX) return;
+    xmp_path[len++] = '.';
+    xmp_path[len++] = 'x';
+    xmp_path[len++] = 'm';
+    xmp_path[len++] = 'p';
+    xmp_path[len] = '\0';
+
+    struct stat statbuf;
+    if(stat(xmp_path, &statbuf) == -1) return; // TODO: shall we report these?
+
+    // step 1: check if the xmp is newer than our db entry
+    // FIXME: allow for a few seconds difference?
+    if(image->timestamp < statbuf.st_mtime)
     {
-      extra_path[len] = 'T';
-      extra_path[len + 1] = 'X';
-      extra_path[len + 2] = 'T';
-      has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+      image->timestamp_xmp = statbuf.st_mtime;
+      image->xmp_path = g_strdup(xmp_path);
     }
+    // older timestamps are the case for all images after the db upgrade. better not report these
+    //       else if(timestamp > statbuf.st_mtime)
+    //         printf("`%s' (%d) has an older xmp file.\n", image_path, id);
+  }
+
+  // step 2: check if the image has associated files (.txt, .wav)
+  gchar *base = g_strdup(image_path);
+  size_t len = strlen(base);
+  char *c = base + len;
+  while((c > base) && (*c != '.')) *c-- = '\0';
+  len = c - base + 1;
 
-    extra_path[len] = 'w';
-    extra_path[len + 1] = 'a';
-    extra_path[len + 2] = 'v';
-    gboolean has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+  char *extra_path = g_strndup(base, len + 3);
+  g_free(base);
 
-    if(!has_wav)
+  extra_path[len] = 't';
+  extra_path[len + 1] = 'x';
+  extra_path[len + 2] = 't';
+  gboolean has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+
+  if(!has_txt)
+  {
+    extra_path[len] = 'T';
+    extra_path[len + 1] = 'X';
+    extra_path[len + 2] = 'T';
+    has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+  }
+
+  extra_path[len] = 'w';
+  extra_path[len + 1] = 'a';
+  extra_path[len + 2] = 'v';
+  gboolean has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+
+  if(!has_wav)
+  {
+    extra_path[len] = 'W';
+    extra_path[len + 1] = 'A';
+    extra_path[len + 2] = 'V';
+    has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+  }
+
+  // TODO: decide if we want to remove the flag for images that lost their extra file. currently we do (the
+  // else cases)
+  image->extra_flags = (has_txt ? DT_IMAGE_HAS_TXT : 0) | (has_wav ? DT_IMAGE_HAS_WAV : 0);
+
+  g_free(extra_path);
+}
+
+// takes over what the checks of one image found. the flags go through the image cache, as other parts of
+// darktable are running by now and might have the image in there. for the same reason the write timestamp
+// is read again with timestamp_stmt: darktable itself may have written the xmp since the images were listed.
+static GList *_crawler_apply(dt_control_crawler_image_t *image, sqlite3_stmt *timestamp_stmt, GList *result)
+{
+  const int mask = DT_IMAGE_HAS_TXT | DT_IMAGE_HAS_WAV;
+  if((image->flags & mask) != image->extra_flags)
+  {
+    dt_image_t *img = dt_image_cache_get(darktable.image_cache, image->id, 'w');
+    if(img)
     {
-      extra_path[len] = 'W';
-      extra_path[len + 1] = 'A';
-      extra_path[len + 2] = 'V';
-      has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+      img->flags = (img->flags & ~mask) | image->extra_flags;
+      dt_image_cache_write_release(darktable.image_cache, img, DT_IMAGE_CACHE_RELAXED);
     }
+  }
 
-    // TODO: decide if we want to remove the flag for images that lost their extra file. currently we do (the
-    // else cases)
-    int new_flags = flags;
-    if(has_txt)
-      new_flags |= DT_IMAGE_HAS_TXT;
-    else
-      new_flags &= ~DT_IMAGE_HAS_TXT;
-    if(has_wav)
-      new_flags |= DT_IMAGE_HAS_WAV;
-    else
-      new_flags &= ~DT_IMAGE_HAS_WAV;
-    if(flags != new_flags)
+  if(image->xmp_path)
+  {
+    sqlite3_bind_int(timestamp_stmt, 1, image->id);
+    // an image which is gone meanwhile isn't reported either
+    const gboolean found = (sqlite3_step(timestamp_stmt) == SQLITE_ROW);
+    if(found) image->timestamp = sqlite3_column_int(timestamp_stmt, 0);
+    sqlite3_reset(timestamp_stmt);
+    sqlite3_clear_bindings(timestamp_stmt);
+    if(!found || image->timestamp >= image->timestamp_xmp)
     {
-      sqlite3_bind_int(inner_stmt, 1, new_flags);
-      sqlite3_bind_int(inner_stmt, 2, id);
-      sqlite3_step(inner_stmt);
-      sqlite3_reset(inner_stmt);
-      sqlite3_clear_bindings(inner_stmt);
+      g_free(image->xmp_path);
+      image->xmp_path = NULL;
+      return result;
     }
+  }
+
+  if(image->xmp_path)
+  {
+    dt_control_crawler_result_t *item = (dt_control_crawler_result_t *)malloc(sizeof(dt_control_crawler_result_t));
+    item->id = image->id;
+    item->timestamp_xmp = image->timestamp_xmp;
+    item->timestamp_db = image->timestamp;
+    item->image_path = g_strdup(image->image_path);
+    item->xmp_path = image->xmp_path;
+    image->xmp_path = NULL;
+
+    result = g_list_prepend(result, item);
+    dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is a newer xmp file.\n", item->xmp_path, item->id);
+  }
+  return result;
+}
 
-    g_free(extra_path);
+// checks ALL images from the database, apart from the ones in folders which didn't change since the last crawl
+// if that is enabled. returns the images with a (supposedly) updated xmp file.
+static GList *_crawler_run(dt_job_t *job)
+{
+  sqlite3_stmt *stmt;
+  GList *result = NULL;
+  const gboolean look_for_xmp = dt_conf_get_bool("write_sidecar_files");
+  const gboolean incremental = dt_conf_get_bool("run_crawler_changed_folders_only");
+
+  GHashTable *last_state = _crawler_state_read();
+  GHashTable *state = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+  // collect the images of all folders which changed, the cheap part
+  GArray *images = g_array_new(FALSE, FALSE, sizeof(dt_control_crawler_image_t));
+  GArray *folders = g_array_new(FALSE, FALSE, sizeof(dt_control_crawler_folder_t));
+  sqlite3_prepare_v2(dt_database_get(darktable.db),
+                     "SELECT i.id, write_timestamp, version, folder || '" G_DIR_SEPARATOR_S "' || filename, flags, "
+                     "f.id, folder FROM main.images i, main.film_rolls f ON i.film_id = f.id ORDER BY f.id, filename",
+                     -1, &stmt, NULL);
+  int film_id = -1;
+  gboolean skip = FALSE;
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    if(sqlite3_column_int(stmt, 5) != film_id)
+    {
+      film_id = sqlite3_column_int(stmt, 5);
+      const char *folder = (const char *)sqlite3_column_text(stmt, 6);
+      if(!folder) folder = "";
+      gchar *folder_path = g_locale_from_utf8(folder, -1, NULL, NULL, NULL);
+      GStatBuf statbuf;
+      const gint64 mtime = (folder_path && !g_stat(folder_path, &statbuf)) ? (gint64)statbuf.st_mtime : -1;
+      g_free(folder_path);
+
+      const gint64 *last_mtime = (const gint64 *)g_hash_table_lookup(last_state, folder);
+      skip = incremental && mtime != -1 && last_mtime && *last_mtime == mtime;
+      if(skip)
+        _crawler_state_set(state, folder, mtime);
+      else
+      {
+        const dt_control_crawler_folder_t f = { g_strdup(folder), mtime, -1 };
+        g_array_append_val(folders, f);
+      }
+    }
+    if(skip) continue;
+
+    dt_control_crawler_image_t image = { 0 };
+    image.id = sqlite3_column_int(stmt, 0);
+    image.timestamp = sqlite3_column_int(stmt, 1);
+    image.version = sqlite3_column_int(stmt, 2);
+    image.image_path = g_locale_from_utf8((gchar *)sqlite3_column_text(stmt, 3), -1, NULL, NULL, NULL);
+    image.flags = sqlite3_column_int(stmt, 4);
+    if(!image.image_path) continue;
+    g_array_append_val(images, image);
+    g_array_index(folders, dt_control_crawler_folder_t, folders->len - 1).last = images->len - 1;
   }
+  sqlite3_finalize(stmt);
+  g_hash_table_destroy(last_state);
+
+  dt_print(DT_DEBUG_CONTROL, "[crawler] checking %u images in %u folders\n", images->len, folders->len);
+
+  // and look at their files in batches, in parallel
+  sqlite3_prepare_v2(dt_database_get(darktable.db), "SELECT write_timestamp FROM main.images WHERE id = ?1", -1,
+                     &stmt, NULL);
+  dt_control_crawler_image_t *const list = (dt_control_crawler_image_t *)images->data;
+  const int total = images->len;
+  int done = 0;
+  guint folder = 0;
+  while(done < total && dt_control_running() && dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED)
+  {
+    const int end = MIN(done + DT_CRAWLER_BATCH, total);
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(done, end, list, look_for_xmp) \
+    schedule(dynamic) num_threads(DT_CRAWLER_THREADS)
+#endif
+    for(int k = done; k < end; k++) _crawler_check_image(&list[k], look_for_xmp);
 
-  sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+    for(int k = done; k < end; k++) result = _crawler_apply(&list[k], stmt, result);
+    done = end;
+    dt_control_job_set_progress(job, (double)done / total);
 
+    // remember the folders which are checked completely
+    for(; folder < folders->len; folder++)
+    {
+      const dt_control_crawler_folder_t *f = &g_array_index(folders, dt_control_crawler_folder_t, folder);
+      if(f->last >= done) break;
+      if(f->mtime != -1) _crawler_state_set(state, f->folder, f->mtime);
+    }
+  }
   sqlite3_finalize(stmt);
-  sqlite3_finalize(inner_stmt);
 
-  return result;
+  _crawler_state_write(state);
+  g_hash_table_destroy(state);
+
+  for(guint k = 0; k < images->len; k++)
+  {
+    g_free(list[k].image_path);
+    g_free(list[k].xmp_path);
+  }
+  g_array_free(images, TRUE);
+  for(guint k = 0; k < folders->len; k++) g_free(g_array_index(folders, dt_control_crawler_folder_t, k).folder);
+  g_array_free(folders, TRUE);
+
+  return g_list_reverse(result);
+}
+
+static void _crawler_free_result(gpointer data)
+{
+  dt_control_crawler_result_t *item = (dt_control_crawler_result_t *)data;
+  g_free(item->image_path);
+  g_free(item->xmp_path);
+  g_free(item);
+}
+
+// reloading the xmp of the image that is being edited would pull the history away from under the darkroom
+static gboolean _crawler_image_in_darkroom(GList *images)
+{
+  const dt_view_t *cv = dt_view_manager_get_current_view(darktable.view_manager);
+  if(!cv || cv->view((dt_view_t *)cv) != DT_VIEW_DARKROOM) return FALSE;
+  for(GList *iter = images; iter; iter = g_list_next(iter))
+    if(((dt_control_crawler_result_t *)iter->data)->id == darktable.develop->image_storage.id) return TRUE;
+  return FALSE;
+}
+
+static gboolean _crawler_show_image_list(gpointer user_data)
+{
+  GList *images = (GList *)user_data;
+
+  // darktable is shutting down, nobody is going to answer the dialog
+  if(!dt_control_running())
+  {
+    g_list_free_full(images, _crawler_free_result);
+    return FALSE;
+  }
+
+  // try again once the user left the image
+  if(_crawler_image_in_darkroom(images))
+  {
+    g_timeout_add_seconds(2, _crawler_show_image_list, images);
+    return FALSE;
+  }
+
+  dt_control_crawler_show_image_list(images);
+  return FALSE; // only call once
+}
+
+static int32_t _crawler_job_run(dt_job_t *job)
+{
+  const double start = dt_get_wtime();
+  GList *images = _crawler_run(job);
+  dt_print(DT_DEBUG_CONTROL, "[crawler] took %f seconds\n", dt_get_wtime() - start);
+
+  // the dialog has to be built by the gui thread
+  if(images) g_idle_add(_crawler_show_image_list, images);
+  return 0;
+}
+
+void dt_control_crawler_start()
+{
+  dt_job_t *job = dt_control_job_create(&_crawler_job_run, "%s", "look for updated xmp files");
+  if(!job) return;
+  dt_control_job_add_progress(job, _("looking for updated xmp files"), TRUE);
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_USER_BG, job);
 }
 
 
@@ -129,6 +129,9 @@ static int32_t _generic_dt_control_fileop_images_job_run(dt_job_t *job,
   double fraction = 0;
   gchar *newdir = (gchar *)params->data;
 
+  // sidecars are moved along with the images, they have to be up to date
+  dt_control_flush_sidecar_files();
+
   g_snprintf(message, sizeof(message), ngettext(desc, desc_pl, total), total);
   dt_control_job_set_progress_message(job, message);
 
@@ -205,6 +208,126 @@ static dt_job_t *dt_control_generic_images_job_create(dt_job_execute_callback ex
   return job;
 }
 
+// time in ms during which repeated sidecar writes of an image are folded into one
+#define DT_CONTROL_SIDECAR_DELAY 200
+
+static void _sidecar_schedule();
+
+// writes pending images until there are none left, returns the number of images written
+static int _sidecar_drain()
+{
+  dt_control_t *s = darktable.control;
+  int count = 0;
+  dt_pthread_mutex_lock(&s->sidecar.mutex);
+  while(TRUE)
+  {
+    // pick an image which is not being written by someone else right now
+    gpointer imgid = NULL;
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, s->sidecar.pending);
+    while(g_hash_table_iter_next(&iter, &key, NULL))
+      if(!g_hash_table_contains(s->sidecar.writing, key))
+      {
+        imgid = key;
+        g_hash_table_iter_remove(&iter);
+        break;
+      }
+    if(!imgid) break;
+
+    g_hash_table_add(s->sidecar.writing, imgid);
+    dt_pthread_mutex_unlock(&s->sidecar.mutex);
+
+    dt_image_write_sidecar_file(GPOINTER_TO_INT(imgid));
+    count++;
+
+    dt_pthread_mutex_lock(&s->sidecar.mutex);
+    g_hash_table_remove(s->sidecar.writing, imgid);
+    pthread_cond_broadcast(&s->sidecar.cond);
+  }
+  dt_pthread_mutex_unlock(&s->sidecar.mutex);
+  return count;
+}
+
+static int32_t _sidecar_drain_job_run(dt_job_t *job)
+{
+  _sidecar_drain();
+  return 0;
+}
+
+static int32_t _sidecar_queue_job_run(dt_job_t *job)
+{
+  dt_control_t *s = darktable.control;
+
+  dt_pthread_mutex_lock(&s->sidecar.mutex);
+  const int pending = g_hash_table_size(s->sidecar.pending);
+  dt_pthread_mutex_unlock(&s->sidecar.mutex);
+
+  // the xmp files are independent of each other, have all worker threads help out
+  for(int k = 1; k < MIN(s->num_threads, pending); k++)
+  {
+    dt_job_t *drain_job = dt_control_job_create(&_sidecar_drain_job_run, "%s", "write sidecar files");
+    if(drain_job) dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, drain_job);
+  }
+
+  const double start = dt_get_wtime();
+  const int count = _sidecar_drain();
+  if(count)
+    dt_print(DT_DEBUG_PERF, "[sidecar] wrote %d of %d queued xmp files in %.3f secs\n", count, pending,
+             dt_get_wtime() - start);
+  return 0;
+}
+
+static void _sidecar_queue_job_cleanup(void *p)
+{
+  dt_control_t *s = darktable.control;
+  dt_pthread_mutex_lock(&s->sidecar.mutex);
+  s->sidecar.scheduled = FALSE;
+  dt_pthread_mutex_unlock(&s->sidecar.mutex);
+
+  // images which have been queued again while being written
+  _sidecar_schedule();
+}
+
+static gboolean _sidecar_add_job(gpointer user_data)
+{
+  dt_control_t *s = darktable.control;
+  dt_job_t *job = dt_control_running()
+                      ? dt_control_job_create(&_sidecar_queue_job_run, "%s", "write sidecar files")
+                      : NULL;
+  if(!job)
+  {
+    dt_pthread_mutex_lock(&s->sidecar.mutex);
+    s->sidecar.scheduled = FALSE;
+    dt_pthread_mutex_unlock(&s->sidecar.mutex);
+    return FALSE;
+  }
+  dt_control_job_set_params(job, NULL, _sidecar_queue_job_cleanup);
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
+  return FALSE; // only call once
+}
+
+// makes sure a job will pick up the pending images. must not be called locked.
+static void _sidecar_schedule()
+{
+  dt_control_t *s = darktable.control;
+  // during shutdown dt_control_flush_sidecar_files() takes care of the rest
+  if(!dt_control_running()) return;
+
+  dt_pthread_mutex_lock(&s->sidecar.mutex);
+  const gboolean schedule = !s->sidecar.scheduled && g_hash_table_size(s->sidecar.pending);
+  if(schedule) s->sidecar.scheduled = TRUE;
+  dt_pthread_mutex_unlock(&s->sidecar.mutex);
+  if(!schedule) return;
+
+  // let the requests of a burst of changes pile up. the main loop keeps the time, so no worker waits for it.
+  // without gui there is no main loop running, the job goes out right away then.
+  if(darktable.gui)
+    g_timeout_add(DT_CONTROL_SIDECAR_DELAY, _sidecar_add_job, NULL);
+  else
+    _sidecar_add_job(NULL);
+}
+
 static int32_t dt_control_write_sidecar_files_job_run(dt_job_t *job)
 {
   int imgid = -1;
@@ -904,6 +1027,9 @@ static int32_t dt_control_delete_images_job_run(dt_job_t *job)
     snprintf(message, sizeof(message), ngettext("deleting %d image", "deleting %d images", total), total);
   dt_control_job_set_progress_message(job, message);
 
+  // a late write would bring back the sidecar of a deleted image
+  dt_control_flush_sidecar_files();
+
   sqlite3_stmt *stmt;
 
   dt_collection_update(darktable.collection);
@@ -1213,6 +1339,9 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
   // get a thread-safe fdata struct (one jpeg struct per thread etc):
   dt_imageio_module_data_t *fdata = mformat->get_params(mformat);
 
+  // storages might pick up the sidecars next to the exported images
+  dt_control_flush_sidecar_files();
+
   if(mstorage->initialize_store)
   {
     if(mstorage->initialize_store(mstorage, sdata, &mformat, &fdata, &t, settings->high_quality, settings->upscale))
@@ -1817,6 +1946,59 @@ void dt_control_write_sidecar_files()
                                                           N_("write sidecar files"), 0, NULL, PROGRESS_NONE));
 }
 
+void dt_control_queue_sidecar_file(const int imgid)
+{
+  if(imgid <= 0) return;
+  dt_control_write_sidecar_files_list(g_list_prepend(NULL, GINT_TO_POINTER(imgid)));
+}
+
+void dt_control_write_sidecar_files_list(GList *imgs)
+{
+  if(!imgs) return;
+  if(!dt_conf_get_bool("write_sidecar_files"))
+  {
+    g_list_free(imgs);
+    return;
+  }
+
+  dt_control_t *s = darktable.control;
+  if(!s->sidecar.pending || !dt_control_running())
+  {
+    // no workers to hand them over to (cli or shutting down), write them right here
+    for(GList *l = imgs; l; l = g_list_next(l)) dt_image_write_sidecar_file(GPOINTER_TO_INT(l->data));
+    g_list_free(imgs);
+    return;
+  }
+
+  dt_pthread_mutex_lock(&s->sidecar.mutex);
+  for(GList *l = imgs; l; l = g_list_next(l))
+    if(GPOINTER_TO_INT(l->data) > 0) g_hash_table_add(s->sidecar.pending, l->data);
+  dt_pthread_mutex_unlock(&s->sidecar.mutex);
+  g_list_free(imgs);
+
+  _sidecar_schedule();
+}
+
+void dt_control_flush_sidecar_files()
+{
+  dt_control_t *s = darktable.control;
+  if(!s->sidecar.pending) return;
+
+  // don't wait for the background jobs, write what is left on this thread and wait for the writes still in
+  // progress elsewhere. images queued again meanwhile are picked up after those.
+  gboolean busy = TRUE;
+  while(busy)
+  {
+    _sidecar_drain();
+    dt_pthread_mutex_lock(&s->sidecar.mutex);
+    busy = g_hash_table_size(s->sidecar.writing) > 0;
+    if(busy) dt_pthread_cond_wait(&s->sidecar.cond, &s->sidecar.mutex);
+    dt_pthread_mutex_unlock(&s->sidecar.mutex);
+  }
+}
+
+#undef DT_CONTROL_SIDECAR_DELAY
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -31,6 +31,13 @@ void dt_control_gpx_apply(const gchar *filename, int32_t filmid, const gchar *tz
 void dt_control_time_offset(const long int offset, int imgid);
 
 void dt_control_write_sidecar_files();
+/** queues the xmp sidecar write of an image. requests for the same image within a short time are folded
+ * into one write, done in the background and spread over the worker threads. */
+void dt_control_queue_sidecar_file(const int imgid);
+/** same for a list of images, takes ownership of imgs */
+void dt_control_write_sidecar_files_list(GList *imgs);
+/** writes all queued sidecars and waits for the ones in progress, to be called before the xmp files are needed */
+void dt_control_flush_sidecar_files();
 void dt_control_delete_images();
 void dt_control_duplicate_images();
 void dt_control_flip_images(const int32_t cw);
@@ -62,6 +62,9 @@ void dt_dev_init(dt_develop_t *dev, int32_t gui_attached)
   dev->preview2_average_delay = DT_DEV_PREVIEW_AVERAGE_DELAY_START;
   dev->gui_leaving = 0;
   dev->gui_synch = 0;
+  dt_pthread_mutex_init(&dev->hash_sync_mutex, NULL);
+  pthread_cond_init(&dev->hash_sync_cond, NULL);
+  dev->hash_sync_serial = 0;
   dt_pthread_mutex_init(&dev->history_mutex, NULL);
   dev->history_end = 0;
   dev->history = NULL; // empty list
@@ -124,6 +127,8 @@ void dt_dev_init(dt_develop_t *dev, int32_t gui_attached)
     dev->histogram_waveform_height = 128;
     dev->histogram_waveform_stride = 4 * dev->histogram_waveform_width;
     dev->histogram_waveform = (uint8_t *)calloc(dev->histogram_waveform_height * dev->histogram_waveform_stride, sizeof(uint8_t));
+    dev->histogram_waveform_bins = (uint32_t *)calloc(dev->histogram_waveform_height * dev->histogram_waveform_width * 3,
+                                                      sizeof(uint32_t));
   }
 
   dev->iop_instance = 0;
@@ -203,10 +208,13 @@ void dt_dev_cleanup(dt_develop_t *dev)
     dev->allprofile_info = g_list_delete_link(dev->allprofile_info, dev->allprofile_info);
   }
   dt_pthread_mutex_destroy(&dev->history_mutex);
+  pthread_cond_destroy(&dev->hash_sync_cond);
+  dt_pthread_mutex_destroy(&dev->hash_sync_mutex);
   free(dev->histogram);
   free(dev->histogram_pre_tonecurve);
   free(dev->histogram_pre_levels);
   free(dev->histogram_waveform);
+  free(dev->histogram_waveform_bins);
 
   g_list_free_full(dev->forms, (void (*)(void *))dt_masks_free_form);
   g_list_free_full(dev->allforms, (void (*)(void *))dt_masks_free_form);
@@ -588,7 +596,7 @@ restart:
   y = MAX(0, scale * dev->pipe->processed_height * (.5 + zoom_y) - ht / 2);
 
   dt_get_times(&start);
-  if(dt_dev_pixelpipe_process(dev->pipe, dev, x, y, wd, ht, scale))
+  if(dt_dev_pixelpipe_process_tiled(dev->pipe, dev, x, y, wd, ht, scale))
   {
     // interrupted because image changed?
     if(dev->image_force_reload)
@@ -1420,7 +1428,9 @@ static void _dev_merge_history(dt_develop_t *dev, const int imgid)
                                   "UPDATE memory.history SET num=?1 WHERE rowid=?2", -1, &stmt, NULL);
 
       // let's wrap this into a transaction, it might make it a little faster.
-      sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+      // a bulk history paste might already have opened one for us.
+      const gboolean own_transaction = sqlite3_get_autocommit(dt_database_get(darktable.db));
+      if(own_transaction) sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
       for(GList *r = rowids; r; r = g_list_next(r))
       {
         DT_DEBUG_SQLITE3_CLEAR_BINDINGS(stmt);
@@ -1433,7 +1443,7 @@ static void _dev_merge_history(dt_develop_t *dev, const int imgid)
         v++;
       }
 
-      sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+      if(own_transaction) sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
 
       g_list_free(rowids);
       sqlite3_finalize(stmt);
@@ -2413,10 +2423,18 @@ uint64_t dt_dev_hash_plus(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe, co
   return hash;
 }
 
-int dt_dev_wait_hash(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe, const double iop_order, const int transf_direction, dt_pthread_mutex_t *lock,
-                     const volatile uint64_t *const hash)
+void dt_dev_hash_notify(dt_develop_t *dev)
+{
+  dt_pthread_mutex_lock(&dev->hash_sync_mutex);
+  dev->hash_sync_serial++;
+  pthread_cond_broadcast(&dev->hash_sync_cond);
+  dt_pthread_mutex_unlock(&dev->hash_sync_mutex);
+}
+
+static int _dev_wait_hash(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe, const double iop_order,
+                          const int transf_direction, dt_pthread_mutex_t *lock, const volatile uint64_t *const hash,
+                          const gboolean distort)
 {
-  const int usec = 5000;
   int nloop;
 
 #ifdef HAVE_OPENCL
@@ -2430,10 +2448,25 @@ int dt_dev_wait_hash(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe, const d
 
   if(nloop <= 0) return TRUE;  // non-positive values omit pixelpipe synchronization
 
-  for(int n = 0; n < nloop; n++)
+  // the timeout is configured in units of 5ms
+  const double start = dt_get_wtime();
+  const double timeout = nloop * 0.005;
+  // wake up now and then even without notification, pipe shutdown is not announced
+  const double max_sleep = 0.05;
+  int synced = FALSE;
+
+  while(TRUE)
   {
     if(pipe->shutdown)
-      return TRUE;  // stop waiting if pipe shuts down
+    {
+      synced = TRUE;  // stop waiting if pipe shuts down
+      break;
+    }
+
+    // remember the serial before probing, so that no notification gets lost in between
+    dt_pthread_mutex_lock(&dev->hash_sync_mutex);
+    const uint64_t serial = dev->hash_sync_serial;
+    dt_pthread_mutex_unlock(&dev->hash_sync_mutex);
 
     uint64_t probehash;
 
@@ -2446,13 +2479,46 @@ int dt_dev_wait_hash(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe, const d
     else
       probehash = *hash;
 
-    if(probehash == dt_dev_hash_plus(dev, pipe, iop_order, transf_direction))
-      return TRUE;
+    const uint64_t pipehash = distort ? dt_dev_hash_distort_plus(dev, pipe, iop_order, transf_direction)
+                                      : dt_dev_hash_plus(dev, pipe, iop_order, transf_direction);
+    if(probehash == pipehash)
+    {
+      synced = TRUE;
+      break;
+    }
+
+    const double remaining = timeout - (dt_get_wtime() - start);
+    if(remaining <= 0.0) break;
 
-    dt_iop_nap(usec);
+    // block until somebody publishes a hash, or the next wake up is due
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    const double sleep = MIN(remaining, max_sleep);
+    deadline.tv_sec += (time_t)sleep;
+    deadline.tv_nsec += (long)((sleep - (time_t)sleep) * 1e9);
+    if(deadline.tv_nsec >= 1000000000L)
+    {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+
+    dt_pthread_mutex_lock(&dev->hash_sync_mutex);
+    while(dev->hash_sync_serial == serial
+          && dt_pthread_cond_timedwait(&dev->hash_sync_cond, &dev->hash_sync_mutex, &deadline) == 0)
+      ;
+    dt_pthread_mutex_unlock(&dev->hash_sync_mutex);
   }
 
-  return FALSE;
+  dt_print(DT_DEBUG_PERF, "[dev_wait_hash%s] %s after %.3f ms\n", distort ? "_distort" : "",
+           synced ? "in sync" : "timed out", 1000.0 * (dt_get_wtime() - start));
+
+  return synced;
+}
+
+int dt_dev_wait_hash(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe, const double iop_order, const int transf_direction, dt_pthread_mutex_t *lock,
+                     const volatile uint64_t *const hash)
+{
+  return _dev_wait_hash(dev, pipe, iop_order, transf_direction, lock, hash, FALSE);
 }
 
 int dt_dev_sync_pixelpipe_hash(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe, const double iop_order, const int transf_direction, dt_pthread_mutex_t *lock,
@@ -2514,43 +2580,7 @@ uint64_t dt_dev_hash_distort_plus(dt_develop_t *dev, struct dt_dev_pixelpipe_t *
 int dt_dev_wait_hash_distort(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe, const double iop_order, const int transf_direction, dt_pthread_mutex_t *lock,
                      const volatile uint64_t *const hash)
 {
-  const int usec = 5000;
-  int nloop;
-
-#ifdef HAVE_OPENCL
-  if(pipe->devid >= 0)
-    nloop = darktable.opencl->opencl_synchronization_timeout;
-  else
-    nloop = dt_conf_get_int("pixelpipe_synchronization_timeout");
-#else
-  nloop = dt_conf_get_int("pixelpipe_synchronization_timeout");
-#endif
-
-  if(nloop <= 0) return TRUE;  // non-positive values omit pixelpipe synchronization
-
-  for(int n = 0; n < nloop; n++)
-  {
-    if(pipe->shutdown)
-      return TRUE;  // stop waiting if pipe shuts down
-
-    uint64_t probehash;
-
-    if(lock)
-    {
-      dt_pthread_mutex_lock(lock);
-      probehash = *hash;
-      dt_pthread_mutex_unlock(lock);
-    }
-    else
-      probehash = *hash;
-
-    if(probehash == dt_dev_hash_distort_plus(dev, pipe, iop_order, transf_direction))
-      return TRUE;
-
-    dt_iop_nap(usec);
-  }
-
-  return FALSE;
+  return _dev_wait_hash(dev, pipe, iop_order, transf_direction, lock, hash, TRUE);
 }
 
 int dt_dev_sync_pixelpipe_hash_distort(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe, const double iop_order, const int transf_direction, dt_pthread_mutex_t *lock,
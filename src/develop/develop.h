@@ -159,6 +159,11 @@ typedef struct dt_develop_t
   // by the iop through the copy their respective pixelpipe holds, for thread-safety.
   dt_image_t image_storage;
 
+  // bumped and broadcast whenever pipe or module hashes may have changed, see dt_dev_hash_notify()
+  dt_pthread_mutex_t hash_sync_mutex;
+  pthread_cond_t hash_sync_cond;
+  uint64_t hash_sync_serial;
+
   // history stack
   dt_pthread_mutex_t history_mutex;
   int32_t history_end;
@@ -181,6 +186,8 @@ typedef struct dt_develop_t
   uint32_t *histogram, *histogram_pre_tonecurve, *histogram_pre_levels;
   uint32_t histogram_max, histogram_pre_tonecurve_max, histogram_pre_levels_max;
   uint8_t *histogram_waveform;
+  // scratch counts for the waveform, sized for the widest one
+  uint32_t *histogram_waveform_bins;
   uint32_t histogram_waveform_width, histogram_waveform_height, histogram_waveform_stride;
   dt_dev_histogram_type_t histogram_type;
 
@@ -446,6 +453,8 @@ struct dt_dev_pixelpipe_iop_t *dt_dev_distort_get_iop_pipe(dt_develop_t *dev, st
 uint64_t dt_dev_hash(dt_develop_t *dev);
 /** same function, but we can specify iop with priority between pmin and pmax */
 uint64_t dt_dev_hash_plus(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe, const double iop_order, const int transf_direction);
+/** wake up everybody waiting in dt_dev_wait_hash*(), to be called after publishing a new hash value */
+void dt_dev_hash_notify(dt_develop_t *dev);
 /** wait until hash value found in hash matches hash value defined by dev/pipe/pmin/pmax with timeout */
 int dt_dev_wait_hash(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe, const double iop_order, const int transf_direction, dt_pthread_mutex_t *lock,
                      const volatile uint64_t *const hash);
@@ -322,6 +322,10 @@ int dt_iop_load_module_so(void *m, const char *libname, const char *op)
     module->process_cl = NULL;
   if(!g_module_symbol(module->module, "process_tiling_cl", (gpointer) & (module->process_tiling_cl)))
     module->process_tiling_cl = darktable.opencl->inited ? default_process_tiling_cl : NULL;
+  if(!g_module_symbol(module->module, "process_pixels_prepare", (gpointer) & (module->process_pixels_prepare)))
+    module->process_pixels_prepare = NULL;
+  if(!g_module_symbol(module->module, "process_pixels", (gpointer) & (module->process_pixels)))
+    module->process_pixels = NULL;
   if(!g_module_symbol(module->module, "distort_transform", (gpointer) & (module->distort_transform)))
     module->distort_transform = default_distort_transform;
   if(!g_module_symbol(module->module, "distort_backtransform", (gpointer) & (module->distort_backtransform)))
@@ -453,6 +457,8 @@ int dt_iop_load_module_by_so(dt_iop_module_t *module, dt_iop_module_so_t *so, dt
   module->process_sse2 = so->process_sse2;
   module->process_cl = so->process_cl;
   module->process_tiling_cl = so->process_tiling_cl;
+  module->process_pixels_prepare = so->process_pixels_prepare;
+  module->process_pixels = so->process_pixels;
   module->distort_transform = so->distort_transform;
   module->distort_backtransform = so->distort_backtransform;
   module->distort_mask = so->distort_mask;
@@ -1427,11 +1433,31 @@ static void init_key_accels(dt_iop_module_so_t *module)
   sqlite3_finalize(stmt);
 }
 
+// conf keys the presets of some modules depend on
+static const char *_presets_conf_keys[] = { "plugins/darkroom/sharpen/auto_apply", NULL };
+
+static uint64_t _presets_manifest_hash(dt_iop_module_so_t *module)
+{
+  GString *extra = g_string_new(NULL);
+  g_string_append_printf(extra, "%d", dt_develop_blend_version());
+  for(const char **key = _presets_conf_keys; *key; key++)
+    g_string_append_printf(extra, "|%d", dt_conf_get_bool(*key));
+  const uint64_t hash = dt_module_manifest_hash(module->module, module->version(), extra->str);
+  g_string_free(extra, TRUE);
+  return hash;
+}
+
 static void dt_iop_init_module_so(void *m)
 {
   dt_iop_module_so_t *module = (dt_iop_module_so_t *)m;
 
-  init_presets(module);
+  // only (re)create the presets if something they depend on changed since the last start
+  const uint64_t hash = _presets_manifest_hash(module);
+  if(dt_module_presets_outdated("iop", module->op, hash, module->version(), dt_develop_blend_version()))
+  {
+    init_presets(module);
+    dt_module_manifest_store("iop", module->op, hash);
+  }
 
   // do not init accelerators if there is no gui
   if(darktable.gui)
@@ -1457,8 +1483,11 @@ static void dt_iop_init_module_so(void *m)
 
 void dt_iop_load_modules_so(void)
 {
+  // all the preset updates in one go instead of a transaction per statement
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "BEGIN", NULL, NULL, NULL);
   darktable.iop = dt_module_load_modules("/plugins", sizeof(dt_iop_module_so_t), dt_iop_load_module_so,
                                          dt_iop_init_module_so, NULL);
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
 }
 
 int dt_iop_load_module(dt_iop_module_t *module, dt_iop_module_so_t *module_so, dt_develop_t *dev)
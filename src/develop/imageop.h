@@ -104,7 +104,8 @@ typedef enum dt_iop_flags_t
   = 1 << 8, // Preview pixelpipe of this module must not run on GPU but always on CPU
   IOP_FLAGS_NO_HISTORY_STACK = 1 << 9, // This iop will never show up in the history stack
   IOP_FLAGS_NO_MASKS = 1 << 10,         // The module doesn't support masks (used with SUPPORT_BLENDING)
-  IOP_FLAGS_FENCE = 1 << 11              // No module can be moved pass this one
+  IOP_FLAGS_FENCE = 1 << 11,             // No module can be moved pass this one
+  IOP_FLAGS_FUSIBLE = 1 << 12            // Pure per-pixel operator, provides process_pixels() and may be fused
 } dt_iop_flags_t;
 
 /** status of a module*/
@@ -266,6 +267,9 @@ typedef struct dt_iop_module_so_t
   int (*process_tiling_cl)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                            const void *const i, void *const o, const struct dt_iop_roi_t *const roi_in,
                            const struct dt_iop_roi_t *const roi_out, const int bpp);
+  void (*process_pixels_prepare)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece);
+  void (*process_pixels)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                         const float *const in, float *const out, const size_t npixels);
 
   int (*distort_transform)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, float *points,
                            size_t points_count);
@@ -515,6 +519,12 @@ typedef struct dt_iop_module_t
   int (*process_tiling_cl)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                            const void *const i, void *const o, const struct dt_iop_roi_t *const roi_in,
                            const struct dt_iop_roi_t *const roi_out, const int bpp);
+  /** for IOP_FLAGS_FUSIBLE modules: set up per-piece state once before a fused run of process_pixels(). */
+  void (*process_pixels_prepare)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece);
+  /** for IOP_FLAGS_FUSIBLE modules: process npixels 4-channel float pixels, in may be equal to out.
+   * called concurrently on disjoint spans, so it must not touch shared state. */
+  void (*process_pixels)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                         const float *const in, float *const out, const size_t npixels);
 
   /** this functions are used for distort iop
    * points is an array of float {x1,y1,x2,y2,...}
@@ -34,8 +34,92 @@
 #include "common/interpolation.h"    // for dt_interpolation_new, dt_interp...
 #include "develop/imageop.h"         // for dt_iop_roi_t
 
-void dt_iop_flip_and_zoom_8(const uint8_t *in, int32_t iw, int32_t ih, uint8_t *out, int32_t ow, int32_t oh,
-                            const dt_image_orientation_t orientation, uint32_t *width, uint32_t *height)
+// reduces the 4 channel input by factor in both directions, with the same four taps per block as the generic
+// flip_and_zoom below (which for a factor of two is the box filter). runs over the input rows in memory order.
+// x0/y0 is the first tap: the generic code walks flipped axes from the far end, which puts its taps at another
+// phase inside the blocks and shifts them by whatever is left over of the input size.
+static void _reduce_8(const uint8_t *const in, const int32_t iw, uint8_t *const out, const int32_t rw,
+                      const int32_t rh, const int factor, const int32_t x0, const int32_t y0)
+{
+  const int half = factor / 2;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(factor, half, in, iw, out, rh, rw, x0, y0) \
+  schedule(static)
+#endif
+  for(int32_t j = 0; j < rh; j++)
+  {
+    const uint8_t *const row0 = in + (size_t)4 * iw * (y0 + factor * j);
+    const uint8_t *const row1 = row0 + (size_t)4 * iw * half;
+    uint8_t *const out2 = out + (size_t)4 * rw * j;
+    for(int32_t i = 0; i < rw; i++)
+    {
+      const size_t k0 = (size_t)4 * (x0 + factor * i);
+      const size_t k1 = k0 + 4 * half;
+      for(int c = 0; c < 4; c++)
+        out2[4 * i + c] = (row0[k0 + c] + row0[k1 + c] + row1[k0 + c] + row1[k1 + c] + 2) >> 2;
+    }
+  }
+}
+
+// flip_and_zoom for integer factors: reduce first, in the orientation of the input so that it reads whole
+// rows, then flip the factor^2 times smaller result. returns 0 if it couldn't get memory.
+static int _flip_and_zoom_8_integer(const uint8_t *in, const int32_t iw, const int32_t ih, uint8_t *out,
+                                    const uint32_t wd, const uint32_t ht,
+                                    const dt_image_orientation_t orientation, const int factor)
+{
+  if(orientation == ORIENTATION_NONE)
+  {
+    _reduce_8(in, iw, out, wd, ht, factor, 0, 0);
+    return 1;
+  }
+
+  const int32_t rw = (orientation & ORIENTATION_SWAP_XY) ? ht : wd;
+  const int32_t rh = (orientation & ORIENTATION_SWAP_XY) ? wd : ht;
+  const int half = factor / 2;
+  const int32_t x0 = (orientation & ORIENTATION_FLIP_X) ? iw - 1 - half - factor * (rw - 1) : 0;
+  const int32_t y0 = (orientation & ORIENTATION_FLIP_Y) ? ih - 1 - half - factor * (rh - 1) : 0;
+  uint8_t *const tmp = (uint8_t *)dt_alloc_align(64, (size_t)4 * rw * rh);
+  if(!tmp) return 0;
+  _reduce_8(in, iw, tmp, rw, rh, factor, x0, y0);
+
+  int32_t ii = 0, jj = 0;
+  int32_t si = 1, sj = rw;
+  if(orientation & ORIENTATION_FLIP_Y)
+  {
+    jj = rh - 1;
+    sj = -sj;
+  }
+  if(orientation & ORIENTATION_FLIP_X)
+  {
+    ii = rw - 1;
+    si = -si;
+  }
+  if(orientation & ORIENTATION_SWAP_XY)
+  {
+    const int32_t t = sj;
+    sj = si;
+    si = t;
+  }
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(ht, ii, jj, out, rw, si, sj, tmp, wd) \
+  schedule(static)
+#endif
+  for(uint32_t j = 0; j < ht; j++)
+  {
+    const uint8_t *const in2 = tmp + (ptrdiff_t)4 * (rw * jj + ii + sj * (int32_t)j);
+    uint8_t *const out2 = out + (size_t)4 * wd * j;
+    for(uint32_t i = 0; i < wd; i++) memcpy(out2 + 4 * i, in2 + (ptrdiff_t)4 * si * (int32_t)i, 4);
+  }
+
+  dt_free_align(tmp);
+  return 1;
+}
+
+static void _flip_and_zoom_8(const uint8_t *in, int32_t iw, int32_t ih, uint8_t *out, int32_t ow, int32_t oh,
+                             const dt_image_orientation_t orientation, uint32_t *width, uint32_t *height,
+                             const gboolean allow_integer)
 {
   // init strides:
   const uint32_t iwd = (orientation & ORIENTATION_SWAP_XY) ? ih : iw;
@@ -44,6 +128,17 @@ void dt_iop_flip_and_zoom_8(const uint8_t *in, int32_t iw, int32_t ih, uint8_t *
   const float scale = fmaxf(1.0, fmaxf(iwd / (float)ow, iht / (float)oh));
   const uint32_t wd = *width = MIN(ow, iwd / scale);
   const uint32_t ht = *height = MIN(oh, iht / scale);
+
+  // reducing by a power of two, like a mip made from the next larger one, doesn't need the per pixel offsets
+  // and bounds checks below. the scale only has to be close enough to the factor to pick the same pixels over
+  // the whole image: less than half a pixel off, as the float steps below add up rounding errors of their own,
+  // and a scale just below the factor must not round the output up to more whole blocks than the input has.
+  const int factor = (int)roundf(scale);
+  if(allow_integer && (factor == 2 || factor == 4 || factor == 8) && fabsf(scale - factor) * MAX(wd, ht) < 0.5f
+     && factor * wd <= iwd && factor * ht <= iht
+     && _flip_and_zoom_8_integer(in, iw, ih, out, wd, ht, orientation, factor))
+    return;
+
   const int bpp = 4; // bytes per pixel
   int32_t ii = 0, jj = 0;
   int32_t si = 1, sj = iw;
@@ -99,6 +194,19 @@ void dt_iop_flip_and_zoom_8(const uint8_t *in, int32_t iw, int32_t ih, uint8_t *
   }
 }
 
+void dt_iop_flip_and_zoom_8(const uint8_t *in, int32_t iw, int32_t ih, uint8_t *out, int32_t ow, int32_t oh,
+                            const dt_image_orientation_t orientation, uint32_t *width, uint32_t *height)
+{
+  _flip_and_zoom_8(in, iw, ih, out, ow, oh, orientation, width, height, TRUE);
+}
+
+void dt_iop_flip_and_zoom_8_generic(const uint8_t *in, int32_t iw, int32_t ih, uint8_t *out, int32_t ow,
+                                    int32_t oh, const dt_image_orientation_t orientation, uint32_t *width,
+                                    uint32_t *height)
+{
+  _flip_and_zoom_8(in, iw, ih, out, ow, oh, orientation, width, height, FALSE);
+}
+
 void dt_iop_clip_and_zoom_8(const uint8_t *i, int32_t ix, int32_t iy, int32_t iw, int32_t ih, int32_t ibw,
                             int32_t ibh, uint8_t *o, int32_t ox, int32_t oy, int32_t ow, int32_t oh,
                             int32_t obw, int32_t obh)
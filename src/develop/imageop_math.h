@@ -39,6 +39,12 @@
 void dt_iop_flip_and_zoom_8(const uint8_t *in, int32_t iw, int32_t ih, uint8_t *out, int32_t ow, int32_t oh,
                             const dt_image_orientation_t orientation, uint32_t *width, uint32_t *height);
 
+/** same, but always with the per pixel sampler, without the shortcut for factors of 2, 4 and 8. used as the
+ * reference in src/tests/flip_and_zoom.c. */
+void dt_iop_flip_and_zoom_8_generic(const uint8_t *in, int32_t iw, int32_t ih, uint8_t *out, int32_t ow,
+                                    int32_t oh, const dt_image_orientation_t orientation, uint32_t *width,
+                                    uint32_t *height);
+
 /** for homebrew pixel pipe: zoom pixel array. */
 void dt_iop_clip_and_zoom(float *out, const float *const in, const struct dt_iop_roi_t *const roi_out,
                           const struct dt_iop_roi_t *const roi_in, const int32_t out_stride,
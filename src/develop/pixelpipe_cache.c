@@ -17,6 +17,7 @@
 */
 
 #include "develop/pixelpipe_cache.h"
+#include "common/half.h"
 #include "develop/format.h"
 #include "develop/pixelpipe_hb.h"
 #include "libs/lib.h"
@@ -43,6 +44,9 @@ int dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_cache_t *cache, int entries, si
 #endif
   cache->hash = (uint64_t *)calloc(entries, sizeof(uint64_t));
   cache->used = (int32_t *)calloc(entries, sizeof(int32_t));
+  cache->half = 0;
+  cache->packed = (uint16_t **)calloc(entries, sizeof(uint16_t *));
+  cache->packed_size = (size_t *)calloc(entries, sizeof(size_t));
   for(int k = 0; k < entries; k++)
   {
     cache->size[k] = size;
@@ -69,8 +73,14 @@ alloc_memory_fail:
 
 void dt_dev_pixelpipe_cache_cleanup(dt_dev_pixelpipe_cache_t *cache)
 {
-  for(int k = 0; k < cache->entries; k++) dt_free_align(cache->data[k]);
+  for(int k = 0; k < cache->entries; k++)
+  {
+    dt_free_align(cache->data[k]);
+    dt_free_align(cache->packed[k]);
+  }
   free(cache->data);
+  free(cache->packed);
+  free(cache->packed_size);
   free(cache->dsc);
   free(cache->hash);
   free(cache->used);
@@ -132,6 +142,38 @@ int dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_cache_t *cache, const uint64_t h
   return dt_dev_pixelpipe_cache_get_weighted(cache, hash, size, data, dsc, 0);
 }
 
+// values converted by one thread at a time
+#define DT_CACHE_HALF_BLOCK ((size_t)4096)
+
+static void _cache_drop_packed(dt_dev_pixelpipe_cache_t *cache, const int k)
+{
+  dt_free_align(cache->packed[k]);
+  cache->packed[k] = NULL;
+  cache->packed_size[k] = 0;
+}
+
+// turns a line stored as half floats into a float buffer again, returns 0 if that failed
+static int _cache_unpack(dt_dev_pixelpipe_cache_t *cache, const int k)
+{
+  const size_t values = cache->packed_size[k] / sizeof(uint16_t);
+  float *const data = (float *)dt_alloc_align(64, values * sizeof(float));
+  if(data)
+  {
+    const uint16_t *const packed = cache->packed[k];
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(values, data, packed) \
+    schedule(static)
+#endif
+    for(size_t i = 0; i < values; i += DT_CACHE_HALF_BLOCK)
+      dt_half_to_float_buf(data + i, packed + i, MIN(values - i, DT_CACHE_HALF_BLOCK));
+    cache->data[k] = data;
+    cache->size[k] = values * sizeof(float);
+  }
+  _cache_drop_packed(cache, k);
+  return data != NULL;
+}
+
 int dt_dev_pixelpipe_cache_get_weighted(dt_dev_pixelpipe_cache_t *cache, const uint64_t hash, const size_t size,
                                         void **data, dt_iop_buffer_dsc_t **dsc, int weight)
 {
@@ -148,6 +190,7 @@ int dt_dev_pixelpipe_cache_get_weighted(dt_dev_pixelpipe_cache_t *cache, const u
       max = k;
     }
     cache->used[k]++; // age all entries
+    if(cache->hash[k] == hash && cache->packed[k] && !_cache_unpack(cache, k)) cache->hash[k] = -1;
     if(cache->hash[k] == hash)
     {
       *data = cache->data[k];
@@ -165,6 +208,7 @@ int dt_dev_pixelpipe_cache_get_weighted(dt_dev_pixelpipe_cache_t *cache, const u
     // kill LRU entry
     // printf("[pixelpipe_cache_get] hash not found, returning slot %d/%d age %d\n", max, cache->entries,
     // weight);
+    _cache_drop_packed(cache, max);
     if(cache->size[max] < size)
     {
       dt_free_align(cache->data[max]);
@@ -196,6 +240,7 @@ void dt_dev_pixelpipe_cache_flush(dt_dev_pixelpipe_cache_t *cache)
   {
     cache->hash[k] = -1;
     cache->used[k] = 0;
+    _cache_drop_packed(cache, k);
     ASAN_POISON_MEMORY_REGION(cache->data[k], cache->size[k]);
   }
 }
@@ -223,12 +268,54 @@ void dt_dev_pixelpipe_cache_invalidate(dt_dev_pixelpipe_cache_t *cache, void *da
   }
 }
 
+void dt_dev_pixelpipe_cache_pack(dt_dev_pixelpipe_cache_t *cache, void *data, const size_t pixels)
+{
+  if(!cache->half || !data) return;
+
+  int line = -1, max_used = -1, max = 0;
+  for(int k = 0; k < cache->entries; k++)
+  {
+    if(cache->used[k] > max_used)
+    {
+      max_used = cache->used[k];
+      max = k;
+    }
+    if(cache->data[k] == data) line = k;
+  }
+  // the least recently used line is handed out again by the next miss, packing it would be wasted effort
+  if(line < 0 || line == max || cache->hash[line] == (uint64_t)-1) return;
+  if(cache->dsc[line].datatype != TYPE_FLOAT) return;
+
+  const size_t values = pixels * cache->dsc[line].channels;
+  if(values * sizeof(float) > cache->size[line]) return;
+  uint16_t *const packed = (uint16_t *)dt_alloc_align(64, values * sizeof(uint16_t));
+  if(!packed) return;
+
+  const float *const in = (const float *)data;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(values, packed, in) \
+  schedule(static)
+#endif
+  for(size_t i = 0; i < values; i += DT_CACHE_HALF_BLOCK)
+    dt_float_to_half_buf(packed + i, in + i, MIN(values - i, DT_CACHE_HALF_BLOCK));
+
+  dt_free_align(cache->data[line]);
+  cache->data[line] = NULL;
+  cache->size[line] = 0;
+  cache->packed[line] = packed;
+  cache->packed_size[line] = values * sizeof(uint16_t);
+}
+
+#undef DT_CACHE_HALF_BLOCK
+
 void dt_dev_pixelpipe_cache_print(dt_dev_pixelpipe_cache_t *cache)
 {
   for(int k = 0; k < cache->entries; k++)
   {
     printf("pixelpipe cacheline %d ", k);
     printf("used %d by %" PRIu64 "", cache->used[k], cache->hash[k]);
+    if(cache->packed[k]) printf(" (half float)");
     printf("\n");
   }
   printf("cache hit rate so far: %.3f\n", (cache->queries - cache->misses) / (float)cache->queries);
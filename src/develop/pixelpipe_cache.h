@@ -38,6 +38,10 @@ typedef struct dt_dev_pixelpipe_cache_t
   struct dt_iop_buffer_dsc_t *dsc;
   uint64_t *hash;
   int32_t *used;
+  // lines which are not in use can be kept as half floats, packed[k] then replaces data[k]
+  int half;
+  uint16_t **packed;
+  size_t *packed_size;
 #ifdef HAVE_OPENCL
   void **gpu_mem;
 #endif
@@ -78,6 +82,10 @@ void dt_dev_pixelpipe_cache_reweight(dt_dev_pixelpipe_cache_t *cache, void *data
 /** mark the given cache line pointer as invalid. */
 void dt_dev_pixelpipe_cache_invalidate(dt_dev_pixelpipe_cache_t *cache, void *data);
 
+/** stores the float cache line behind data as half floats and releases the float buffer, if half is enabled.
+  * pixels is the number of pixels in the buffer. the line is expanded again once it is requested. */
+void dt_dev_pixelpipe_cache_pack(dt_dev_pixelpipe_cache_t *cache, void *data, const size_t pixels);
+
 /** print out cache lines/hashes (debug). */
 void dt_dev_pixelpipe_cache_print(dt_dev_pixelpipe_cache_t *cache);
 
@@ -0,0 +1,323 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "develop/pixelpipe_diskcache.h"
+#include "common/darktable.h"
+#include "common/database.h"
+#include "common/file_location.h"
+#include "common/half.h"
+#include "control/conf.h"
+#include "develop/imageop.h"
+#include "develop/pixelpipe.h"
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DT_DISKCACHE_MAGIC "dtpc"
+#define DT_DISKCACHE_VERSION 2
+// values converted per pass, bounds the temporary buffer
+#define DT_DISKCACHE_CHUNK ((size_t)1 << 20)
+// values converted by one thread at a time
+#define DT_DISKCACHE_BLOCK ((size_t)4096)
+
+typedef struct dt_dev_pixelpipe_diskcache_header_t
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t hash;
+  int32_t imgid, width, height;
+  uint32_t dsc_size;
+  dt_iop_buffer_dsc_t dsc; // the work profile is a pointer and not stored
+} dt_dev_pixelpipe_diskcache_header_t;
+
+typedef struct dt_dev_pixelpipe_diskcache_entry_t
+{
+  gchar *filename;
+  gint64 size;
+  gint64 used;
+} dt_dev_pixelpipe_diskcache_entry_t;
+
+// size of all entries as far as we know, -1 until the directory has been looked at
+static GMutex _diskcache_lock;
+static gint64 _diskcache_total = -1;
+
+// one cache directory per library, next to the mipmaps
+static gchar *_diskcache_dir()
+{
+  const gchar *dbfilename = dt_database_get_path(darktable.db);
+  if(!dbfilename || !strcmp(dbfilename, ":memory:")) return NULL;
+
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  gchar *checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA1, dbfilename, -1);
+  gchar *dir = g_strdup_printf("%s/pixelpipe-%s", cachedir, checksum);
+  g_free(checksum);
+  return dir;
+}
+
+// the pipe hash covers the parameters, not the code which processed them. an upgrade which changes the output
+// of a module mustn't find the entries written before.
+static uint64_t _diskcache_key(const uint64_t hash, const dt_iop_module_t *module)
+{
+  uint64_t key = hash;
+  const int version = module->version();
+  const char *str = (const char *)&version;
+  for(size_t i = 0; i < sizeof(version); i++) key = ((key << 5) + key) ^ str[i];
+  for(const char *c = darktable_package_version; *c; c++) key = ((key << 5) + key) ^ *c;
+  return key;
+}
+
+static gchar *_diskcache_filename(const gchar *dir, const uint64_t hash, const int imgid)
+{
+  return g_strdup_printf("%s/%d-%016" PRIx64 ".dtpc", dir, imgid, hash);
+}
+
+static size_t _diskcache_values(const dt_iop_buffer_dsc_t *dsc, const struct dt_iop_roi_t *roi)
+{
+  return (size_t)dsc->channels * roi->width * roi->height;
+}
+
+gboolean dt_dev_pixelpipe_diskcache_wanted(const dt_dev_pixelpipe_t *pipe, const dt_iop_module_t *module)
+{
+  if(!module || pipe->type != DT_DEV_PIXELPIPE_EXPORT) return FALSE;
+
+  gchar *op = dt_conf_get_string("plugins/pixelpipe/disk_cache/module");
+  const gboolean wanted = op && !strcmp(op, module->op);
+  g_free(op);
+  return wanted;
+}
+
+int dt_dev_pixelpipe_diskcache_read(const uint64_t pipe_hash, const dt_iop_module_t *module, const int imgid,
+                                    const dt_iop_roi_t *roi, void *buf, dt_iop_buffer_dsc_t *dsc)
+{
+  gchar *dir = _diskcache_dir();
+  if(!dir) return 1;
+  const uint64_t hash = _diskcache_key(pipe_hash, module);
+  gchar *filename = _diskcache_filename(dir, hash, imgid);
+  g_free(dir);
+
+  int res = 1;
+  uint16_t *tmp = NULL;
+  FILE *f = g_fopen(filename, "rb");
+  if(!f) goto end;
+
+  dt_dev_pixelpipe_diskcache_header_t header;
+  if(fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, DT_DISKCACHE_MAGIC, 4)
+     || header.version != DT_DISKCACHE_VERSION || header.hash != hash || header.imgid != imgid
+     || header.width != roi->width || header.height != roi->height
+     || header.dsc_size != sizeof(dt_iop_buffer_dsc_t))
+    goto end;
+
+  const size_t values = _diskcache_values(&header.dsc, roi);
+  if(header.dsc.datatype == TYPE_UINT16)
+  {
+    if(fread(buf, sizeof(uint16_t), values, f) != values) goto end;
+  }
+  else if(header.dsc.datatype == TYPE_FLOAT)
+  {
+    tmp = dt_alloc_align(64, sizeof(uint16_t) * MIN(values, DT_DISKCACHE_CHUNK));
+    if(!tmp) goto end;
+    for(size_t start = 0; start < values; start += DT_DISKCACHE_CHUNK)
+    {
+      const size_t count = MIN(values - start, DT_DISKCACHE_CHUNK);
+      if(fread(tmp, sizeof(uint16_t), count, f) != count) goto end;
+      float *const out = (float *)buf + start;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+      dt_omp_firstprivate(count, out, tmp) \
+      schedule(static)
+#endif
+      for(size_t k = 0; k < count; k += DT_DISKCACHE_BLOCK)
+        dt_half_to_float_buf(out + k, tmp + k, MIN(count - k, DT_DISKCACHE_BLOCK));
+    }
+  }
+  else
+    goto end;
+
+  struct dt_iop_order_iccprofile_info_t *const work_profile_info = dsc->work_profile_info;
+  *dsc = header.dsc;
+  dsc->work_profile_info = work_profile_info;
+  res = 0;
+
+  // mark as recently used
+  g_utime(filename, NULL);
+
+end:
+  if(f) fclose(f);
+  dt_free_align(tmp);
+  g_free(filename);
+  return res;
+}
+
+static gint _diskcache_sort_used(gconstpointer a, gconstpointer b)
+{
+  const dt_dev_pixelpipe_diskcache_entry_t *ea = (const dt_dev_pixelpipe_diskcache_entry_t *)a;
+  const dt_dev_pixelpipe_diskcache_entry_t *eb = (const dt_dev_pixelpipe_diskcache_entry_t *)b;
+  return (ea->used > eb->used) - (ea->used < eb->used);
+}
+
+// looks at all entries and drops the least recently used ones until the rest fits into max_size. returns
+// the size of what is left.
+static gint64 _diskcache_evict(const gchar *dir, const gint64 max_size)
+{
+  GDir *d = g_dir_open(dir, 0, NULL);
+  if(!d) return 0;
+
+  GArray *entries = g_array_new(FALSE, FALSE, sizeof(dt_dev_pixelpipe_diskcache_entry_t));
+  gint64 total = 0;
+  const gchar *name;
+  while((name = g_dir_read_name(d)))
+  {
+    if(!g_str_has_suffix(name, ".dtpc")) continue;
+    dt_dev_pixelpipe_diskcache_entry_t entry = { g_build_filename(dir, name, NULL), 0, 0 };
+    GStatBuf statbuf;
+    if(g_stat(entry.filename, &statbuf))
+    {
+      g_free(entry.filename);
+      continue;
+    }
+    entry.size = statbuf.st_size;
+    entry.used = statbuf.st_mtime;
+    total += entry.size;
+    g_array_append_val(entries, entry);
+  }
+  g_dir_close(d);
+
+  if(total > max_size)
+  {
+    g_array_sort(entries, _diskcache_sort_used);
+    for(guint k = 0; k < entries->len && total > max_size; k++)
+    {
+      const dt_dev_pixelpipe_diskcache_entry_t *entry
+          = &g_array_index(entries, dt_dev_pixelpipe_diskcache_entry_t, k);
+      if(!g_unlink(entry->filename)) total -= entry->size;
+    }
+  }
+
+  for(guint k = 0; k < entries->len; k++)
+    g_free(g_array_index(entries, dt_dev_pixelpipe_diskcache_entry_t, k).filename);
+  g_array_free(entries, TRUE);
+  return total;
+}
+
+// accounts for an entry of size which replaced one of old_size and only looks at the directory when the
+// cache got too big. it is then cut down to 90%, so that this doesn't happen on every write.
+static void _diskcache_added(const gchar *dir, const gint64 size, const gint64 old_size)
+{
+  const gint64 max_size = (gint64)dt_conf_get_int("plugins/pixelpipe/disk_cache/size") << 20;
+  g_mutex_lock(&_diskcache_lock);
+  if(_diskcache_total < 0)
+    _diskcache_total = _diskcache_evict(dir, max_size);
+  else
+    _diskcache_total += size - old_size;
+  if(_diskcache_total > max_size) _diskcache_total = _diskcache_evict(dir, max_size / 10 * 9);
+  g_mutex_unlock(&_diskcache_lock);
+}
+
+void dt_dev_pixelpipe_diskcache_write(const uint64_t pipe_hash, const dt_iop_module_t *module, const int imgid,
+                                      const dt_iop_roi_t *roi, const void *buf, const dt_iop_buffer_dsc_t *dsc)
+{
+  if(dsc->datatype != TYPE_FLOAT && dsc->datatype != TYPE_UINT16) return;
+  const uint64_t hash = _diskcache_key(pipe_hash, module);
+
+  gchar *dir = _diskcache_dir();
+  if(!dir) return;
+  if(g_mkdir_with_parents(dir, 0750))
+  {
+    g_free(dir);
+    return;
+  }
+  gchar *filename = _diskcache_filename(dir, hash, imgid);
+
+  // write to a temporary file first, other exports might be reading the entry right now
+  gchar *tmpname = g_strdup_printf("%s.XXXXXX", filename);
+  const int fd = g_mkstemp(tmpname);
+  FILE *f = fd == -1 ? NULL : fdopen(fd, "wb");
+  uint16_t *tmp = NULL;
+  int res = 1;
+  if(!f)
+  {
+    if(fd != -1) close(fd);
+    goto end;
+  }
+
+  dt_dev_pixelpipe_diskcache_header_t header = { { 0 } };
+  memcpy(header.magic, DT_DISKCACHE_MAGIC, 4);
+  header.version = DT_DISKCACHE_VERSION;
+  header.hash = hash;
+  header.imgid = imgid;
+  header.width = roi->width;
+  header.height = roi->height;
+  header.dsc_size = sizeof(dt_iop_buffer_dsc_t);
+  header.dsc = *dsc;
+  header.dsc.work_profile_info = NULL;
+  if(fwrite(&header, sizeof(header), 1, f) != 1) goto end;
+
+  const size_t values = _diskcache_values(dsc, roi);
+  if(dsc->datatype == TYPE_UINT16)
+  {
+    if(fwrite(buf, sizeof(uint16_t), values, f) != values) goto end;
+  }
+  else
+  {
+    tmp = dt_alloc_align(64, sizeof(uint16_t) * MIN(values, DT_DISKCACHE_CHUNK));
+    if(!tmp) goto end;
+    for(size_t start = 0; start < values; start += DT_DISKCACHE_CHUNK)
+    {
+      const size_t count = MIN(values - start, DT_DISKCACHE_CHUNK);
+      const float *const in = (const float *)buf + start;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+      dt_omp_firstprivate(count, in, tmp) \
+      schedule(static)
+#endif
+      for(size_t k = 0; k < count; k += DT_DISKCACHE_BLOCK)
+        dt_float_to_half_buf(tmp + k, in + k, MIN(count - k, DT_DISKCACHE_BLOCK));
+      if(fwrite(tmp, sizeof(uint16_t), count, f) != count) goto end;
+    }
+  }
+  res = 0;
+
+end:
+  if(f && fclose(f)) res = 1;
+  if(fd != -1)
+  {
+    GStatBuf statbuf;
+    const gint64 old_size = g_stat(filename, &statbuf) ? 0 : statbuf.st_size;
+    const gint64 size = g_stat(tmpname, &statbuf) ? 0 : statbuf.st_size;
+    if(!res && !g_rename(tmpname, filename))
+      _diskcache_added(dir, size, old_size);
+    else
+      g_unlink(tmpname);
+  }
+  dt_free_align(tmp);
+  g_free(tmpname);
+  g_free(filename);
+  g_free(dir);
+}
+
+#undef DT_DISKCACHE_MAGIC
+#undef DT_DISKCACHE_VERSION
+#undef DT_DISKCACHE_CHUNK
+#undef DT_DISKCACHE_BLOCK
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,53 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "develop/format.h"
+#include <glib.h>
+#include <inttypes.h>
+
+struct dt_dev_pixelpipe_t;
+struct dt_iop_module_t;
+struct dt_iop_roi_t;
+
+/**
+ * keeps the output of one module of export pipes on disk, so that exporting an image again (at another size,
+ * with another output profile or watermark, ..) starts from there instead of the raw. the module is set by
+ * plugins/pixelpipe/disk_cache/module, which is empty by default. entries are keyed by the pixelpipe cache hash,
+ * the version of the module and the darktable version. float buffers are stored as half floats. the least
+ * recently used entries are dropped as soon as all of them exceed plugins/pixelpipe/disk_cache/size megabytes.
+ */
+
+/** whether the output of module goes through the disk cache in this pipe. */
+gboolean dt_dev_pixelpipe_diskcache_wanted(const struct dt_dev_pixelpipe_t *pipe,
+                                           const struct dt_iop_module_t *module);
+
+/** fills buf and dsc from the entry stored for the output of module, returns 0 on a hit. the work profile in
+ * dsc is kept. */
+int dt_dev_pixelpipe_diskcache_read(const uint64_t hash, const struct dt_iop_module_t *module, const int imgid,
+                                    const struct dt_iop_roi_t *roi, void *buf, dt_iop_buffer_dsc_t *dsc);
+
+/** stores buf as the entry for the output of module and evicts old entries if needed. */
+void dt_dev_pixelpipe_diskcache_write(const uint64_t hash, const struct dt_iop_module_t *module, const int imgid,
+                                      const struct dt_iop_roi_t *roi, const void *buf,
+                                      const dt_iop_buffer_dsc_t *dsc);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -19,6 +19,7 @@
 */
 #include "common/color_picker.h"
 #include "common/colorspaces.h"
+#include "common/export_report.h"
 #include "common/histogram.h"
 #include "common/imageio.h"
 #include "common/opencl.h"
@@ -64,6 +65,8 @@ typedef enum dt_pixelpipe_picker_source_t
 } dt_pixelpipe_picker_source_t;
 
 #include "develop/pixelpipe_cache.c"
+#include "develop/pixelpipe_tiles.c"
+#include "develop/pixelpipe_diskcache.c"
 
 static void get_output_format(dt_iop_module_t *module, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece,
                               dt_develop_t *dev, dt_iop_buffer_dsc_t *dsc);
@@ -154,6 +157,7 @@ int dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe, size_t size, int32_t
   pipe->nodes = NULL;
   pipe->backbuf_size = size;
   if(!dt_dev_pixelpipe_cache_init(&(pipe->cache), entries, pipe->backbuf_size)) return 0;
+  dt_dev_pixelpipe_tiles_init(&(pipe->tiles), DT_DEV_PIXELPIPE_TILES_MAX_SIZE);
   pipe->cache_obsolete = 0;
   pipe->backbuf = NULL;
   pipe->backbuf_scale = 0.f;
@@ -182,6 +186,7 @@ int dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe, size_t size, int32_t
   pipe->iop_order_list = NULL;
   pipe->forms = NULL;
   pipe->store_all_raster_masks = FALSE;
+  pipe->report = NULL;
 
   return 1;
 }
@@ -214,6 +219,7 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
   dt_dev_pixelpipe_cleanup_nodes(pipe);
   // so now it's safe to clean up cache:
   dt_dev_pixelpipe_cache_cleanup(&(pipe->cache));
+  dt_dev_pixelpipe_tiles_cleanup(&(pipe->tiles));
   dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
   dt_pthread_mutex_destroy(&(pipe->backbuf_mutex));
   dt_pthread_mutex_destroy(&(pipe->busy_mutex));
@@ -388,6 +394,7 @@ void dt_dev_pixelpipe_change(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev)
   }
   pipe->changed = DT_DEV_PIPE_UNCHANGED;
   dt_pthread_mutex_unlock(&dev->history_mutex);
+  dt_dev_hash_notify(dev);
   dt_dev_pixelpipe_get_dimensions(pipe, dev, pipe->iwidth, pipe->iheight, &pipe->processed_width,
                                   &pipe->processed_height);
 }
@@ -1006,69 +1013,74 @@ static void _pixelpipe_final_histogram_waveform(dt_develop_t *dev, const float *
   const int bin_width = ceilf((float)(roi_in->width) / (float)(dev->histogram_waveform_stride/4));
   dev->histogram_waveform_width = roi_in->width / bin_width;
 
-  // FIXME: better to pre-allocate this in dev?
-  uint32_t *buf = (uint32_t *)calloc(dev->histogram_waveform_height * dev->histogram_waveform_width * 3,
-                                     sizeof(uint32_t));
-  memset(dev->histogram_waveform, 0,
-         sizeof(uint8_t) * dev->histogram_waveform_height * dev->histogram_waveform_stride);
+  const int waveform_width = dev->histogram_waveform_width;
+  const int waveform_height = dev->histogram_waveform_height;
+  const int waveform_stride = dev->histogram_waveform_stride;
+  const int width = roi_in->width;
+  const int height = roi_in->height;
+
+  // the bins are allocated in dev for the widest waveform possible
+  uint32_t *const buf = dev->histogram_waveform_bins;
+  memset(buf, 0, sizeof(uint32_t) * waveform_height * waveform_width * 3);
+  memset(dev->histogram_waveform, 0, sizeof(uint8_t) * waveform_height * waveform_stride);
 
   // 1.0 is at 8/9 of the height!
-  const double _height = (double)(dev->histogram_waveform_height - 1);
-  //         uint32_t mincol[3] = {UINT32_MAX,UINT32_MAX,UINT32_MAX}, maxcol[3] = {0,0,0};
+  const float _height = (float)(waveform_height - 1);
 
-  // count the colors into buf ...
-  for(int y = 0; y < roi_in->height; y++)
+  // count the colors into buf. every thread gets its own columns of bins, each fed by bin_width columns of
+  // the input, so nothing is shared and no reduction is needed.
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(input, buf, bin_width, waveform_width, width, height, _height) \
+  schedule(static)
+#endif
+  for(int out_x = 0; out_x < waveform_width; out_x++)
   {
-    for(int x = 0; x < roi_in->width; x++)
+    for(int y = 0; y < height; y++)
     {
-      const int out_x = x / bin_width;
-      for(int k = 0; k < 3; k++)
+      const float *const in = input + 4 * ((size_t)y * width + (size_t)out_x * bin_width);
+      for(int x = 0; x < bin_width; x++)
       {
-        const float c = input[4 * y * roi_in->width + 4 * x + 2 - k];
-        // catch NaNs as they don't convert well to integers
-        const float v = isnan(c) ? 0.0f : c;
-        const int out_y = CLAMP(1.0 - (8.0 / 9.0) * v, 0.0, 1.0) * _height;
-        uint32_t *const out = buf + (out_y * dev->histogram_waveform_width + out_x) * 3 + k;
-        (*out)++;
-        //               mincol[k] = MIN(mincol[k], *out);
-        //               maxcol[k] = MAX(maxcol[k], *out);
+        for(int k = 0; k < 3; k++)
+        {
+          const float c = in[4 * x + 2 - k];
+          // catch NaNs as they don't convert well to integers
+          const float v = isnan(c) ? 0.0f : c;
+          const int out_y = CLAMP(1.0f - (8.0f / 9.0f) * v, 0.0f, 1.0f) * _height;
+          buf[((size_t)out_y * waveform_width + out_x) * 3 + k]++;
+        }
       }
     }
   }
 
-  // TODO: Find a nicer function to map buf -> image than just clipping
-  //         float factor[3];
-  //         for(int k = 0; k < 3; k++)
-  //           factor[k] = 255.0 / (float)(maxcol[k] - mincol[k]); // leave some clipping
-
   // ... and scale that into a nice image. putting the pixels into the image directly gets too
   // saturated/clips.
   // new scale factor to do about the same as the old one for 1MP views, but scale to hidpi
   // FIXME: can simplify if roi_in->width == dev->histogram_waveform_width
-  const float scale = 0.5 * 1e6f/(roi_in->height*roi_in->width) *
-    (dev->histogram_waveform_width*dev->histogram_waveform_height) / (350.0f*233.)
+  const float scale = 0.5 * 1e6f/(height*width) *
+    (waveform_width*waveform_height) / (350.0f*233.)
     / 255.0f; // normalization to 0..1 for gamma correction
   const float gamma = 1.0 / 1.5; // TODO make this settable from the gui?
-  for(int y = 0; y < dev->histogram_waveform_height; y++)
+  uint8_t *const waveform = dev->histogram_waveform;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(buf, waveform, waveform_width, waveform_height, waveform_stride, scale, gamma) \
+  schedule(static)
+#endif
+  for(int y = 0; y < waveform_height; y++)
   {
-    for(int x = 0; x < dev->histogram_waveform_width; x++)
+    for(int x = 0; x < waveform_width; x++)
     {
-      uint32_t *const in = buf + (y * dev->histogram_waveform_width + x) * 3;
-      uint8_t *const out = dev->histogram_waveform + (y * dev->histogram_waveform_stride) + (x * 4);
+      const uint32_t *const in = buf + ((size_t)y * waveform_width + x) * 3;
+      uint8_t *const out = waveform + ((size_t)y * waveform_stride) + (x * 4);
       for(int k = 0; k < 3; k++)
       {
         if(in[k] == 0) continue;
         out[k] = CLAMP(powf(in[k] * scale, gamma) * 255.0, 0, 255);
-        //               if(in[k] == 0)
-        //                 out[k] = 0;
-        //               else
-        //                 out[k] = (float)(in[k] - mincol[k]) * factor[k];
       }
     }
   }
 
-  free(buf);
-
   if(darktable.unmuted & DT_DEBUG_PERF)
   {
     dt_times_t end_time = { 0 };
@@ -1094,6 +1106,214 @@ static int _transform_for_blend(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *p
   return ret;
 }
 
+// number of pixels a fused run of pointwise modules processes at once. 4096 pixels of 4 floats are 64k,
+// which stays in the core-private caches while every module of the run works on it.
+#define DT_PIXELPIPE_FUSED_BLOCK 4096
+
+static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, void **output,
+                                        void **cl_mem_output, dt_iop_buffer_dsc_t **out_format,
+                                        const dt_iop_roi_t *roi_out, GList *modules, GList *pieces, int pos);
+
+static inline gboolean _piece_is_skipped(const dt_develop_t *dev, dt_iop_module_t *module,
+                                         const dt_dev_pixelpipe_iop_t *piece)
+{
+  return !piece->enabled
+         || (dev->gui_module && dev->gui_module->operation_tags_filter() & module->operation_tags());
+}
+
+static gboolean _pixelpipe_fusion_allowed(const dt_dev_pixelpipe_t *pipe)
+{
+  // the darkroom pipes keep one cache line per module so that changing a module only reprocesses what
+  // comes after it. fusing would lose these intermediate buffers, so only one-shot pipes are fused.
+  if(!(pipe->type & (DT_DEV_PIXELPIPE_EXPORT | DT_DEV_PIXELPIPE_THUMBNAIL))) return FALSE;
+  if(pipe->mask_display != DT_DEV_PIXELPIPE_DISPLAY_NONE) return FALSE;
+#ifdef HAVE_OPENCL
+  if(dt_opencl_is_inited() && pipe->opencl_enabled && pipe->devid >= 0) return FALSE;
+#endif
+  return dt_conf_get_bool("pixelpipe_fuse_pointwise");
+}
+
+static gboolean _piece_is_fusible(dt_dev_pixelpipe_t *pipe, const dt_develop_t *dev, dt_iop_module_t *module,
+                                  dt_dev_pixelpipe_iop_t *piece)
+{
+  if(!(module->flags() & IOP_FLAGS_FUSIBLE) || !module->process_pixels) return FALSE;
+  if(piece->colors != 4) return FALSE;
+
+  // blending, histograms and color pickers need the module's own input and output buffers
+  const dt_develop_blend_params_t *const d = (const dt_develop_blend_params_t *const)piece->blendop_data;
+  if(d && d->mask_mode != DEVELOP_MASK_DISABLED) return FALSE;
+  if(piece->request_histogram & DT_REQUEST_ON) return FALSE;
+  if(dev->gui_attached && module == dev->gui_module && module->request_color_pick != DT_REQUEST_COLORPICK_OFF)
+    return FALSE;
+
+  return module->input_colorspace(module, pipe, piece) == module->output_colorspace(module, pipe, piece);
+}
+
+// process a run of adjacent IOP_FLAGS_FUSIBLE modules ending with the one at `modules' in a single pass over
+// the buffers, block by block. returns -1 if there is no such run and the module has to be processed on its
+// own, otherwise the same as dt_dev_pixelpipe_process_rec().
+static int _pixelpipe_process_fused(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, void **output,
+                                    dt_iop_buffer_dsc_t **out_format, const dt_iop_roi_t *roi_out,
+                                    GList *modules, GList *pieces, int pos, const uint64_t hash,
+                                    const size_t bufsize)
+{
+  if(!_pixelpipe_fusion_allowed(pipe)) return -1;
+
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  if(pipe->shutdown)
+  {
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+    return 1;
+  }
+
+  // walk backwards and collect the run. skipped pieces are stepped over, just like the recursion does.
+  GList *run_modules = NULL;
+  GList *run_pieces = NULL;
+  int run_length = 0;
+  dt_iop_colorspace_type_t cst = iop_cs_NONE;
+  GList *rest_modules = modules;
+  GList *rest_pieces = pieces;
+  int rest_pos = pos;
+  while(rest_modules)
+  {
+    dt_iop_module_t *module = (dt_iop_module_t *)rest_modules->data;
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)rest_pieces->data;
+    if(!_piece_is_skipped(dev, module, piece))
+    {
+      if(!_piece_is_fusible(pipe, dev, module, piece)) break;
+      // the output of a module kept on disk has to exist on its own, so it ends an earlier run
+      if(run_length && dt_dev_pixelpipe_diskcache_wanted(pipe, module)) break;
+      const dt_iop_colorspace_type_t module_cst = module->input_colorspace(module, pipe, piece);
+      if(cst != iop_cs_NONE && module_cst != cst) break;
+
+      // a pointwise module has to leave the region of interest alone
+      dt_iop_roi_t roi_in = *roi_out;
+      module->modify_roi_in(module, piece, roi_out, &roi_in);
+      if(memcmp(&roi_in, roi_out, sizeof(dt_iop_roi_t))) break;
+
+      cst = module_cst;
+      run_modules = g_list_prepend(run_modules, module);
+      run_pieces = g_list_prepend(run_pieces, piece);
+      run_length++;
+    }
+    rest_modules = g_list_previous(rest_modules);
+    rest_pieces = g_list_previous(rest_pieces);
+    rest_pos--;
+  }
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+
+  if(run_length < 2)
+  {
+    g_list_free(run_modules);
+    g_list_free(run_pieces);
+    return -1;
+  }
+
+  for(GList *p = run_pieces; p; p = g_list_next(p))
+  {
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)p->data;
+    piece->processed_roi_in = *roi_out;
+    piece->processed_roi_out = *roi_out;
+  }
+
+  // recurse to get the input of the first module of the run. all fusible modules work on 4 channel float
+  // buffers, so this is what we get here.
+  void *input = NULL;
+  void *cl_mem_input = NULL;
+  dt_iop_buffer_dsc_t _input_format = { 0 };
+  dt_iop_buffer_dsc_t *input_format = &_input_format;
+  if(dt_dev_pixelpipe_process_rec(pipe, dev, &input, &cl_mem_input, &input_format, roi_out, rest_modules,
+                                  rest_pieces, rest_pos))
+  {
+    g_list_free(run_modules);
+    g_list_free(run_pieces);
+    return 1;
+  }
+
+  dt_iop_module_t *first = (dt_iop_module_t *)run_modules->data;
+  dt_ioppr_transform_image_colorspace(first, input, input, roi_out->width, roi_out->height, input_format->cst,
+                                      cst, &input_format->cst, dt_ioppr_get_pipe_work_profile_info(pipe));
+
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  if(pipe->shutdown)
+  {
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+    g_list_free(run_modules);
+    g_list_free(run_pieces);
+    return 1;
+  }
+
+  (void)dt_dev_pixelpipe_cache_get(&(pipe->cache), hash, bufsize, output, out_format);
+
+  dt_times_t start;
+  dt_get_times(&start);
+
+  // let all modules of the run set up their per piece state, in pipe order, as process() would have done
+  dt_iop_module_t **fused_modules = malloc(sizeof(dt_iop_module_t *) * run_length);
+  dt_dev_pixelpipe_iop_t **fused_pieces = malloc(sizeof(dt_dev_pixelpipe_iop_t *) * run_length);
+  GString *labels = g_string_new(NULL);
+  GString *ops = g_string_new(NULL);
+  dt_iop_buffer_dsc_t dsc = *input_format;
+  int k = 0;
+  for(GList *m = run_modules, *p = run_pieces; m && p; m = g_list_next(m), p = g_list_next(p), k++)
+  {
+    dt_iop_module_t *module = (dt_iop_module_t *)m->data;
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)p->data;
+
+    piece->dsc_out = piece->dsc_in = dsc;
+    module->output_format(module, pipe, piece, &piece->dsc_out);
+    pipe->dsc = piece->dsc_out;
+    if(module->process_pixels_prepare) module->process_pixels_prepare(module, piece);
+    pipe->dsc.cst = module->output_colorspace(module, pipe, piece);
+    dsc = piece->dsc_out = pipe->dsc;
+
+    fused_modules[k] = module;
+    fused_pieces[k] = piece;
+
+    gchar *module_label = dt_history_item_get_name(module);
+    g_string_append_printf(labels, "%s%s", k ? ", " : "", module_label);
+    g_string_append_printf(ops, "%s%s", k ? "+" : "", module->op);
+    g_free(module_label);
+  }
+  **out_format = dsc;
+
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
+  const size_t nblocks = (npixels + DT_PIXELPIPE_FUSED_BLOCK - 1) / DT_PIXELPIPE_FUSED_BLOCK;
+  const float *const in = (const float *const)input;
+  float *const out = (float *const)*output;
+  const int nfused = run_length;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(fused_modules, fused_pieces, in, nblocks, nfused, npixels, out) \
+  schedule(static)
+#endif
+  for(size_t b = 0; b < nblocks; b++)
+  {
+    const size_t offset = b * DT_PIXELPIPE_FUSED_BLOCK;
+    const size_t count = MIN((size_t)DT_PIXELPIPE_FUSED_BLOCK, npixels - offset);
+    fused_modules[0]->process_pixels(fused_modules[0], fused_pieces[0], in + 4 * offset, out + 4 * offset,
+                                     count);
+    for(int f = 1; f < nfused; f++)
+      fused_modules[f]->process_pixels(fused_modules[f], fused_pieces[f], out + 4 * offset, out + 4 * offset,
+                                       count);
+  }
+
+  dt_show_times_f(&start, "[dev_pixelpipe]", "processed fused `%s' on CPU [%s]", labels->str,
+                  _pipe_type_to_str(pipe->type));
+  dt_export_report_module(pipe->report, ops->str, "CPU", FALSE, dt_get_wtime() - start.clock);
+
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+
+  g_string_free(labels, TRUE);
+  g_string_free(ops, TRUE);
+  free(fused_modules);
+  free(fused_pieces);
+  g_list_free(run_modules);
+  g_list_free(run_pieces);
+  return 0;
+}
+
 // recursive helper for process:
 static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, void **output,
                                         void **cl_mem_output, dt_iop_buffer_dsc_t **out_format,
@@ -1153,6 +1373,36 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
   else
     dt_pthread_mutex_unlock(&pipe->busy_mutex);
 
+  // 1b) an earlier export might have left the output of this module on disk
+  const gboolean diskcache = hash && dt_dev_pixelpipe_diskcache_wanted(pipe, module);
+  if(diskcache)
+  {
+    dt_pthread_mutex_lock(&pipe->busy_mutex);
+    if(pipe->shutdown)
+    {
+      dt_pthread_mutex_unlock(&pipe->busy_mutex);
+      return 1;
+    }
+    (void)dt_dev_pixelpipe_cache_get(&(pipe->cache), hash, bufsize, output, out_format);
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+
+    dt_times_t start;
+    dt_get_times(&start);
+    if(*output && !dt_dev_pixelpipe_diskcache_read(hash, module, pipe->image.id, roi_out, *output, *out_format))
+    {
+      dt_show_times_f(&start, "[dev_pixelpipe]", "read output of `%s' from disk cache [%s]", module->op,
+                      _pipe_type_to_str(pipe->type));
+      // the modules up to here are skipped, leave the pipe as if they had run
+      pipe->dsc = piece->dsc_out = **out_format;
+      goto post_process_collect_info;
+    }
+
+    // don't leave a cache line around that claims to hold this module's output
+    dt_pthread_mutex_lock(&pipe->busy_mutex);
+    if(*output) dt_dev_pixelpipe_cache_invalidate(&(pipe->cache), *output);
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+  }
+
   // 2) if history changed or exit event, abort processing?
   // preview pipe: abort on all but zoom events (same buffer anyways)
   if(dt_iop_breakpoint(dev, pipe)) return 1;
@@ -1227,6 +1477,16 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
   {
     // 3b) recurse and obtain output array in &input
 
+    // runs of pointwise modules are processed in a single pass instead
+    const int fused = _pixelpipe_process_fused(pipe, dev, output, out_format, roi_out, modules, pieces, pos,
+                                               hash, bufsize);
+    if(fused >= 0)
+    {
+      if(!fused && diskcache)
+        dt_dev_pixelpipe_diskcache_write(hash, module, pipe->image.id, roi_out, *output, *out_format);
+      return fused;
+    }
+
     // get region of interest which is needed in input
     dt_pthread_mutex_lock(&pipe->busy_mutex);
     if(pipe->shutdown)
@@ -2383,10 +2643,27 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
     g_free(module_label);
     module_label = NULL;
 
+    dt_export_report_module(pipe->report, module->op,
+                            pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_ON_GPU ? "GPU" : "CPU",
+                            pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_WITH_TILING, dt_get_wtime() - start.clock);
+
     // in case we get this buffer from the cache in the future, cache some stuff:
     **out_format = piece->dsc_out = pipe->dsc;
 
     dt_pthread_mutex_unlock(&pipe->busy_mutex);
+
+    // the module might have published a hash other pipes are waiting for (see dt_dev_wait_hash())
+    dt_dev_hash_notify(dev);
+
+    if(diskcache)
+    {
+#ifdef HAVE_OPENCL
+      if(*cl_mem_output != NULL)
+        dt_opencl_copy_device_to_host(pipe->devid, *output, *cl_mem_output, roi_out->width, roi_out->height, bpp);
+#endif
+      dt_dev_pixelpipe_diskcache_write(hash, module, pipe->image.id, roi_out, *output, *out_format);
+    }
+
     if(module == darktable.develop->gui_module)
     {
       // give the input buffer to the currently focused plugin more weight.
@@ -2558,6 +2835,14 @@ post_process_collect_info:
     }
   }
 
+  // nothing downstream reads our input anymore, it only stays around for the next run
+  if(input && pipe->cache.half)
+  {
+    dt_pthread_mutex_lock(&pipe->busy_mutex);
+    dt_dev_pixelpipe_cache_pack(&(pipe->cache), input, (size_t)roi_in.width * roi_in.height);
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+  }
+
   return 0;
 }
 
@@ -2656,10 +2941,10 @@ static int dt_dev_pixelpipe_process_rec_and_backcopy(dt_dev_pixelpipe_t *pipe, d
 }
 
 
-int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x, int y, int width, int height,
-                             float scale)
+// runs the pipe for the given region and returns the final output buffer, without publishing it as backbuf.
+static int _dev_pixelpipe_process_roi(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, const dt_iop_roi_t *roi_out,
+                                      void **output)
 {
-  pipe->processing = 1;
   pipe->opencl_enabled = dt_opencl_update_settings(); // update enabled flag and profile from preferences
   pipe->devid = (pipe->opencl_enabled) ? dt_opencl_lock_device(pipe->type)
                                        : -1; // try to get/lock opencl resource
@@ -2675,7 +2960,7 @@ int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x,
 
   if(pipe->devid >= 0) dt_opencl_events_reset(pipe->devid);
 
-  dt_iop_roi_t roi = (dt_iop_roi_t){ x, y, width, height, scale };
+  dt_iop_roi_t roi = *roi_out;
   // printf("pixelpipe homebrew process start\n");
   if(darktable.unmuted & DT_DEBUG_DEV) dt_dev_pixelpipe_cache_print(&pipe->cache);
 
@@ -2760,18 +3045,21 @@ restart:
     pipe->devid = -1;
   }
   // ... and in case of other errors ...
-  if(err)
-  {
-    pipe->processing = 0;
-    return 1;
-  }
+  if(err) return 1;
 
-  // terminate
+  *output = buf;
+  return 0;
+}
+
+// publishes buf as the pipe's backbuf, or the output assembled from the tiles if buf is NULL
+static void _dev_pixelpipe_publish_backbuf(dt_dev_pixelpipe_t *pipe, const dt_iop_roi_t *roi, void *buf)
+{
   dt_pthread_mutex_lock(&pipe->backbuf_mutex);
-  pipe->backbuf_hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, &roi, pipe, 0);
+  if(!buf) buf = dt_dev_pixelpipe_tiles_publish(&(pipe->tiles));
+  pipe->backbuf_hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, roi, pipe, 0);
   pipe->backbuf = buf;
-  pipe->backbuf_width = width;
-  pipe->backbuf_height = height;
+  pipe->backbuf_width = roi->width;
+  pipe->backbuf_height = roi->height;
 
   if(pipe->type == DT_DEV_PIXELPIPE_PREVIEW ||
     pipe->type == DT_DEV_PIXELPIPE_FULL ||
@@ -2790,14 +3078,167 @@ restart:
     pipe->output_imgid = pipe->image.id;
   }
   dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
+}
+
+int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x, int y, int width, int height,
+                             float scale)
+{
+  pipe->processing = 1;
+
+  // export and thumbnail pipes hand both of their cache lines from one module to the next, only the darkroom
+  // pipes keep idle lines around for the next run
+  pipe->cache.half = (pipe->type & (DT_DEV_PIXELPIPE_FULL | DT_DEV_PIXELPIPE_PREVIEW | DT_DEV_PIXELPIPE_PREVIEW2))
+                     && dt_conf_get_bool("plugins/darkroom/half_float_cache");
+
+  const dt_iop_roi_t roi = (dt_iop_roi_t){ x, y, width, height, scale };
+  void *buf = NULL;
+  if(_dev_pixelpipe_process_roi(pipe, dev, &roi, &buf))
+  {
+    pipe->processing = 0;
+    return 1;
+  }
+
+  // terminate
+  _dev_pixelpipe_publish_backbuf(pipe, &roi, buf);
 
   // printf("pixelpipe homebrew process end\n");
   pipe->processing = 0;
   return 0;
 }
 
+// can the output of this pipe be stitched together from independently processed regions?
+static gboolean _dev_pixelpipe_tiles_usable(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev)
+{
+  if(pipe->type != DT_DEV_PIXELPIPE_FULL || !dt_conf_get_bool("plugins/darkroom/tile_cache")) return FALSE;
+
+  // mask display and suppression are not part of the pipe hash
+  if(dev->gui_module && (dev->gui_module->request_mask_display || dev->gui_module->suppress_mask)) return FALSE;
+
+  // modules which allow tiling guarantee that their output doesn't depend on the processed region. all others
+  // might (e.g. by computing statistics over their input), except for gamma which is a plain per-pixel one.
+  for(GList *pieces = pipe->nodes; pieces; pieces = g_list_next(pieces))
+  {
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)pieces->data;
+    dt_iop_module_t *module = piece->module;
+    if(_piece_is_skipped(dev, module, piece)) continue;
+    if(!(module->flags() & (IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_FUSIBLE)) && strcmp(module->op, "gamma"))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+int dt_dev_pixelpipe_process_tiled(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x, int y, int width,
+                                   int height, float scale)
+{
+  const int T = DT_DEV_PIXELPIPE_TILE_SIZE;
+  const int full_width = pipe->processed_width * scale;
+  const int full_height = pipe->processed_height * scale;
+
+  if(!_dev_pixelpipe_tiles_usable(pipe, dev) || x < 0 || y < 0 || width <= 0 || height <= 0
+     || x + width > full_width || y + height > full_height)
+  {
+    dt_dev_pixelpipe_tiles_flush(&(pipe->tiles));
+    return dt_dev_pixelpipe_process(pipe, dev, x, y, width, height, scale);
+  }
+
+  pipe->processing = 1;
+
+  // the tiles are only valid for the current history and zoom level
+  if(pipe->cache_obsolete) dt_dev_pixelpipe_tiles_flush(&(pipe->tiles));
+  const dt_iop_roi_t full_roi = (dt_iop_roi_t){ 0, 0, full_width, full_height, scale };
+  dt_dev_pixelpipe_tiles_validate(&(pipe->tiles),
+                                  dt_dev_pixelpipe_cache_hash(pipe->image.id, &full_roi, pipe,
+                                                              g_list_length(pipe->nodes)),
+                                  scale);
+
+  const int tx0 = x / T, tx1 = (x + width - 1) / T;
+  const int ty0 = y / T, ty1 = (y + height - 1) / T;
+  const int tw = tx1 - tx0 + 1, th = ty1 - ty0 + 1;
+  dt_dev_pixelpipe_tiles_trim(&(pipe->tiles), tx0, ty0, tx1, ty1);
+
+  // find the missing tiles and cover them greedily with as few rectangles as possible, after a pan these
+  // are a horizontal and a vertical band.
+  gboolean *missing = (gboolean *)calloc((size_t)tw * th, sizeof(gboolean));
+  int nmissing = 0;
+  for(int ty = ty0; ty <= ty1; ty++)
+    for(int tx = tx0; tx <= tx1; tx++)
+      if(!dt_dev_pixelpipe_tiles_get(&(pipe->tiles), tx, ty))
+      {
+        missing[(ty - ty0) * tw + (tx - tx0)] = TRUE;
+        nmissing++;
+      }
+
+  dt_times_t start;
+  dt_get_times(&start);
+  int rects = 0;
+
+  for(int j = 0; j < th; j++)
+    for(int i = 0; i < tw; i++)
+    {
+      if(!missing[j * tw + i]) continue;
+
+      int i1 = i;
+      while(i1 + 1 < tw && missing[j * tw + i1 + 1]) i1++;
+      int j1 = j;
+      for(gboolean grow = TRUE; grow && j1 + 1 < th;)
+      {
+        for(int k = i; k <= i1; k++)
+          if(!missing[(j1 + 1) * tw + k]) grow = FALSE;
+        if(grow) j1++;
+      }
+      for(int jj = j; jj <= j1; jj++)
+        for(int k = i; k <= i1; k++) missing[jj * tw + k] = FALSE;
+
+      // process the rectangle. the pipe extends it by whatever each module needs in modify_roi_in(), so
+      // the borders match the neighbouring tiles.
+      const int rx = (tx0 + i) * T, ry = (ty0 + j) * T;
+      const dt_iop_roi_t roi = (dt_iop_roi_t){ rx, ry, MIN((tx0 + i1 + 1) * T, full_width) - rx,
+                                               MIN((ty0 + j1 + 1) * T, full_height) - ry, scale };
+      void *buf = NULL;
+      if(_dev_pixelpipe_process_roi(pipe, dev, &roi, &buf))
+      {
+        free(missing);
+        pipe->processing = 0;
+        return 1;
+      }
+      rects++;
+
+      // mask display got switched on while processing, this can't be reused
+      if(pipe->mask_display != DT_DEV_PIXELPIPE_DISPLAY_NONE) continue;
+
+      for(int jj = j; jj <= j1; jj++)
+        for(int k = i; k <= i1; k++)
+        {
+          const int tx = tx0 + k, ty = ty0 + jj;
+          dt_dev_pixelpipe_tiles_put(&(pipe->tiles), tx, ty, MIN(T, full_width - tx * T),
+                                     MIN(T, full_height - ty * T), (const uint8_t *)buf, tx * T - rx,
+                                     ty * T - ry, roi.width);
+        }
+    }
+  free(missing);
+
+  dt_show_times_f(&start, "[dev_pixelpipe]", "processed %d of %d tiles in %d regions [%s]", nmissing, tw * th,
+                  rects, _pipe_type_to_str(pipe->type));
+
+  const dt_iop_roi_t roi = (dt_iop_roi_t){ x, y, width, height, scale };
+  // assemble into a private buffer, the gui might still be reading the published one
+  if(!dt_dev_pixelpipe_tiles_assemble(&(pipe->tiles), x, y, width, height))
+  {
+    // some tile could not be stored, process the region in one go
+    dt_dev_pixelpipe_tiles_flush(&(pipe->tiles));
+    pipe->processing = 0;
+    return dt_dev_pixelpipe_process(pipe, dev, x, y, width, height, scale);
+  }
+
+  _dev_pixelpipe_publish_backbuf(pipe, &roi, NULL);
+
+  pipe->processing = 0;
+  return 0;
+}
+
 void dt_dev_pixelpipe_flush_caches(dt_dev_pixelpipe_t *pipe)
 {
+  dt_dev_pixelpipe_tiles_flush(&(pipe->tiles));
   dt_dev_pixelpipe_cache_flush(&pipe->cache);
 }
 
@@ -25,6 +25,7 @@
 #include "develop/develop.h"
 #include "develop/imageop.h"
 #include "develop/pixelpipe_cache.h"
+#include "develop/pixelpipe_tiles.h"
 
 /**
  * struct used by iop modules to connect to pixelpipe.
@@ -34,6 +35,7 @@
 struct dt_iop_module_t;
 struct dt_dev_raster_mask_t;
 struct dt_iop_order_iccprofile_info_t;
+struct dt_export_report_t;
 
 typedef struct dt_dev_pixelpipe_raster_mask_t
 {
@@ -92,6 +94,8 @@ typedef struct dt_dev_pixelpipe_t
 {
   // store history/zoom caches
   dt_dev_pixelpipe_cache_t cache;
+  // final output tiles of the darkroom pipe, reused when panning
+  dt_dev_pixelpipe_tiles_t tiles;
   // set to non-zero in order to obsolete old cache entries on next pixelpipe run
   int cache_obsolete;
   // input buffer
@@ -158,6 +162,8 @@ typedef struct dt_dev_pixelpipe_t
   GList *forms;
   // the masks generated in the pipe for later reusal are inside dt_dev_pixelpipe_iop_t
   gboolean store_all_raster_masks;
+  // collects the time spent per module for export reports, if not NULL
+  struct dt_export_report_t *report;
 } dt_dev_pixelpipe_t;
 
 struct dt_develop_t;
@@ -210,6 +216,10 @@ void dt_dev_pixelpipe_synch_top(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *d
 // process region of interest of pixels. returns 1 if pipe was altered during processing.
 int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y, int width,
                              int height, float scale);
+// same as dt_dev_pixelpipe_process(), but only processes the parts of the region which are not in the tile
+// cache yet. falls back to dt_dev_pixelpipe_process() if the pipe can't be processed tile-wise.
+int dt_dev_pixelpipe_process_tiled(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y, int width,
+                                   int height, float scale);
 // convenience method that does not gamma-compress the image.
 int dt_dev_pixelpipe_process_no_gamma(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y,
                                       int width, int height, float scale);
@@ -0,0 +1,192 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "develop/pixelpipe_tiles.h"
+#include "common/darktable.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DT_TILE_BYTES ((size_t)4 * DT_DEV_PIXELPIPE_TILE_SIZE * DT_DEV_PIXELPIPE_TILE_SIZE)
+
+static inline gpointer _tile_key(const int tx, const int ty)
+{
+  gint64 *key = g_malloc(sizeof(gint64));
+  *key = ((gint64)ty << 32) | (guint32)tx;
+  return key;
+}
+
+static void _tile_free(gpointer data)
+{
+  dt_dev_pixelpipe_tile_t *tile = (dt_dev_pixelpipe_tile_t *)data;
+  dt_free_align(tile->data);
+  free(tile);
+}
+
+void dt_dev_pixelpipe_tiles_init(dt_dev_pixelpipe_tiles_t *tiles, size_t max_size)
+{
+  tiles->hash = 0;
+  tiles->scale = 0.0f;
+  tiles->tiles = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, _tile_free);
+  tiles->size = 0;
+  tiles->max_size = max_size;
+  tiles->clock = 0;
+  tiles->buf = NULL;
+  tiles->buf_size = 0;
+  tiles->published = NULL;
+  tiles->published_size = 0;
+}
+
+void dt_dev_pixelpipe_tiles_cleanup(dt_dev_pixelpipe_tiles_t *tiles)
+{
+  if(tiles->tiles) g_hash_table_destroy(tiles->tiles);
+  tiles->tiles = NULL;
+  tiles->size = 0;
+  dt_free_align(tiles->buf);
+  tiles->buf = NULL;
+  tiles->buf_size = 0;
+  dt_free_align(tiles->published);
+  tiles->published = NULL;
+  tiles->published_size = 0;
+}
+
+void dt_dev_pixelpipe_tiles_flush(dt_dev_pixelpipe_tiles_t *tiles)
+{
+  if(tiles->tiles) g_hash_table_remove_all(tiles->tiles);
+  tiles->size = 0;
+  tiles->hash = 0;
+  tiles->scale = 0.0f;
+}
+
+void dt_dev_pixelpipe_tiles_validate(dt_dev_pixelpipe_tiles_t *tiles, uint64_t hash, float scale)
+{
+  if(tiles->hash == hash && tiles->scale == scale) return;
+  dt_dev_pixelpipe_tiles_flush(tiles);
+  tiles->hash = hash;
+  tiles->scale = scale;
+}
+
+const dt_dev_pixelpipe_tile_t *dt_dev_pixelpipe_tiles_get(dt_dev_pixelpipe_tiles_t *tiles, int tx, int ty)
+{
+  const gint64 key = ((gint64)ty << 32) | (guint32)tx;
+  dt_dev_pixelpipe_tile_t *tile = (dt_dev_pixelpipe_tile_t *)g_hash_table_lookup(tiles->tiles, &key);
+  if(tile) tile->used = ++tiles->clock;
+  return tile;
+}
+
+void dt_dev_pixelpipe_tiles_put(dt_dev_pixelpipe_tiles_t *tiles, int tx, int ty, int width, int height,
+                                const uint8_t *const buf, int buf_x, int buf_y, int buf_width)
+{
+  dt_dev_pixelpipe_tile_t *tile = (dt_dev_pixelpipe_tile_t *)malloc(sizeof(dt_dev_pixelpipe_tile_t));
+  tile->data = (uint8_t *)dt_alloc_align(64, DT_TILE_BYTES);
+  if(!tile->data)
+  {
+    free(tile);
+    return;
+  }
+  tile->width = width;
+  tile->height = height;
+  tile->used = ++tiles->clock;
+
+  for(int j = 0; j < height; j++)
+    memcpy(tile->data + (size_t)4 * DT_DEV_PIXELPIPE_TILE_SIZE * j,
+           buf + (size_t)4 * ((size_t)(buf_y + j) * buf_width + buf_x), (size_t)4 * width);
+
+  // replace() drops a tile which might already be stored under this key
+  const gint64 key = ((gint64)ty << 32) | (guint32)tx;
+  if(!g_hash_table_contains(tiles->tiles, &key)) tiles->size += DT_TILE_BYTES;
+  g_hash_table_replace(tiles->tiles, _tile_key(tx, ty), tile);
+}
+
+void dt_dev_pixelpipe_tiles_trim(dt_dev_pixelpipe_tiles_t *tiles, int tx0, int ty0, int tx1, int ty1)
+{
+  while(tiles->size > tiles->max_size)
+  {
+    gint64 *lru_key = NULL;
+    uint64_t lru_used = UINT64_MAX;
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, tiles->tiles);
+    while(g_hash_table_iter_next(&iter, &key, &value))
+    {
+      const gint64 k = *(gint64 *)key;
+      const int tx = (int)(gint32)(k & 0xffffffff);
+      const int ty = (int)(k >> 32);
+      // never evict what we are about to display
+      if(tx >= tx0 && tx <= tx1 && ty >= ty0 && ty <= ty1) continue;
+      const dt_dev_pixelpipe_tile_t *tile = (dt_dev_pixelpipe_tile_t *)value;
+      if(tile->used < lru_used)
+      {
+        lru_used = tile->used;
+        lru_key = (gint64 *)key;
+      }
+    }
+    if(!lru_key) break;
+
+    g_hash_table_remove(tiles->tiles, lru_key);
+    tiles->size -= DT_TILE_BYTES;
+  }
+}
+
+gboolean dt_dev_pixelpipe_tiles_assemble(dt_dev_pixelpipe_tiles_t *tiles, int x, int y, int width, int height)
+{
+  const size_t size = (size_t)4 * width * height;
+  if(tiles->buf_size < size)
+  {
+    dt_free_align(tiles->buf);
+    tiles->buf = (uint8_t *)dt_alloc_align(64, size);
+    tiles->buf_size = tiles->buf ? size : 0;
+    if(!tiles->buf) return FALSE;
+  }
+
+  const int T = DT_DEV_PIXELPIPE_TILE_SIZE;
+  for(int ty = y / T; ty <= (y + height - 1) / T; ty++)
+    for(int tx = x / T; tx <= (x + width - 1) / T; tx++)
+    {
+      const dt_dev_pixelpipe_tile_t *tile = dt_dev_pixelpipe_tiles_get(tiles, tx, ty);
+      if(!tile) return FALSE;
+
+      // intersection of tile and requested region, in output coordinates
+      const int x0 = MAX(x, tx * T), x1 = MIN(x + width, tx * T + tile->width);
+      const int y0 = MAX(y, ty * T), y1 = MIN(y + height, ty * T + tile->height);
+      if(x1 <= x0 || y1 <= y0) continue;
+
+      for(int j = y0; j < y1; j++)
+        memcpy(tiles->buf + (size_t)4 * ((size_t)(j - y) * width + (x0 - x)),
+               tile->data + (size_t)4 * ((size_t)(j - ty * T) * T + (x0 - tx * T)), (size_t)4 * (x1 - x0));
+    }
+
+  return TRUE;
+}
+
+uint8_t *dt_dev_pixelpipe_tiles_publish(dt_dev_pixelpipe_tiles_t *tiles)
+{
+  uint8_t *buf = tiles->buf;
+  const size_t buf_size = tiles->buf_size;
+  tiles->buf = tiles->published;
+  tiles->buf_size = tiles->published_size;
+  tiles->published = buf;
+  tiles->published_size = buf_size;
+  return buf;
+}
+
+#undef DT_TILE_BYTES
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,91 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <inttypes.h>
+#include <stddef.h>
+
+/**
+ * caches the final 8-bit output of the darkroom pixelpipe in square tiles
+ * on a fixed grid of the scaled image. when panning, only the tiles which
+ * become visible are processed, the rest is reassembled from here.
+ * all tiles belong to the same pipe state (history, image and scale), as
+ * soon as that changes the whole cache is dropped.
+ */
+
+/** edge length of a tile in output pixels. */
+#define DT_DEV_PIXELPIPE_TILE_SIZE 256
+/** memory budget of the tile cache, enough for a few screens on a 4k display. */
+#define DT_DEV_PIXELPIPE_TILES_MAX_SIZE ((size_t)128 << 20)
+
+typedef struct dt_dev_pixelpipe_tile_t
+{
+  uint8_t *data; // 4 channels, DT_DEV_PIXELPIPE_TILE_SIZE pixels stride
+  int width, height;
+  uint64_t used;
+} dt_dev_pixelpipe_tile_t;
+
+typedef struct dt_dev_pixelpipe_tiles_t
+{
+  // pipe state the tiles were rendered with
+  uint64_t hash;
+  float scale;
+  // (tile x, tile y) -> dt_dev_pixelpipe_tile_t
+  GHashTable *tiles;
+  size_t size, max_size;
+  uint64_t clock;
+  // output being assembled, only touched by the pipe
+  uint8_t *buf;
+  size_t buf_size;
+  // last assembled output, published as the pipe's backbuf and only swapped under backbuf_mutex
+  uint8_t *published;
+  size_t published_size;
+} dt_dev_pixelpipe_tiles_t;
+
+void dt_dev_pixelpipe_tiles_init(dt_dev_pixelpipe_tiles_t *tiles, size_t max_size);
+void dt_dev_pixelpipe_tiles_cleanup(dt_dev_pixelpipe_tiles_t *tiles);
+
+/** drops all tiles. */
+void dt_dev_pixelpipe_tiles_flush(dt_dev_pixelpipe_tiles_t *tiles);
+
+/** makes sure the cache holds tiles for the given pipe state, flushes it otherwise. */
+void dt_dev_pixelpipe_tiles_validate(dt_dev_pixelpipe_tiles_t *tiles, uint64_t hash, float scale);
+
+/** returns the tile or NULL if it has not been rendered yet. */
+const dt_dev_pixelpipe_tile_t *dt_dev_pixelpipe_tiles_get(dt_dev_pixelpipe_tiles_t *tiles, int tx, int ty);
+
+/** stores tile (tx, ty) from a rendered buffer of width buf_width which starts at output pixel (buf_x, buf_y). */
+void dt_dev_pixelpipe_tiles_put(dt_dev_pixelpipe_tiles_t *tiles, int tx, int ty, int width, int height,
+                                const uint8_t *const buf, int buf_x, int buf_y, int buf_width);
+
+/** evicts least recently used tiles outside of the given tile range until the cache fits its budget. */
+void dt_dev_pixelpipe_tiles_trim(dt_dev_pixelpipe_tiles_t *tiles, int tx0, int ty0, int tx1, int ty1);
+
+/** copies the region (x, y, width, height) from the tiles into tiles->buf. all tiles have to be present.
+ * returns FALSE if a tile is missing or there is no memory. */
+gboolean dt_dev_pixelpipe_tiles_assemble(dt_dev_pixelpipe_tiles_t *tiles, int x, int y, int width, int height);
+
+/** makes the last assembled output the published one and returns it. the previously published buffer is reused
+ * for the next assemble, so the caller has to hold the pipe's backbuf_mutex. */
+uint8_t *dt_dev_pixelpipe_tiles_publish(dt_dev_pixelpipe_tiles_t *tiles);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -29,6 +29,7 @@ extern "C" {
 struct dt_imageio_module_format_t;
 struct dt_imageio_module_data_t;
 struct dt_dev_pixelpipe_t;
+struct dt_exif_blobs_t;
 
 #include "common/colorspaces.h" // because forward declaring enums doesn't work in C++ :(
 
@@ -85,6 +86,7 @@ int levels(struct dt_imageio_module_data_t *data);
 
 // sometimes we want to tell the world about what we can do
 int flags(struct dt_imageio_module_data_t *data);
+int set_metadata(struct dt_imageio_module_data_t *data, const struct dt_exif_blobs_t *blobs);
 
 int read_image(struct dt_imageio_module_data_t *data, uint8_t *out);
 
@@ -50,6 +50,7 @@ typedef struct dt_imageio_jpeg_t
   struct jpeg_decompress_struct dinfo;
   struct jpeg_compress_struct cinfo;
   FILE *f;
+  const dt_exif_blobs_t *metadata;
 } dt_imageio_jpeg_t;
 
 typedef struct dt_imageio_jpeg_gui_data_t
@@ -305,10 +306,38 @@ read_icc_profile (j_decompress_ptr cinfo,
 #endif
 #undef ICC_MARKER
 #undef ICC_OVERHEAD_LEN
-#undef MAX_BYTES_IN_MARKER
 #undef MAX_DATA_BYTES_IN_MARKER
 #undef MAX_SEQ_NO
 
+// signatures in front of the xmp and iptc payloads
+static const char _xmp_signature[] = "http://ns.adobe.com/xap/1.0/"; // including the terminating 0
+static const char _iptc_signature[] = "Photoshop 3.0";
+
+int set_metadata(dt_imageio_module_data_t *jpg_tmp, const dt_exif_blobs_t *blobs)
+{
+  dt_imageio_jpeg_t *jpg = (dt_imageio_jpeg_t *)jpg_tmp;
+  jpg->metadata = NULL;
+  if(!blobs) return 0;
+
+  // extended xmp or exif spanning several markers are not worth it, let exiv2 sort that out
+  if(blobs->exif_len > MAX_BYTES_IN_MARKER || blobs->xmp_len + sizeof(_xmp_signature) > MAX_BYTES_IN_MARKER
+     || blobs->iptc_len + sizeof(_iptc_signature) > MAX_BYTES_IN_MARKER)
+    return 1;
+
+  jpg->metadata = blobs;
+  return 0;
+}
+
+static void _write_marker(j_compress_ptr cinfo, const int marker, const char *signature, const size_t signature_len,
+                          const uint8_t *data, const size_t len)
+{
+  if(!len) return;
+  jpeg_write_m_header(cinfo, marker, signature_len + len);
+  for(size_t k = 0; k < signature_len; k++) jpeg_write_m_byte(cinfo, signature[k]);
+  for(size_t k = 0; k < len; k++) jpeg_write_m_byte(cinfo, data[k]);
+}
+
+#undef MAX_BYTES_IN_MARKER
 
 int write_image(dt_imageio_module_data_t *jpg_tmp, const char *filename, const void *in_tmp,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
@@ -365,6 +394,10 @@ int write_image(dt_imageio_module_data_t *jpg_tmp, const char *filename, const v
 
   jpeg_start_compress(&(jpg->cinfo), TRUE);
 
+  // exif right behind jfif, as exif readers expect it early in the file
+  if(jpg->metadata)
+    _write_marker(&(jpg->cinfo), JPEG_APP0 + 1, NULL, 0, jpg->metadata->exif, jpg->metadata->exif_len);
+
   if(imgid > 0)
   {
     cmsHPROFILE out_profile = dt_colorspaces_get_output_profile(imgid, over_type, over_filename)->profile;
@@ -379,6 +412,14 @@ int write_image(dt_imageio_module_data_t *jpg_tmp, const char *filename, const v
     }
   }
 
+  if(jpg->metadata)
+  {
+    _write_marker(&(jpg->cinfo), JPEG_APP0 + 1, _xmp_signature, sizeof(_xmp_signature),
+                  (const uint8_t *)jpg->metadata->xmp, jpg->metadata->xmp_len);
+    _write_marker(&(jpg->cinfo), JPEG_APP0 + 13, _iptc_signature, sizeof(_iptc_signature), jpg->metadata->iptc,
+                  jpg->metadata->iptc_len);
+  }
+
   uint8_t *row = dt_alloc_align(64, (size_t)3 * jpg->global.width * sizeof(uint8_t));
   const uint8_t *buf;
   while(jpg->cinfo.next_scanline < jpg->cinfo.image_height)
@@ -395,7 +436,7 @@ int write_image(dt_imageio_module_data_t *jpg_tmp, const char *filename, const v
   jpeg_destroy_compress(&(jpg->cinfo));
   fclose(f);
 
-  dt_exif_write_blob(exif, exif_len, filename, 1);
+  if(exif) dt_exif_write_blob(exif, exif_len, filename, 1);
 
   return 0;
 }
@@ -31,6 +31,7 @@
 #include "bauhaus/bauhaus.h"
 #include "common/colorspaces.h"
 #include "common/darktable.h"
+#include "common/exif.h"
 #include "common/imageio.h"
 #include "common/imageio_module.h"
 #include "control/conf.h"
@@ -46,6 +47,7 @@ typedef struct dt_imageio_png_t
   FILE *f;
   png_structp png_ptr;
   png_infop info_ptr;
+  const dt_exif_blobs_t *metadata;
 } dt_imageio_png_t;
 
 typedef struct dt_imageio_png_gui_t
@@ -119,6 +121,243 @@ static void PNGwriteRawProfile(png_struct *ping, png_info *ping_info, char *prof
   png_free(ping, text);
 }
 
+// filtered image data deflated by one thread. blocks are primed with the tail of the previous one,
+// so that apart from the flush markers the compression ratio is the same as for a single stream.
+#define DT_PNG_BLOCK_SIZE ((size_t)512 << 10)
+#define DT_PNG_WINDOW_SIZE ((size_t)1 << 15)
+
+// converts one row of the pipe output to big endian rgb
+static void _pack_row(const dt_imageio_png_t *p, const void *const ivoid, const int y, uint8_t *const out)
+{
+  const size_t width = p->global.width;
+  if(p->bpp > 8)
+  {
+    const uint16_t *in = (const uint16_t *)ivoid + (size_t)4 * width * y;
+    for(size_t x = 0; x < width; x++)
+      for(int c = 0; c < 3; c++)
+      {
+        out[6 * x + 2 * c] = in[4 * x + c] >> 8;
+        out[6 * x + 2 * c + 1] = in[4 * x + c] & 0xff;
+      }
+  }
+  else
+  {
+    const uint8_t *in = (const uint8_t *)ivoid + (size_t)4 * width * y;
+    for(size_t x = 0; x < width; x++)
+      for(int c = 0; c < 3; c++) out[3 * x + c] = in[4 * x + c];
+  }
+}
+
+static inline uint8_t _paeth(const int a, const int b, const int c)
+{
+  const int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - 2 * c);
+  return (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+}
+
+static inline uint8_t _filter_byte(const int type, const int x, const int a, const int b, const int c)
+{
+  switch(type)
+  {
+    case PNG_FILTER_VALUE_SUB:
+      return x - a;
+    case PNG_FILTER_VALUE_UP:
+      return x - b;
+    case PNG_FILTER_VALUE_AVG:
+      return x - ((a + b) >> 1);
+    case PNG_FILTER_VALUE_PAETH:
+      return x - _paeth(a, b, c);
+    default:
+      return x;
+  }
+}
+
+static inline size_t _residual(const uint8_t v)
+{
+  return v < 128 ? v : 256 - v;
+}
+
+// picks the filter with the smallest sum of absolute (signed) residuals, the same heuristic libpng uses.
+// prev is the unfiltered previous row, zeros for the first one.
+static void _filter_row(const uint8_t *const row, const uint8_t *const prev, uint8_t *const out,
+                        const size_t rowbytes, const size_t bpp)
+{
+  size_t sum[PNG_FILTER_VALUE_LAST] = { 0 };
+  for(size_t i = 0; i < rowbytes; i++)
+  {
+    const int x = row[i], b = prev[i];
+    const int a = i >= bpp ? row[i - bpp] : 0;
+    const int c = i >= bpp ? prev[i - bpp] : 0;
+    sum[PNG_FILTER_VALUE_NONE] += _residual(x);
+    sum[PNG_FILTER_VALUE_SUB] += _residual(x - a);
+    sum[PNG_FILTER_VALUE_UP] += _residual(x - b);
+    sum[PNG_FILTER_VALUE_AVG] += _residual(x - ((a + b) >> 1));
+    sum[PNG_FILTER_VALUE_PAETH] += _residual(x - _paeth(a, b, c));
+  }
+
+  int best = PNG_FILTER_VALUE_NONE;
+  for(int type = PNG_FILTER_VALUE_SUB; type < PNG_FILTER_VALUE_LAST; type++)
+    if(sum[type] < sum[best]) best = type;
+
+  out[0] = best;
+  for(size_t i = 0; i < rowbytes; i++)
+    out[i + 1] = _filter_byte(best, row[i], i >= bpp ? row[i - bpp] : 0, prev[i], i >= bpp ? prev[i - bpp] : 0);
+}
+
+static void _write_idat_chunk(png_structp png_ptr, uint8_t *const data, const size_t length)
+{
+  if(length) png_write_chunk(png_ptr, (png_bytep) "IDAT", data, length);
+}
+
+/*
+ * filters all rows and deflates the result in blocks on all threads, each block becoming part of a
+ * single zlib stream split over several IDAT chunks. the blocks are raw deflate streams ending on a
+ * byte boundary (sync flush), so they can just be concatenated behind the zlib header, followed by
+ * the adler32 of the whole data which is combined from the ones of the blocks.
+ * returns 1 without having written anything if we don't get the memory, -1 on error.
+ */
+static int _write_idat(png_structp png_ptr, const dt_imageio_png_t *p, const void *const ivoid)
+{
+  const int width = p->global.width, height = p->global.height;
+  const size_t bpp = p->bpp > 8 ? 6 : 3;
+  const size_t rowbytes = bpp * width;
+  const size_t size = (rowbytes + 1) * height;
+  const int nthreads = dt_get_num_threads();
+  const int nblocks = (size + DT_PNG_BLOCK_SIZE - 1) / DT_PNG_BLOCK_SIZE;
+  const int batch = MIN(nblocks, 2 * nthreads);
+  // room for the largest possible raw deflate block including the sync marker, the zlib header and trailer
+  const size_t out_size = compressBound(DT_PNG_BLOCK_SIZE) + 32;
+
+  uint8_t *filtered = dt_alloc_align(64, size);
+  uint8_t *scratch = dt_alloc_align(64, 2 * rowbytes * nthreads);
+  uint8_t *out = dt_alloc_align(64, out_size * batch);
+  size_t *lengths = calloc(batch, sizeof(size_t));
+  uLong *adlers = calloc(batch, sizeof(uLong));
+  if(!filtered || !scratch || !out || !lengths || !adlers)
+  {
+    dt_free_align(filtered);
+    dt_free_align(scratch);
+    dt_free_align(out);
+    free(lengths);
+    free(adlers);
+    return 1;
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(bpp, filtered, height, ivoid, p, rowbytes, scratch) \
+  schedule(static)
+#endif
+  for(int y = 0; y < height; y++)
+  {
+    uint8_t *row = scratch + 2 * rowbytes * dt_get_thread_num();
+    uint8_t *prev = row + rowbytes;
+    _pack_row(p, ivoid, y, row);
+    if(y > 0)
+      _pack_row(p, ivoid, y - 1, prev);
+    else
+      memset(prev, 0, rowbytes);
+    _filter_row(row, prev, filtered + (rowbytes + 1) * y, rowbytes, bpp);
+  }
+
+  // zlib header as deflate would write it, 32k window and no preset dictionary
+  const int level = CLAMP(p->compression, 0, 9);
+  const int level_flags = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+  unsigned int header = ((Z_DEFLATED + (7 << 4)) << 8) | (level_flags << 6);
+  header += 31 - (header % 31);
+
+  int rc = 0;
+  uLong adler = adler32(0L, Z_NULL, 0);
+  for(int first = 0; first < nblocks && !rc; first += batch)
+  {
+    const int count = MIN(batch, nblocks - first);
+    int failed = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(adlers, count, filtered, first, lengths, level, nblocks, out, out_size, size) \
+  reduction(|:failed) schedule(dynamic, 1)
+#endif
+    for(int k = 0; k < count; k++)
+    {
+      const size_t offset = (first + k) * DT_PNG_BLOCK_SIZE;
+      const size_t length = MIN(DT_PNG_BLOCK_SIZE, size - offset);
+      const gboolean last = first + k == nblocks - 1;
+      uint8_t *dest = out + out_size * k + 2; // leave room for the zlib header
+
+      adlers[k] = adler32(adler32(0L, Z_NULL, 0), filtered + offset, length);
+
+      z_stream zs = { 0 };
+      if(deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      {
+        failed |= 1;
+        continue;
+      }
+      if(offset > 0)
+      {
+        const size_t dict = MIN(DT_PNG_WINDOW_SIZE, offset);
+        deflateSetDictionary(&zs, filtered + offset - dict, dict);
+      }
+      zs.next_in = filtered + offset;
+      zs.avail_in = length;
+      zs.next_out = dest;
+      zs.avail_out = out_size - 6; // minus header and trailer
+      const int ret = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+      if((last && ret != Z_STREAM_END) || (!last && (ret != Z_OK || zs.avail_in || !zs.avail_out)))
+        failed |= 1;
+      lengths[k] = zs.next_out - dest;
+      deflateEnd(&zs);
+    }
+
+    if(failed)
+    {
+      rc = -1;
+      break;
+    }
+
+    for(int k = 0; k < count; k++)
+    {
+      uint8_t *block = out + out_size * k + 2;
+      size_t length = lengths[k];
+      adler = adler32_combine(adler, adlers[k], MIN(DT_PNG_BLOCK_SIZE, size - (first + k) * DT_PNG_BLOCK_SIZE));
+      if(first + k == 0)
+      {
+        block -= 2;
+        length += 2;
+        block[0] = header >> 8;
+        block[1] = header & 0xff;
+      }
+      if(first + k == nblocks - 1)
+      {
+        block[length++] = adler >> 24;
+        block[length++] = (adler >> 16) & 0xff;
+        block[length++] = (adler >> 8) & 0xff;
+        block[length++] = adler & 0xff;
+      }
+      _write_idat_chunk(png_ptr, block, length);
+    }
+  }
+
+  dt_free_align(filtered);
+  dt_free_align(scratch);
+  dt_free_align(out);
+  free(lengths);
+  free(adlers);
+  return rc;
+}
+
+int set_metadata(dt_imageio_module_data_t *p_tmp, const dt_exif_blobs_t *blobs)
+{
+  dt_imageio_png_t *p = (dt_imageio_png_t *)p_tmp;
+  p->metadata = NULL;
+  if(!blobs) return 0;
+#ifndef PNG_iTXt_SUPPORTED
+  // no way to store the xmp packet, leave it to exiv2
+  if(blobs->xmp_len) return 1;
+#endif
+  p->metadata = blobs;
+  return 0;
+}
+
 int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const void *ivoid,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe)
@@ -191,11 +430,46 @@ int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const voi
     }
   }
 
-  // write exif data
-  PNGwriteRawProfile(png_ptr, info_ptr, "exif", exif, exif_len);
+  if(p->metadata)
+  {
+    // the same chunks exiv2 would add when rewriting the file afterwards
+    const dt_exif_blobs_t *m = p->metadata;
+    if(m->exif_len) PNGwriteRawProfile(png_ptr, info_ptr, "exif", m->exif, m->exif_len);
+    if(m->iptc_len) PNGwriteRawProfile(png_ptr, info_ptr, "iptc", m->iptc, m->iptc_len);
+#ifdef PNG_iTXt_SUPPORTED
+    if(m->xmp_len)
+    {
+      png_text text = { 0 };
+      text.compression = PNG_ITXT_COMPRESSION_NONE;
+      text.key = "XML:com.adobe.xmp";
+      text.text = m->xmp;
+      text.itxt_length = m->xmp_len;
+      text.lang = "";
+      text.lang_key = "";
+      png_set_text(png_ptr, info_ptr, &text, 1);
+    }
+#endif
+  }
+  else
+  {
+    // write exif data
+    PNGwriteRawProfile(png_ptr, info_ptr, "exif", exif, exif_len);
+  }
 
   png_write_info(png_ptr, info_ptr);
 
+  const int idat = _write_idat(png_ptr, p, ivoid);
+  if(idat <= 0)
+  {
+    // libpng did not see any rows and would refuse png_write_end(), so close the file ourselves
+    if(idat == 0) png_write_chunk(png_ptr, (png_bytep) "IEND", NULL, 0);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    fclose(f);
+    return idat == 0 ? 0 : 1;
+  }
+
+  // not enough memory for the parallel encoder, let libpng write it row by row
+
   /*
    * Get rid of filler (OR ALPHA) bytes, pack XRGB/RGBX/ARGB/RGBA into
    * RGB (4 channels -> 3 channels). The second parameter is not used.
@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <tiffio.h>
+#include <zlib.h>
 
 DT_MODULE(3)
 
@@ -40,6 +41,7 @@ typedef struct dt_imageio_tiff_t
   int compress;
   int compresslevel;
   TIFF *handle;
+  const dt_exif_blobs_t *metadata;
 } dt_imageio_tiff_t;
 
 typedef struct dt_imageio_tiff_gui_t
@@ -50,6 +52,486 @@ typedef struct dt_imageio_tiff_gui_t
 } dt_imageio_tiff_gui_t;
 
 
+// uncompressed size of a strip. big enough for deflate to find its matches, small enough to give every
+// thread something to do on moderately sized exports.
+#define DT_TIFF_STRIP_SIZE ((size_t)256 << 10)
+
+// converts rows [y, y + rows) from the 4 channel pipe output to the 3 channel file layout, host byte order.
+static void _pack_strip(const dt_imageio_tiff_t *d, const void *const in_void, uint8_t *const strip, const int y,
+                        const int rows)
+{
+  const size_t width = d->global.width;
+  const size_t bytes = d->bpp / 8;
+  const uint8_t *in = (const uint8_t *)in_void + 4 * bytes * width * y;
+  uint8_t *out = strip;
+  for(size_t k = 0; k < width * rows; k++, in += 4 * bytes, out += 3 * bytes) memcpy(out, in, 3 * bytes);
+}
+
+// horizontal differencing as done by libtiff's PREDICTOR_HORIZONTAL, row by row
+static void _predict_horizontal(const dt_imageio_tiff_t *d, uint8_t *const strip, const int rows)
+{
+  const size_t wc = (size_t)3 * d->global.width;
+  for(int j = 0; j < rows; j++)
+  {
+    if(d->bpp == 8)
+    {
+      uint8_t *row = strip + wc * j;
+      for(size_t i = wc - 1; i >= 3; i--) row[i] -= row[i - 3];
+    }
+    else if(d->bpp == 16)
+    {
+      uint16_t *row = (uint16_t *)strip + wc * j;
+      for(size_t i = wc - 1; i >= 3; i--) row[i] -= row[i - 3];
+    }
+    else
+    {
+      uint32_t *row = (uint32_t *)strip + wc * j;
+      for(size_t i = wc - 1; i >= 3; i--) row[i] -= row[i - 3];
+    }
+  }
+}
+
+// libtiff's PREDICTOR_FLOATINGPOINT: split every row into byte planes, most significant first, then
+// difference the bytes. tmp has to hold one row.
+static void _predict_float(const dt_imageio_tiff_t *d, uint8_t *const strip, const int rows, uint8_t *const tmp)
+{
+  const size_t wc = (size_t)3 * d->global.width;
+  const size_t cc = 4 * wc;
+  for(int j = 0; j < rows; j++)
+  {
+    uint8_t *row = strip + cc * j;
+    memcpy(tmp, row, cc);
+    for(size_t count = 0; count < wc; count++)
+      for(size_t byte = 0; byte < 4; byte++)
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+        row[byte * wc + count] = tmp[4 * count + byte];
+#else
+        row[(3 - byte) * wc + count] = tmp[4 * count + byte];
+#endif
+    for(size_t i = cc - 1; i >= 3; i--) row[i] -= row[i - 3];
+  }
+}
+
+// for files not in host byte order. the float predictor already produces the byte order of the file.
+static void _swab_strip(const dt_imageio_tiff_t *d, uint8_t *const strip, const int rows)
+{
+  const size_t samples = (size_t)3 * d->global.width * rows;
+  if(d->bpp == 16)
+    for(size_t k = 0; k < samples; k++) ((uint16_t *)strip)[k] = GUINT16_SWAP_LE_BE(((uint16_t *)strip)[k]);
+  else if(d->bpp == 32)
+    for(size_t k = 0; k < samples; k++) ((uint32_t *)strip)[k] = GUINT32_SWAP_LE_BE(((uint32_t *)strip)[k]);
+}
+
+/*
+ * libtiff only compresses one strip at a time on the calling thread, which makes large deflate
+ * compressed exports slower than the pipe which rendered them. we therefore do the packing, the
+ * predictor and the compression ourselves, for a batch of strips in parallel, and hand the readily
+ * encoded strips to TIFFWriteRawStrip() in order. the tags set on tif describe the encoding.
+ */
+static int _write_strips(TIFF *tif, const dt_imageio_tiff_t *d, const void *const in_void, const uint16_t predictor,
+                         const int rows_per_strip)
+{
+  const size_t rowsize = (size_t)3 * d->global.width * d->bpp / 8;
+  const int height = d->global.height;
+  const int nstrips = (height + rows_per_strip - 1) / rows_per_strip;
+  const int batch = MIN(nstrips, 2 * dt_get_num_threads());
+  const size_t strip_size = rowsize * rows_per_strip;
+  const size_t packed_size = d->compress ? compressBound(strip_size) : 0;
+  const gboolean swab = TIFFIsByteSwapped(tif) && predictor != PREDICTOR_FLOATINGPOINT;
+
+  // per strip of a batch: the packed pixels, the compressed data and its length
+  uint8_t *strips = dt_alloc_align(64, strip_size * batch);
+  uint8_t *packed = d->compress ? dt_alloc_align(64, packed_size * batch) : NULL;
+  uint8_t *tmp = predictor == PREDICTOR_FLOATINGPOINT ? dt_alloc_align(64, rowsize * batch) : NULL;
+  size_t *lengths = calloc(batch, sizeof(size_t));
+
+  int rc = 1;
+  if(!strips || !lengths || (d->compress && !packed) || (predictor == PREDICTOR_FLOATINGPOINT && !tmp))
+    goto exit;
+
+  for(int first = 0; first < nstrips; first += batch)
+  {
+    const int count = MIN(batch, nstrips - first);
+    int failed = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(count, d, first, height, in_void, lengths, packed, packed_size, predictor, \
+                        rows_per_strip, rowsize, strip_size, strips, swab, tmp) \
+    reduction(|:failed) schedule(dynamic, 1)
+#endif
+    for(int k = 0; k < count; k++)
+    {
+      const int y = (first + k) * rows_per_strip;
+      const int rows = MIN(rows_per_strip, height - y);
+      uint8_t *strip = strips + strip_size * k;
+
+      _pack_strip(d, in_void, strip, y, rows);
+      if(predictor == PREDICTOR_HORIZONTAL)
+        _predict_horizontal(d, strip, rows);
+      else if(predictor == PREDICTOR_FLOATINGPOINT)
+        _predict_float(d, strip, rows, tmp + rowsize * k);
+      if(swab) _swab_strip(d, strip, rows);
+
+      lengths[k] = rowsize * rows;
+      if(d->compress)
+      {
+        // same zlib stream as libtiff's deflate codec produces
+        uLongf length = packed_size;
+        if(compress2(packed + packed_size * k, &length, strip, lengths[k], d->compresslevel) != Z_OK)
+          failed |= 1;
+        lengths[k] = length;
+      }
+    }
+
+    if(failed) goto exit;
+
+    for(int k = 0; k < count; k++)
+    {
+      uint8_t *data = d->compress ? packed + packed_size * k : strips + strip_size * k;
+      if(TIFFWriteRawStrip(tif, first + k, data, lengths[k]) == -1) goto exit;
+    }
+  }
+
+  rc = 0;
+
+exit:
+  dt_free_align(strips);
+  dt_free_align(packed);
+  dt_free_align(tmp);
+  free(lengths);
+  return rc;
+}
+
+/*
+ * the exif blob handed to set_metadata() is a little tiff structure of its own. its directories are copied
+ * tag by tag into the image directory and into exif and gps directories written by libtiff, which only takes
+ * tags it knows and with the types it keeps them in. if any tag doesn't make it, the whole blob is merged
+ * into the file by exiv2 afterwards, like for formats which don't embed metadata themselves.
+ */
+typedef struct _exif_blob_t
+{
+  const uint8_t *data; // starting with the tiff header
+  size_t len;
+  gboolean big_endian;
+} _exif_blob_t;
+
+static uint32_t _exif_get(const _exif_blob_t *b, const size_t offset, const size_t size)
+{
+  uint32_t v = 0;
+  for(size_t k = 0; k < size; k++)
+    v |= (uint32_t)b->data[offset + k] << (8 * (b->big_endian ? size - 1 - k : k));
+  return v;
+}
+
+static gboolean _exif_open(_exif_blob_t *b, const uint8_t *exif, const size_t len)
+{
+  // skip the "Exif\0\0" in front of the tiff header
+  if(!exif || len < 6 + 8) return FALSE;
+  b->data = exif + 6;
+  b->len = len - 6;
+  if(!memcmp(b->data, "MM", 2))
+    b->big_endian = TRUE;
+  else if(!memcmp(b->data, "II", 2))
+    b->big_endian = FALSE;
+  else
+    return FALSE;
+  return _exif_get(b, 2, 2) == 42;
+}
+
+// offset of the directory following the header, 0 if it is broken
+static uint32_t _exif_first_ifd(const _exif_blob_t *b)
+{
+  const uint32_t ifd = _exif_get(b, 4, 4);
+  if(ifd > b->len - 2 || ifd + 2 + (size_t)12 * _exif_get(b, ifd, 2) > b->len) return 0;
+  return ifd;
+}
+
+// value of a LONG entry of the directory at ifd, used for the offsets of the sub directories
+static uint32_t _exif_find(const _exif_blob_t *b, const uint32_t ifd, const uint32_t tag)
+{
+  const int entries = _exif_get(b, ifd, 2);
+  for(int k = 0; k < entries; k++)
+  {
+    const size_t entry = ifd + 2 + (size_t)12 * k;
+    if(_exif_get(b, entry, 2) != tag || _exif_get(b, entry + 2, 2) != TIFF_LONG) continue;
+    const uint32_t sub = _exif_get(b, entry + 8, 4);
+    if(sub > b->len - 2 || sub + 2 + (size_t)12 * _exif_get(b, sub, 2) > b->len) return 0;
+    return sub;
+  }
+  return 0;
+}
+
+static size_t _exif_type_size(const int type)
+{
+  switch(type)
+  {
+    case TIFF_BYTE:
+    case TIFF_SBYTE:
+    case TIFF_UNDEFINED:
+    case TIFF_ASCII:
+      return 1;
+    case TIFF_SHORT:
+    case TIFF_SSHORT:
+      return 2;
+    case TIFF_LONG:
+    case TIFF_SLONG:
+    case TIFF_FLOAT:
+      return 4;
+    case TIFF_RATIONAL:
+    case TIFF_SRATIONAL:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+// value k of an entry of the given type stored at offset
+static double _exif_value(const _exif_blob_t *b, const int type, const size_t offset, const uint32_t k)
+{
+  switch(type)
+  {
+    case TIFF_SBYTE:
+      return (int8_t)b->data[offset + k];
+    case TIFF_SHORT:
+      return _exif_get(b, offset + 2 * k, 2);
+    case TIFF_SSHORT:
+      return (int16_t)_exif_get(b, offset + 2 * k, 2);
+    case TIFF_LONG:
+      return _exif_get(b, offset + 4 * k, 4);
+    case TIFF_SLONG:
+      return (int32_t)_exif_get(b, offset + 4 * k, 4);
+    case TIFF_RATIONAL:
+    {
+      const uint32_t den = _exif_get(b, offset + 8 * k + 4, 4);
+      return den ? (double)_exif_get(b, offset + 8 * k, 4) / den : 0.0;
+    }
+    case TIFF_SRATIONAL:
+    {
+      const int32_t den = _exif_get(b, offset + 8 * k + 4, 4);
+      return den ? (double)(int32_t)_exif_get(b, offset + 8 * k, 4) / den : 0.0;
+    }
+    case TIFF_FLOAT:
+    {
+      union { uint32_t i; float f; } v = { _exif_get(b, offset + 4 * k, 4) };
+      return v.f;
+    }
+    default:
+      return b->data[offset + k];
+  }
+}
+
+// size of one value as libtiff wants it passed in arrays
+static size_t _field_size(const TIFFField *fip)
+{
+#if TIFFLIB_VERSION >= 20221213
+  return TIFFFieldSetGetSize(fip);
+#else
+  // older versions keep all rationals as float
+  const TIFFDataType type = TIFFFieldDataType(fip);
+  return type == TIFF_DOUBLE ? 8 : type == TIFF_RATIONAL || type == TIFF_SRATIONAL ? 4 : _exif_type_size(type);
+#endif
+}
+
+static void _field_store(void *out, const TIFFDataType type, const size_t size, const uint32_t k, const double v)
+{
+  switch(type)
+  {
+    case TIFF_SBYTE:
+      ((int8_t *)out)[k] = v;
+      break;
+    case TIFF_SHORT:
+      ((uint16_t *)out)[k] = v;
+      break;
+    case TIFF_SSHORT:
+      ((int16_t *)out)[k] = v;
+      break;
+    case TIFF_LONG:
+      ((uint32_t *)out)[k] = v;
+      break;
+    case TIFF_SLONG:
+      ((int32_t *)out)[k] = v;
+      break;
+    case TIFF_RATIONAL:
+    case TIFF_SRATIONAL:
+    case TIFF_FLOAT:
+    case TIFF_DOUBLE:
+      if(size == 8)
+        ((double *)out)[k] = v;
+      else
+        ((float *)out)[k] = v;
+      break;
+    default:
+      ((uint8_t *)out)[k] = v;
+      break;
+  }
+}
+
+// returns FALSE if libtiff doesn't take the entry as it is
+static gboolean _exif_set_entry(TIFF *tif, const _exif_blob_t *b, const size_t entry)
+{
+  const uint32_t tag = _exif_get(b, entry, 2);
+  const int type = _exif_get(b, entry + 2, 2);
+  const uint32_t count = _exif_get(b, entry + 4, 4);
+  const size_t type_size = _exif_type_size(type);
+  if(!type_size || !count || count > b->len / type_size) return FALSE;
+  const size_t offset = type_size * count <= 4 ? entry + 8 : _exif_get(b, entry + 8, 4);
+  if(offset > b->len || type_size * count > b->len - offset) return FALSE;
+
+  const TIFFField *fip = TIFFFindField(tif, tag, TIFF_ANY);
+  if(!fip) return FALSE;
+  const TIFFDataType field_type = TIFFFieldDataType(fip);
+
+  if(field_type == TIFF_ASCII)
+  {
+    if(type != TIFF_ASCII) return FALSE;
+    gchar *value = g_strndup((const char *)b->data + offset, count);
+    const int ok = TIFFSetField(tif, tag, value);
+    g_free(value);
+    return ok;
+  }
+  // offsets into the blob mean nothing in the file
+  if(type == TIFF_ASCII || !_exif_type_size(field_type) || field_type == TIFF_IFD || field_type == TIFF_IFD8)
+    return FALSE;
+
+  const int write_count = TIFFFieldWriteCount(fip);
+  if(!TIFFFieldPassCount(fip) && write_count == 1)
+  {
+    if(count != 1) return FALSE;
+    const double v = _exif_value(b, type, offset, 0);
+    if(field_type == TIFF_LONG)
+      return TIFFSetField(tif, tag, (uint32_t)v);
+    else if(field_type == TIFF_SLONG)
+      return TIFFSetField(tif, tag, (int32_t)v);
+    else if(field_type == TIFF_RATIONAL || field_type == TIFF_SRATIONAL || field_type == TIFF_FLOAT)
+      return TIFFSetField(tif, tag, v);
+    else
+      return TIFFSetField(tif, tag, (int)v);
+  }
+  if(!TIFFFieldPassCount(fip) && write_count != count) return FALSE;
+
+  const size_t size = _field_size(fip);
+  void *values = g_malloc0(size * count);
+  for(uint32_t k = 0; k < count; k++) _field_store(values, field_type, size, k, _exif_value(b, type, offset, k));
+  int ok;
+  if(!TIFFFieldPassCount(fip))
+    ok = TIFFSetField(tif, tag, values);
+  else if(write_count == TIFF_VARIABLE2)
+    ok = TIFFSetField(tif, tag, (uint32_t)count, values);
+  else
+    ok = TIFFSetField(tif, tag, (int)count, values);
+  g_free(values);
+  return ok;
+}
+
+// tags of the image directory which describe our own pixels or are set from elsewhere. the ones the blob has
+// (orientation and resolution) are the same values as ours.
+static gboolean _exif_structural_tag(const uint32_t tag)
+{
+  switch(tag)
+  {
+    case TIFFTAG_SUBFILETYPE:
+    case TIFFTAG_IMAGEWIDTH:
+    case TIFFTAG_IMAGELENGTH:
+    case TIFFTAG_BITSPERSAMPLE:
+    case TIFFTAG_COMPRESSION:
+    case TIFFTAG_PHOTOMETRIC:
+    case TIFFTAG_FILLORDER:
+    case TIFFTAG_STRIPOFFSETS:
+    case TIFFTAG_ORIENTATION:
+    case TIFFTAG_SAMPLESPERPIXEL:
+    case TIFFTAG_ROWSPERSTRIP:
+    case TIFFTAG_STRIPBYTECOUNTS:
+    case TIFFTAG_XRESOLUTION:
+    case TIFFTAG_YRESOLUTION:
+    case TIFFTAG_PLANARCONFIG:
+    case TIFFTAG_RESOLUTIONUNIT:
+    case TIFFTAG_PREDICTOR:
+    case TIFFTAG_TILEWIDTH:
+    case TIFFTAG_TILELENGTH:
+    case TIFFTAG_TILEOFFSETS:
+    case TIFFTAG_TILEBYTECOUNTS:
+    case TIFFTAG_SUBIFD:
+    case TIFFTAG_SAMPLEFORMAT:
+    case TIFFTAG_JPEGIFOFFSET:
+    case TIFFTAG_JPEGIFBYTECOUNT:
+    case TIFFTAG_XMLPACKET:
+    case TIFFTAG_PHOTOSHOP:
+    case TIFFTAG_ICCPROFILE:
+    case TIFFTAG_EXIFIFD:
+    case TIFFTAG_GPSIFD:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+// copies the entries of the directory at ifd into the current directory of tif. returns FALSE if some entry
+// couldn't be copied.
+static gboolean _exif_set_ifd(TIFF *tif, const dt_imageio_tiff_t *d, const _exif_blob_t *b, const uint32_t ifd,
+                              const gboolean image_ifd)
+{
+  gboolean complete = TRUE;
+  const int entries = _exif_get(b, ifd, 2);
+  for(int k = 0; k < entries; k++)
+  {
+    const size_t entry = ifd + 2 + (size_t)12 * k;
+    const uint32_t tag = _exif_get(b, entry, 2);
+    // the structure of the image directory is ours
+    if(image_ifd && _exif_structural_tag(tag)) continue;
+    // only compressed images may set PixelXDimension and PixelYDimension, exiv2 drops them as well
+    if(!image_ifd && !d->compress && (tag == EXIFTAG_PIXELXDIMENSION || tag == EXIFTAG_PIXELYDIMENSION))
+      continue;
+    if(!_exif_set_entry(tif, b, entry)) complete = FALSE;
+  }
+  return complete;
+}
+
+// writes the exif and gps directories after the image directory is done and points the latter to them.
+// clears *complete if some entry couldn't be copied.
+static int _write_exif_directories(TIFF *tif, const dt_imageio_tiff_t *d, const _exif_blob_t *b,
+                                   const uint32_t exif_ifd, const uint32_t gps_ifd, gboolean *complete)
+{
+  uint64_t exif_offset = 0, gps_offset = 0;
+  if(!TIFFWriteDirectory(tif)) return 1;
+
+  if(exif_ifd)
+  {
+    if(TIFFCreateEXIFDirectory(tif)) return 1;
+    if(!_exif_set_ifd(tif, d, b, exif_ifd, FALSE)) *complete = FALSE;
+    if(!TIFFWriteCustomDirectory(tif, &exif_offset)) return 1;
+  }
+#if TIFFLIB_VERSION >= 20191103
+  if(gps_ifd)
+  {
+    if(TIFFCreateGPSDirectory(tif)) return 1;
+    if(!_exif_set_ifd(tif, d, b, gps_ifd, FALSE)) *complete = FALSE;
+    if(!TIFFWriteCustomDirectory(tif, &gps_offset)) return 1;
+  }
+#else
+  if(gps_ifd) *complete = FALSE;
+#endif
+
+  if(!TIFFSetDirectory(tif, 0)) return 1;
+  if(exif_offset) TIFFSetField(tif, TIFFTAG_EXIFIFD, exif_offset);
+  if(gps_offset) TIFFSetField(tif, TIFFTAG_GPSIFD, gps_offset);
+  return !TIFFRewriteDirectory(tif);
+}
+
+int set_metadata(dt_imageio_module_data_t *d_tmp, const dt_exif_blobs_t *blobs)
+{
+  dt_imageio_tiff_t *d = (dt_imageio_tiff_t *)d_tmp;
+  d->metadata = NULL;
+  if(!blobs) return 0;
+
+  // leave exif we can't take apart to exiv2
+  _exif_blob_t exif;
+  if(blobs->exif_len && (!_exif_open(&exif, blobs->exif, blobs->exif_len) || !_exif_first_ifd(&exif))) return 1;
+
+  d->metadata = blobs;
+  return 0;
+}
+
 int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const void *in_void,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, dt_dev_pixelpipe_t *pipe)
@@ -61,7 +543,11 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
 
   TIFF *tif = NULL;
 
-  void *rowdata = NULL;
+  uint16_t predictor = PREDICTOR_NONE;
+
+  // metadata prepared up front goes right into the file
+  const dt_exif_blobs_t *m = d->metadata;
+  gboolean exif_complete = TRUE;
 
   int rc = 1; // default to error
 
@@ -104,23 +590,23 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   // http://www.awaresystems.be/imaging/tiff/tifftags/predictor.html
   if(d->compress == 1)
   {
+    predictor = PREDICTOR_NONE;
     TIFFSetField(tif, TIFFTAG_COMPRESSION, (uint16_t)COMPRESSION_ADOBE_DEFLATE);
-    TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)PREDICTOR_NONE);
+    TIFFSetField(tif, TIFFTAG_PREDICTOR, predictor);
     TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
   }
   else if(d->compress == 2)
   {
+    predictor = PREDICTOR_HORIZONTAL;
     TIFFSetField(tif, TIFFTAG_COMPRESSION, (uint16_t)COMPRESSION_ADOBE_DEFLATE);
-    TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)PREDICTOR_HORIZONTAL);
+    TIFFSetField(tif, TIFFTAG_PREDICTOR, predictor);
     TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
   }
   else if(d->compress == 3)
   {
+    predictor = d->bpp == 32 ? PREDICTOR_FLOATINGPOINT : PREDICTOR_HORIZONTAL;
     TIFFSetField(tif, TIFFTAG_COMPRESSION, (uint16_t)COMPRESSION_ADOBE_DEFLATE);
-    if(d->bpp == 32)
-      TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)PREDICTOR_FLOATINGPOINT);
-    else
-      TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)PREDICTOR_HORIZONTAL);
+    TIFFSetField(tif, TIFFTAG_PREDICTOR, predictor);
     TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
   }
   else // (d->compress == 0)
@@ -140,7 +626,9 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   TIFFSetField(tif, TIFFTAG_IMAGELENGTH, (uint32_t)d->global.height);
   TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, (uint16_t)PHOTOMETRIC_RGB);
   TIFFSetField(tif, TIFFTAG_PLANARCONFIG, (uint16_t)PLANARCONFIG_CONTIG);
-  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, (uint32_t)1);
+  const size_t rowsize = (size_t)3 * d->global.width * d->bpp / 8;
+  const int rows_per_strip = CLAMP(DT_TIFF_STRIP_SIZE / rowsize, 1, MAX(d->global.height, 1));
+  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, (uint32_t)rows_per_strip);
   TIFFSetField(tif, TIFFTAG_ORIENTATION, (uint16_t)ORIENTATION_TOPLEFT);
 
   int resolution = dt_conf_get_int("metadata/resolution");
@@ -151,69 +639,34 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
     TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, (uint16_t)RESUNIT_INCH);
   }
 
-  const size_t rowsize = (d->global.width * 3) * d->bpp / 8;
-  if((rowdata = malloc(rowsize)) == NULL)
+  _exif_blob_t exif_blob = { 0 };
+  uint32_t exif_ifd = 0, gps_ifd = 0;
+  if(m)
   {
-    rc = 1;
-    goto exit;
-  }
-
-  if(d->bpp == 32)
-  {
-    for(int y = 0; y < d->global.height; y++)
+    if(m->xmp_len) TIFFSetField(tif, TIFFTAG_XMLPACKET, (uint32_t)m->xmp_len, m->xmp);
+    if(m->iptc_len) TIFFSetField(tif, TIFFTAG_PHOTOSHOP, (uint32_t)m->iptc_len, m->iptc);
+    if(m->exif_len && _exif_open(&exif_blob, m->exif, m->exif_len))
     {
-      float *in = (float *)in_void + (size_t)4 * y * d->global.width;
-      float *out = (float *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += 3)
-      {
-        memcpy(out, in, 3 * sizeof(float));
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
+      const uint32_t ifd = _exif_first_ifd(&exif_blob);
+      if(ifd)
       {
-        rc = 1;
-        goto exit;
+        exif_complete = _exif_set_ifd(tif, d, &exif_blob, ifd, TRUE);
+        exif_ifd = _exif_find(&exif_blob, ifd, TIFFTAG_EXIFIFD);
+        gps_ifd = _exif_find(&exif_blob, ifd, TIFFTAG_GPSIFD);
       }
     }
   }
-  else if(d->bpp == 16)
-  {
-    for(int y = 0; y < d->global.height; y++)
-    {
-      uint16_t *in = (uint16_t *)in_void + (size_t)4 * y * d->global.width;
-      uint16_t *out = (uint16_t *)rowdata;
 
-      for(int x = 0; x < d->global.width; x++, in += 4, out += 3)
-      {
-        memcpy(out, in, 3 * sizeof(uint16_t));
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
-  }
-  else
+  if(_write_strips(tif, d, in_void, predictor, rows_per_strip))
   {
-    for(int y = 0; y < d->global.height; y++)
-    {
-      uint8_t *in = (uint8_t *)in_void + (size_t)4 * y * d->global.width;
-      uint8_t *out = (uint8_t *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += 3)
-      {
-        memcpy(out, in, 3 * sizeof(uint8_t));
-      }
+    rc = 1;
+    goto exit;
+  }
 
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
+  if((exif_ifd || gps_ifd) && _write_exif_directories(tif, d, &exif_blob, exif_ifd, gps_ifd, &exif_complete))
+  {
+    rc = 1;
+    goto exit;
   }
 
   // success
@@ -226,6 +679,12 @@ exit:
     TIFFClose(tif);
     tif = NULL;
   }
+  // exif which libtiff didn't fully take is merged by exiv2, with the xmp and iptc already in the file
+  if(!rc && m && m->exif_len && !exif_complete)
+  {
+    exif = m->exif;
+    exif_len = m->exif_len;
+  }
   if(!rc && exif)
   {
     rc = dt_exif_write_blob(exif, exif_len, filename, d->compress > 0);
@@ -234,8 +693,6 @@ exit:
   }
   free(profile);
   profile = NULL;
-  free(rowdata);
-  rowdata = NULL;
 
   return rc;
 }
@@ -261,7 +718,7 @@ int dt_imageio_tiff_read(dt_imageio_tiff_t *tiff, uint8_t *out)
 
 size_t params_size(dt_imageio_module_format_t *self)
 {
-  return sizeof(dt_imageio_tiff_t) - sizeof(TIFF *);
+  return offsetof(dt_imageio_tiff_t, handle);
 }
 
 void *legacy_params(dt_imageio_module_format_t *self, const void *const old_params,
@@ -92,7 +92,7 @@ const char *name()
 
 int flags()
 {
-  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING;
+  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_FUSIBLE;
 }
 
 int default_group()
@@ -186,6 +186,27 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   }
 }
 
+void process_pixels(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const float *const in,
+                    float *const out, const size_t npixels)
+{
+  const dt_iop_colorcontrast_params_t *const d = (dt_iop_colorcontrast_params_t *)piece->data;
+  const float a_steepness = d->a_steepness, a_offset = d->a_offset;
+  const float b_steepness = d->b_steepness, b_offset = d->b_offset;
+  const float lo = d->unbound ? -INFINITY : -128.0f;
+  const float hi = d->unbound ? INFINITY : 128.0f;
+
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+  for(size_t k = 0; k < 4 * npixels; k += 4)
+  {
+    out[k] = in[k];
+    out[k + 1] = CLAMP((in[k + 1] * a_steepness) + a_offset, lo, hi);
+    out[k + 2] = CLAMP((in[k + 2] * b_steepness) + b_offset, lo, hi);
+    out[k + 3] = in[k + 3];
+  }
+}
+
 #if defined(__SSE__)
 void process_sse2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
                   void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
@@ -542,8 +542,6 @@ void init_presets(dt_iop_module_so_t *self)
   p.strength = 0.0;
   p.mode = DT_IOP_COLORZONES_MODE_SMOOTH;
 
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "BEGIN", NULL, NULL, NULL);
-
   // red black white
   p.channel = DT_IOP_COLORZONES_h;
   for(int k = 0; k < DT_IOP_COLORZONES_BANDS; k++)
@@ -662,8 +660,6 @@ void init_presets(dt_iop_module_so_t *self)
     p.curve_type[c] = CATMULL_ROM;
   }
   dt_gui_presets_add_generic(_("black & white film"), self->op, version, &p, sizeof(p), 1);
-
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
 }
 
 static void _reset_display_selection(dt_iop_module_t *self)
@@ -3164,29 +3164,7 @@ void cleanup_global(dt_iop_module_so_t *module)
 
 static dt_noiseprofile_t dt_iop_denoiseprofile_get_auto_profile(dt_iop_module_t *self)
 {
-  GList *profiles = dt_noiseprofile_get_matching(&self->dev->image_storage);
-  dt_noiseprofile_t interpolated = dt_noiseprofile_generic; // default to generic poissonian
-
-  const int iso = self->dev->image_storage.exif_iso;
-  dt_noiseprofile_t *last = NULL;
-  for(GList *iter = profiles; iter; iter = g_list_next(iter))
-  {
-    dt_noiseprofile_t *current = (dt_noiseprofile_t *)iter->data;
-    if(current->iso == iso)
-    {
-      interpolated = *current;
-      break;
-    }
-    if(last && last->iso < iso && current->iso > iso)
-    {
-      interpolated.iso = iso;
-      dt_noiseprofile_interpolate(last, current, &interpolated);
-      break;
-    }
-    last = current;
-  }
-  g_list_free_full(profiles, dt_noiseprofile_free);
-  return interpolated;
+  return dt_noiseprofile_get_auto(&self->dev->image_storage);
 }
 
 /** commit is the synch point between core and gui, so it copies params to pipe data. */
@@ -202,6 +202,13 @@ int process_tiling_cl(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_
                       const struct dt_iop_roi_t *const roi_out, const int bpp);
 #endif
 
+/** fused per-pixel processing, only used for modules flagged IOP_FLAGS_FUSIBLE. */
+/** called once per pixelpipe run before any process_pixels() call on this piece. */
+void process_pixels_prepare(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece);
+/** process npixels consecutive 4-channel float pixels, in may be equal to out. must be reentrant. */
+void process_pixels(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const float *const in,
+                    float *const out, const size_t npixels);
+
 /** this functions are used for distort iop
  * points is an array of float {x1,y1,x2,y2,...}
  * size is 2*points_count */
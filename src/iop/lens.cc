@@ -26,6 +26,7 @@ extern "C" {
 #include "common/interpolation.h"
 #include "common/file_location.h"
 #include "common/opencl.h"
+#include "control/conf.h"
 #include "control/control.h"
 #include "develop/develop.h"
 #include "develop/imageop.h"
@@ -125,6 +126,30 @@ typedef struct dt_iop_lensfun_global_data_t
   int kernel_lens_vignette;
 } dt_iop_lensfun_global_data_t;
 
+// number of modifiers kept per piece: process, distort_mask and the point transforms use different sizes
+#define DT_IOP_LENSFUN_CACHED_MODIFIERS 4
+// node spacing of the coordinate grid in pixels, refined from max to min until the error bound holds
+#define DT_IOP_LENSFUN_GRID_STEP_MAX 32
+#define DT_IOP_LENSFUN_GRID_STEP_MIN 8
+
+typedef struct dt_iop_lensfun_grid_t
+{
+  int step;          // node spacing in pixels, 0 if the coordinates have to be computed exactly
+  int width, height; // number of nodes
+  float *nodes;      // distorted (x, y) for r, g and b per node, as ApplySubpixelGeometryDistortion()
+} dt_iop_lensfun_grid_t;
+
+typedef struct dt_iop_lensfun_cached_t
+{
+  lfModifier *modifier;
+  int w, h, filter, modflags;
+  int users;
+  uint64_t used;
+  gboolean detached; // dropped from the cache while still in use, freed by the last user
+  int grid_state;    // 0: not built yet, 1: being built by one user, 2: done
+  dt_iop_lensfun_grid_t grid;
+} dt_iop_lensfun_cached_t;
+
 typedef struct dt_iop_lensfun_data_t
 {
   lfLens *lens;
@@ -139,6 +164,12 @@ typedef struct dt_iop_lensfun_data_t
   gboolean do_nan_checks;
   gboolean tca_override;
   lfLensCalibTCA custom_tca;
+  // modifiers and coordinate grids built from the parameters above, dropped in commit_params()
+  dt_pthread_mutex_t cache_lock;
+  pthread_cond_t grid_cond; // signalled under cache_lock when a grid is done
+  dt_iop_lensfun_cached_t *cache[DT_IOP_LENSFUN_CACHED_MODIFIERS];
+  uint64_t cache_clock;
+  float grid_max_error;
 } dt_iop_lensfun_data_t;
 
 
@@ -378,10 +409,226 @@ static lfModifier * get_modifier(int *mods_done, int w, int h, const dt_iop_lens
   return mod;
 }
 
+static void _cached_free(dt_iop_lensfun_cached_t *cached)
+{
+  delete cached->modifier;
+  dt_free_align(cached->grid.nodes);
+  free(cached);
+}
+
+// samples the distortion on a grid of nodes step pixels apart. the grid is accepted if bilinear
+// interpolation reproduces the exact coordinates at all cell centres within max_error, otherwise
+// it is refined, down to DT_IOP_LENSFUN_GRID_STEP_MIN. only reads the parts of cached which don't change after
+// it was created, so it runs without holding the cache lock.
+static void _build_grid(const dt_iop_lensfun_cached_t *cached, dt_iop_lensfun_grid_t *const grid,
+                        const float max_error)
+{
+  const lfModifier *const modifier = cached->modifier;
+  grid->step = 0;
+
+  if(max_error <= 0.0f
+     || !(cached->modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE)))
+    return;
+
+  for(int step = DT_IOP_LENSFUN_GRID_STEP_MAX; step >= DT_IOP_LENSFUN_GRID_STEP_MIN; step /= 2)
+  {
+    // one node beyond the last pixel, so every pixel has all four neighbours
+    const int gw = cached->w / step + 2;
+    const int gh = cached->h / step + 2;
+    float *const nodes = (float *)dt_alloc_align(64, sizeof(float) * 6 * gw * gh);
+    if(!nodes) return;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(gh, gw, modifier, nodes, step) \
+    schedule(static)
+#endif
+    for(int j = 0; j < gh; j++)
+      for(int i = 0; i < gw; i++)
+        modifier->ApplySubpixelGeometryDistortion(i * step, j * step, 1, 1, nodes + 6 * ((size_t)j * gw + i));
+
+    float err = 0.0f;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(gh, gw, modifier, nodes, step) \
+    reduction(max : err) \
+    schedule(static)
+#endif
+    for(int j = 0; j < gh - 1; j++)
+      for(int i = 0; i < gw - 1; i++)
+      {
+        float exact[6];
+        modifier->ApplySubpixelGeometryDistortion((i + 0.5f) * step, (j + 0.5f) * step, 1, 1, exact);
+        const float *const n00 = nodes + 6 * ((size_t)j * gw + i);
+        const float *const n10 = n00 + 6 * gw;
+        for(int c = 0; c < 6; c++)
+        {
+          const float e = fabsf(0.25f * (n00[c] + n00[c + 6] + n10[c] + n10[c + 6]) - exact[c]);
+          // nan coordinates would bleed into valid neighbours, so these have to stay exact
+          err = isfinite(e) ? fmaxf(err, e) : INFINITY;
+        }
+      }
+
+    if(err <= max_error)
+    {
+      grid->step = step;
+      grid->width = gw;
+      grid->height = gh;
+      grid->nodes = nodes;
+      return;
+    }
+    dt_free_align(nodes);
+  }
+}
+
+// returns a modifier for the given size from the piece's cache, creating it if needed.
+// it stays valid until handed back with _release_modifier().
+static dt_iop_lensfun_cached_t *_acquire_modifier(dt_iop_lensfun_data_t *d, int w, int h, int mods_filter,
+                                                  const gboolean want_grid)
+{
+  dt_pthread_mutex_lock(&d->cache_lock);
+
+  dt_iop_lensfun_cached_t *cached = NULL;
+  int slot = 0;
+  for(int k = 0; k < DT_IOP_LENSFUN_CACHED_MODIFIERS; k++)
+  {
+    dt_iop_lensfun_cached_t *c = d->cache[k];
+    if(c && c->w == w && c->h == h && c->filter == mods_filter)
+    {
+      cached = c;
+      break;
+    }
+    // remember a free slot or else the least recently used one
+    if(d->cache[slot] && (!c || c->used < d->cache[slot]->used)) slot = k;
+  }
+
+  if(!cached)
+  {
+    cached = (dt_iop_lensfun_cached_t *)calloc(1, sizeof(dt_iop_lensfun_cached_t));
+    cached->w = w;
+    cached->h = h;
+    cached->filter = mods_filter;
+    dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
+    cached->modifier = get_modifier(&cached->modflags, w, h, d, mods_filter);
+    dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+
+    dt_iop_lensfun_cached_t *old = d->cache[slot];
+    if(old)
+    {
+      old->detached = TRUE;
+      if(old->users == 0) _cached_free(old);
+    }
+    d->cache[slot] = cached;
+  }
+
+  cached->users++;
+  cached->used = ++d->cache_clock;
+
+  // the first user builds the grid without the lock, so pipes using other modifiers don't wait for it. other
+  // users of this one wait until it is published. holding a use keeps cached alive meanwhile.
+  while(want_grid && cached->grid_state == 1) dt_pthread_cond_wait(&d->grid_cond, &d->cache_lock);
+  if(want_grid && cached->grid_state == 0)
+  {
+    cached->grid_state = 1;
+    dt_pthread_mutex_unlock(&d->cache_lock);
+
+    dt_iop_lensfun_grid_t grid = { 0 };
+    _build_grid(cached, &grid, d->grid_max_error);
+
+    dt_pthread_mutex_lock(&d->cache_lock);
+    cached->grid = grid;
+    cached->grid_state = 2;
+    pthread_cond_broadcast(&d->grid_cond);
+  }
+
+  dt_pthread_mutex_unlock(&d->cache_lock);
+  return cached;
+}
+
+static void _release_modifier(dt_iop_lensfun_data_t *d, dt_iop_lensfun_cached_t *cached)
+{
+  dt_pthread_mutex_lock(&d->cache_lock);
+  if(--cached->users == 0 && cached->detached) _cached_free(cached);
+  dt_pthread_mutex_unlock(&d->cache_lock);
+}
+
+static void _flush_modifiers(dt_iop_lensfun_data_t *d)
+{
+  dt_pthread_mutex_lock(&d->cache_lock);
+  for(int k = 0; k < DT_IOP_LENSFUN_CACHED_MODIFIERS; k++)
+  {
+    dt_iop_lensfun_cached_t *cached = d->cache[k];
+    if(!cached) continue;
+    cached->detached = TRUE;
+    if(cached->users == 0) _cached_free(cached);
+    d->cache[k] = NULL;
+  }
+  dt_pthread_mutex_unlock(&d->cache_lock);
+}
+
+// distorted coordinates of width pixels starting at (x, y), bilinearly from the grid where it covers them
+static inline void _distort_row(const dt_iop_lensfun_cached_t *const cached, const int x, const int y,
+                                const int width, float *const out)
+{
+  const dt_iop_lensfun_grid_t *const grid = &cached->grid;
+  const int step = grid->step;
+
+  if(!step || x < 0 || y < 0 || x + width > (grid->width - 1) * step || y >= (grid->height - 1) * step)
+  {
+    cached->modifier->ApplySubpixelGeometryDistortion(x, y, width, 1, out);
+    return;
+  }
+
+  const float inv_step = 1.0f / step;
+  const int j = y / step;
+  const float fy = (y - j * step) * inv_step;
+  const float *const row0 = grid->nodes + (size_t)6 * j * grid->width;
+  const float *const row1 = row0 + (size_t)6 * grid->width;
+
+  for(int k = 0; k < width; k++)
+  {
+    const int i = (x + k) / step;
+    const float fx = (x + k - i * step) * inv_step;
+    const float *const n00 = row0 + 6 * i;
+    const float *const n10 = row1 + 6 * i;
+    float *const o = out + 6 * k;
+    for(int c = 0; c < 6; c++)
+    {
+      const float top = n00[c] + fx * (n00[c + 6] - n00[c]);
+      const float bottom = n10[c] + fx * (n10[c + 6] - n10[c]);
+      o[c] = top + fy * (bottom - top);
+    }
+  }
+}
+
+static inline void _distort_point(const dt_iop_lensfun_cached_t *const cached, const float x, const float y,
+                                  float *const out)
+{
+  const dt_iop_lensfun_grid_t *const grid = &cached->grid;
+  const int step = grid->step;
+
+  if(!step || !(x >= 0.0f && y >= 0.0f && x < (grid->width - 1) * step && y < (grid->height - 1) * step))
+  {
+    cached->modifier->ApplySubpixelGeometryDistortion(x, y, 1, 1, out);
+    return;
+  }
+
+  const int i = x / step, j = y / step;
+  const float fx = x / step - i, fy = y / step - j;
+  const float *const n00 = grid->nodes + (size_t)6 * ((size_t)j * grid->width + i);
+  const float *const n10 = n00 + (size_t)6 * grid->width;
+  for(int c = 0; c < 6; c++)
+  {
+    const float top = n00[c] + fx * (n00[c + 6] - n00[c]);
+    const float bottom = n10[c] + fx * (n10[c + 6] - n10[c]);
+    out[c] = top + fy * (bottom - top);
+  }
+}
+
 void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid, void *const ovoid,
              const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
-  const dt_iop_lensfun_data_t *const d = (dt_iop_lensfun_data_t *)piece->data;
+  dt_iop_lensfun_data_t *const d = (dt_iop_lensfun_data_t *)piece->data;
   dt_iop_lensfun_gui_data_t *g = (dt_iop_lensfun_gui_data_t *)self->gui_data;
 
   const int ch = piece->colors;
@@ -398,12 +645,9 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
 
   const float orig_w = roi_in->scale * piece->buf_in.width, orig_h = roi_in->scale * piece->buf_in.height;
 
-  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
-
-  int modflags;
-  lfModifier *modifier = get_modifier(&modflags, orig_w, orig_h, d, LF_MODIFY_ALL);
-
-  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+  dt_iop_lensfun_cached_t *const cached = _acquire_modifier(d, orig_w, orig_h, LF_MODIFY_ALL, TRUE);
+  const lfModifier *const modifier = cached->modifier;
+  const int modflags = cached->modflags;
 
   const struct dt_interpolation *const interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
 
@@ -420,13 +664,13 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
 #pragma omp parallel for default(none) \
       dt_omp_firstprivate(bufsize, ch, ch_width, d, interpolation, ivoid, \
                           mask_display, ovoid, roi_in, roi_out) \
-      shared(buf, modifier) \
+      shared(buf, cached) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_out->height; y++)
       {
         float *bufptr = ((float *)buf) + (size_t)bufsize * dt_get_thread_num();
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width, 1, bufptr);
+        _distort_row(cached, roi_out->x, roi_out->y + y, roi_out->width, bufptr);
 
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
@@ -523,14 +767,13 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
       dt_omp_firstprivate(buf2size, ch, ch_width, d, interpolation, mask_display, ovoid, roi_in, roi_out) \
-      shared(buf2, buf, modifier) \
+      shared(buf2, buf, cached) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_out->height; y++)
       {
         float *buf2ptr = ((float *)buf2) + (size_t)buf2size * dt_get_thread_num();
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width,
-                                                  1, buf2ptr);
+        _distort_row(cached, roi_out->x, roi_out->y + y, roi_out->width, buf2ptr);
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
         for(int x = 0; x < roi_out->width; x++, buf2ptr += 6, out += ch)
@@ -575,7 +818,7 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
     }
     dt_free_align(buf);
   }
-  delete modifier;
+  _release_modifier(d, cached);
 
   if(self->dev->gui_attached && g && piece->pipe->type == DT_DEV_PIXELPIPE_PREVIEW)
   {
@@ -598,7 +841,8 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
   cl_int err = -999;
 
   float *tmpbuf = NULL;
-  lfModifier *modifier = NULL;
+  dt_iop_lensfun_cached_t *cached = NULL;
+  const lfModifier *modifier = NULL;
 
   const int devid = piece->pipe->devid;
   const int iwidth = roi_in->width;
@@ -624,7 +868,7 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
   size_t isizes[] = { (size_t)ROUNDUPWD(iwidth), (size_t)ROUNDUPHT(iheight), 1 };
   size_t osizes[] = { (size_t)ROUNDUPWD(owidth), (size_t)ROUNDUPHT(oheight), 1 };
 
-  int modflags;
+  int modflags = 0;
   int ldkernel = -1;
   const struct dt_interpolation *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
 
@@ -662,9 +906,9 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
   dev_tmpbuf = (cl_mem)dt_opencl_alloc_device_buffer(devid, tmpbuflen);
   if(dev_tmpbuf == NULL) goto error;
 
-  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
-  modifier = get_modifier(&modflags, orig_w, orig_h, d, LF_MODIFY_ALL);
-  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+  cached = _acquire_modifier(d, orig_w, orig_h, LF_MODIFY_ALL, TRUE);
+  modifier = cached->modifier;
+  modflags = cached->modflags;
 
   if(d->inverse)
   {
@@ -674,13 +918,13 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
       dt_omp_firstprivate(tmpbufwidth, roi_out) \
-      shared(tmpbuf, d, modifier) \
+      shared(tmpbuf, d, cached) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width, 1, pi);
+        _distort_row(cached, roi_out->x, roi_out->y + y, roi_out->width, pi);
       }
 
       /* _blocking_ memory transfer: host tmpbuf buffer -> opencl dev_tmpbuf */
@@ -791,13 +1035,13 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
       dt_omp_firstprivate(tmpbufwidth, roi_out) \
-      shared(tmpbuf, d, modifier) \
+      shared(tmpbuf, d, cached) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width, 1, pi);
+        _distort_row(cached, roi_out->x, roi_out->y + y, roi_out->width, pi);
       }
 
       /* _blocking_ memory transfer: host tmpbuf buffer -> opencl dev_tmpbuf */
@@ -835,14 +1079,14 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
   dt_opencl_release_mem_object(dev_tmpbuf);
   dt_opencl_release_mem_object(dev_tmp);
   if(tmpbuf != NULL) dt_free_align(tmpbuf);
-  if(modifier != NULL) delete modifier;
+  if(cached != NULL) _release_modifier(d, cached);
   return TRUE;
 
 error:
   dt_opencl_release_mem_object(dev_tmp);
   dt_opencl_release_mem_object(dev_tmpbuf);
   if(tmpbuf != NULL) dt_free_align(tmpbuf);
-  if(modifier != NULL) delete modifier;
+  if(cached != NULL) _release_modifier(d, cached);
   dt_print(DT_DEBUG_OPENCL, "[opencl_lens] couldn't enqueue kernel! %d\n", err);
   return FALSE;
 }
@@ -873,12 +1117,11 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
   if(!d->lens || !d->lens->Maker || d->crop <= 0.0f) return 0;
 
   const float orig_w = piece->buf_in.width, orig_h = piece->buf_in.height;
-  int modflags;
-  const lfModifier *modifier = get_modifier(&modflags, orig_w, orig_h, d, LF_MODIFY_ALL);
+  dt_iop_lensfun_cached_t *const cached = _acquire_modifier(d, orig_w, orig_h, LF_MODIFY_ALL, TRUE);
 
-  if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+  if(cached->modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
   {
-    float *buf = (float *)malloc(2 * 3 * sizeof(float));
+    float buf[6];
     for(size_t i = 0; i < points_count * 2; i += 2)
     {
       float p1 = points[i];
@@ -887,7 +1130,7 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
       // often after 2 or 3 loops.
       for(int k=0; k<10; k++)
       {
-        modifier->ApplySubpixelGeometryDistortion(p1, p2, 1, 1, buf);
+        _distort_point(cached, p1, p2, buf);
         const float dist1 = points[i]     - buf[0];
         const float dist2 = points[i + 1] - buf[3];
         if(fabs(dist1) < .5f && fabs(dist2) < .5f) break; // we have converged
@@ -898,10 +1141,9 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
       points[i]     = p1;
       points[i + 1] = p2;
     }
-    free(buf);
   }
 
-  delete modifier;
+  _release_modifier(d, cached);
   return 1;
 }
 
@@ -913,22 +1155,20 @@ int distort_backtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
   if(!d->lens || !d->lens->Maker || d->crop <= 0.0f) return 0;
 
   const float orig_w = piece->buf_in.width, orig_h = piece->buf_in.height;
-  int modflags;
-  const lfModifier *modifier = get_modifier(&modflags, orig_w, orig_h, d, LF_MODIFY_ALL);
+  dt_iop_lensfun_cached_t *const cached = _acquire_modifier(d, orig_w, orig_h, LF_MODIFY_ALL, TRUE);
 
-  if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+  if(cached->modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
   {
-    float *buf = (float *)malloc(2 * 3 * sizeof(float));
+    float buf[6];
     for(size_t i = 0; i < points_count * 2; i += 2)
     {
-      modifier->ApplySubpixelGeometryDistortion(points[i], points[i + 1], 1, 1, buf);
+      _distort_point(cached, points[i], points[i + 1], buf);
       points[i] = buf[0];
       points[i + 1] = buf[3];
     }
-    free(buf);
   }
 
-  delete modifier;
+  _release_modifier(d, cached);
   return 1;
 }
 
@@ -936,7 +1176,7 @@ int distort_backtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
 void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const float *const in,
                   float *const out, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
-  const dt_iop_lensfun_data_t *const d = (dt_iop_lensfun_data_t *)piece->data;
+  dt_iop_lensfun_data_t *const d = (dt_iop_lensfun_data_t *)piece->data;
 
   if(!d->lens || !d->lens->Maker || d->crop <= 0.0f)
   {
@@ -945,16 +1185,13 @@ void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
   }
 
   const float orig_w = roi_in->scale * piece->buf_in.width, orig_h = roi_in->scale * piece->buf_in.height;
-  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
-  int modflags;
-  lfModifier *modifier = get_modifier(&modflags, orig_w, orig_h, d, /*LF_MODIFY_TCA |*/ LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE);
-
-  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+  dt_iop_lensfun_cached_t *const cached
+      = _acquire_modifier(d, orig_w, orig_h, /*LF_MODIFY_TCA |*/ LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE, TRUE);
 
-  if(!(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE)))
+  if(!(cached->modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE)))
   {
     memcpy(out, in, sizeof(float) * roi_out->width * roi_out->height);
-    delete modifier;
+    _release_modifier(d, cached);
     return;
   }
 
@@ -967,13 +1204,13 @@ void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
   dt_omp_firstprivate(bufsize, d, in, interpolation, out, roi_in, roi_out) \
-  shared(buf, modifier) \
+  shared(buf, cached) \
   schedule(static)
 #endif
   for(int y = 0; y < roi_out->height; y++)
   {
     float *bufptr = buf + bufsize * dt_get_thread_num();
-    modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width, 1, bufptr);
+    _distort_row(cached, roi_out->x, roi_out->y + y, roi_out->width, bufptr);
 
     // reverse transform the global coords from lf to our buffer
     float *_out = out + (size_t)y * roi_out->width;
@@ -993,7 +1230,7 @@ void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
     }
   }
   dt_free_align(buf);
-  delete modifier;
+  _release_modifier(d, cached);
 }
 
 void modify_roi_out(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, dt_iop_roi_t *roi_out,
@@ -1012,10 +1249,10 @@ void modify_roi_in(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *
   if(!d->lens || !d->lens->Maker || d->crop <= 0.0f) return;
 
   const float orig_w = roi_in->scale * piece->buf_in.width, orig_h = roi_in->scale * piece->buf_in.height;
-  int modflags;
-  lfModifier *modifier = get_modifier(&modflags, orig_w, orig_h, d, LF_MODIFY_ALL);
+  dt_iop_lensfun_cached_t *const cached = _acquire_modifier(d, orig_w, orig_h, LF_MODIFY_ALL, FALSE);
+  const lfModifier *const modifier = cached->modifier;
 
-  if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+  if(cached->modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
   {
     const int xoff = roi_in->x;
     const int yoff = roi_in->y;
@@ -1100,7 +1337,7 @@ void modify_roi_in(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *
     roi_in->width = CLAMP(roi_in->width, 1, (int)ceilf(orig_w) - roi_in->x);
     roi_in->height = CLAMP(roi_in->height, 1, (int)ceilf(orig_h) - roi_in->y);
   }
-  delete modifier;
+  _release_modifier(d, cached);
 }
 
 void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_t *pipe,
@@ -1124,6 +1361,9 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
   const lfCamera *camera = NULL;
   const lfCamera **cam = NULL;
 
+  _flush_modifiers(d);
+  d->grid_max_error = dt_conf_get_float("plugins/darkroom/lens/grid_max_error");
+
   if(d->lens)
   {
     delete d->lens;
@@ -1211,6 +1451,9 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
 void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
   piece->data = calloc(1, sizeof(dt_iop_lensfun_data_t));
+  dt_iop_lensfun_data_t *d = (dt_iop_lensfun_data_t *)piece->data;
+  dt_pthread_mutex_init(&d->cache_lock, NULL);
+  pthread_cond_init(&d->grid_cond, NULL);
   self->commit_params(self, self->default_params, pipe, piece);
 }
 
@@ -1218,6 +1461,9 @@ void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev
 {
   dt_iop_lensfun_data_t *d = (dt_iop_lensfun_data_t *)piece->data;
 
+  _flush_modifiers(d);
+  pthread_cond_destroy(&d->grid_cond);
+  dt_pthread_mutex_destroy(&d->cache_lock);
   if(d->lens)
   {
     delete d->lens;
@@ -954,7 +954,7 @@ static void prepare_matrices(dt_iop_module_t *module)
     return;
   }
 
-  char *camera = module->dev->image_storage.camera_makermodel;
+  const char *camera = module->dev->image_storage.camera_makermodel;
   if (!dt_colorspaces_conversion_matrices_xyz(camera, module->dev->image_storage.d65_color_matrix,
                                                       g->XYZ_to_CAM, g->CAM_to_XYZ))
   {
@@ -66,7 +66,7 @@ const char *name()
 
 int flags()
 {
-  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING;
+  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_FUSIBLE;
 }
 
 int default_group()
@@ -125,6 +125,24 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   }
 }
 
+void process_pixels(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const float *const in,
+                    float *const out, const size_t npixels)
+{
+  const dt_iop_vibrance_data_t *const d = (dt_iop_vibrance_data_t *)piece->data;
+  const float amount = (d->amount * 0.01);
+
+  for(size_t k = 0; k < 4 * npixels; k += 4)
+  {
+    /* saturation weight 0 - 1 */
+    const float sw = sqrtf((in[k + 1] * in[k + 1]) + (in[k + 2] * in[k + 2])) / 256.0f;
+    const float ls = 1.0f - ((amount * sw) * .25f);
+    const float ss = 1.0f + (amount * sw);
+    out[k + 0] = in[k + 0] * ls;
+    out[k + 1] = in[k + 1] * ss;
+    out[k + 2] = in[k + 2] * ss;
+    out[k + 3] = in[k + 3];
+  }
+}
 
 #ifdef HAVE_OPENCL
 int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_mem dev_in, cl_mem dev_out,
@@ -22,6 +22,7 @@
 #include "common/debug.h"
 #include "common/film.h"
 #include "common/metadata.h"
+#include "common/tags.h"
 #include "common/utility.h"
 #include "control/conf.h"
 #include "control/control.h"
@@ -49,6 +50,7 @@ typedef struct dt_lib_collect_rule_t
   GtkWidget *text;
   GtkWidget *button;
   gboolean typing;
+  GHashTable *matching; // tags matching the text, only while updating the visibility
 } dt_lib_collect_rule_t;
 
 typedef struct dt_lib_collect_t
@@ -62,6 +64,11 @@ typedef struct dt_lib_collect_t
 
   GtkTreeModel *treefilter;
   GtkTreeModel *listfilter;
+  GHashTable *folders;
+  GHashTable *filmrolls;   // film roll id -> dt_lib_collect_filmroll_t, the counts behind the folder tree
+  gchar *filmrolls_where;  // the extended where the film rolls were counted for, NULL to count all of them again
+  GVolumeMonitor *volumes;
+  gboolean folders_recheck; // drives were (un)mounted or the tree picked again, look at the existing rows too
   GtkScrolledWindow *scrolledwindow;
 
   GtkScrolledWindow *sw2;
@@ -326,9 +333,12 @@ error:
   g_free(new_path);
 }
 
+static void _folders_remove(dt_lib_collect_t *d, GtkTreeStore *store, GtkTreeIter *iter);
+
 static void view_popup_menu_onRemove(GtkWidget *menuitem, gpointer userdata)
 {
-  GtkTreeView *treeview = GTK_TREE_VIEW(userdata);
+  dt_lib_collect_t *d = (dt_lib_collect_t *)userdata;
+  GtkTreeView *treeview = d->view;
 
   GtkTreeSelection *selection;
   GtkTreeIter iter, model_iter;
@@ -355,8 +365,8 @@ static void view_popup_menu_onRemove(GtkWidget *menuitem, gpointer userdata)
     if (dt_control_remove_images())
     {
       gtk_tree_model_filter_convert_iter_to_child_iter(GTK_TREE_MODEL_FILTER(model), &model_iter, &iter);
-      gtk_tree_store_remove(GTK_TREE_STORE(gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model))),
-                            &model_iter);
+      _folders_remove(d, GTK_TREE_STORE(gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model))),
+                      &model_iter);
     }
 
     g_free(fullq);
@@ -375,7 +385,7 @@ static void view_popup_menu(GtkWidget *treeview, GdkEventButton *event, dt_lib_c
 
   menuitem = gtk_menu_item_new_with_label(_("remove..."));
   gtk_menu_shell_append(GTK_MENU_SHELL(menu), menuitem);
-  g_signal_connect(menuitem, "activate", (GCallback)view_popup_menu_onRemove, treeview);
+  g_signal_connect(menuitem, "activate", (GCallback)view_popup_menu_onRemove, d);
 
   gtk_widget_show_all(GTK_WIDGET(menu));
 
@@ -706,6 +716,11 @@ static gboolean tree_match_string(GtkTreeModel *model, GtkTreePath *path, GtkTre
   {
     visible = TRUE;
   }
+  else if(dr->matching)
+  {
+    // tag paths which aren't tags themselves are revealed by their children
+    visible = str && g_hash_table_contains(dr->matching, str);
+  }
   else
   {
     gchar *haystack = g_utf8_strdown(str, -1),
@@ -717,7 +732,8 @@ static gboolean tree_match_string(GtkTreeModel *model, GtkTreePath *path, GtkTre
 
   g_free(str);
 
-  gtk_tree_store_set(GTK_TREE_STORE(model), iter, DT_LIB_COLLECT_COL_VISIBLE, visible, -1);
+  if(visible != cur_state)
+    gtk_tree_store_set(GTK_TREE_STORE(model), iter, DT_LIB_COLLECT_COL_VISIBLE, visible, -1);
   return FALSE;
 }
 
@@ -741,7 +757,14 @@ static gboolean tree_reveal_func(GtkTreeModel *model, GtkTreePath *path, GtkTree
 
 static void tree_set_visibility(GtkTreeModel *model, gpointer data)
 {
+  dt_lib_collect_rule_t *dr = (dt_lib_collect_rule_t *)data;
+
+  // tags are looked up once in the tag index instead of comparing the text to every row
+  if(gtk_combo_box_get_active(dr->combo) == DT_COLLECTION_PROP_TAG)
+    dr->matching = dt_tag_index_find(gtk_entry_get_text(GTK_ENTRY(dr->text)), FALSE);
   gtk_tree_model_foreach(model, (GtkTreeModelForeachFunc)tree_match_string, data);
+  if(dr->matching) g_hash_table_destroy(dr->matching);
+  dr->matching = NULL;
 
   gtk_tree_model_foreach(model, (GtkTreeModelForeachFunc)tree_reveal_func, NULL);
 }
@@ -917,6 +940,312 @@ static gint sort_folder_tag(gconstpointer a, gconstpointer b)
   return g_strcmp0(tuple_a->collate_key, tuple_b->collate_key);
 }
 
+static char *folder_collate_key(const char *folder)
+{
+  char *name_folded = g_utf8_casefold(folder, -1);
+  char *name_folded_slash = g_strconcat(name_folded, G_DIR_SEPARATOR_S, NULL);
+  char *collate_key = g_utf8_collate_key_for_filename(name_folded_slash, -1);
+  g_free(name_folded_slash);
+  g_free(name_folded);
+  return collate_key;
+}
+
+// the rows of the folder tree by their path. tree store iters stay valid as long as their row exists, so once
+// the tree is built it can be patched with the film rolls and counts which changed instead of built again.
+typedef struct dt_lib_collect_folder_t
+{
+  GtkTreeIter iter;
+  char *collate_key; // only computed when a sibling has to be inserted next to it
+} dt_lib_collect_folder_t;
+
+static void _folder_free(gpointer data)
+{
+  dt_lib_collect_folder_t *folder = (dt_lib_collect_folder_t *)data;
+  g_free(folder->collate_key);
+  free(folder);
+}
+
+static dt_lib_collect_folder_t *_folders_add(dt_lib_collect_t *d, const char *path, GtkTreeIter *iter)
+{
+  dt_lib_collect_folder_t *folder = (dt_lib_collect_folder_t *)calloc(1, sizeof(dt_lib_collect_folder_t));
+  folder->iter = *iter;
+  g_hash_table_insert(d->folders, g_strdup(path), folder);
+  return folder;
+}
+
+static const char *_folders_key(dt_lib_collect_t *d, const char *path)
+{
+  dt_lib_collect_folder_t *folder = (dt_lib_collect_folder_t *)g_hash_table_lookup(d->folders, path);
+  if(!folder) return NULL;
+  if(!folder->collate_key) folder->collate_key = folder_collate_key(path);
+  return folder->collate_key;
+}
+
+// removes the row and all rows below it
+static void _folders_remove(dt_lib_collect_t *d, GtkTreeStore *store, GtkTreeIter *iter)
+{
+  gchar *path = NULL;
+  gtk_tree_model_get(GTK_TREE_MODEL(store), iter, DT_LIB_COLLECT_COL_PATH, &path, -1);
+  const size_t len = strlen(path);
+
+  GHashTableIter it;
+  gpointer key;
+  g_hash_table_iter_init(&it, d->folders);
+  while(g_hash_table_iter_next(&it, &key, NULL))
+  {
+    const char *folder = (const char *)key;
+    if(!strncmp(folder, path, len) && (folder[len] == '\0' || folder[len] == G_DIR_SEPARATOR))
+      g_hash_table_iter_remove(&it);
+  }
+  g_free(path);
+
+  gtk_tree_store_remove(store, iter);
+}
+
+static gint _sort_deepest_first(gconstpointer a, gconstpointer b)
+{
+  return (int)strlen(*(const char **)b) - (int)strlen(*(const char **)a);
+}
+
+// brings an existing folder tree in line with the (sorted) query result. only rows of folders which came or
+// went are inserted or removed and only changed counts are set, so for a large library a new or removed film
+// roll doesn't cost a rebuild of the whole tree with a stat() of every folder in it.
+static void _folders_update(dt_lib_collect_t *d, GtkTreeModel *model, GList *sorted_names)
+{
+  GtkTreeStore *store = GTK_TREE_STORE(model);
+
+  // all folders to show with their counts including the subfolders, parents before their children
+  GHashTable *wanted = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  GPtrArray *order = g_ptr_array_new();
+  for(GList *names = sorted_names; names; names = g_list_next(names))
+  {
+    const name_key_tuple_t *tuple = (const name_key_tuple_t *)names->data;
+    if(tuple->name == NULL) continue; // safeguard against degenerated db entries
+
+    char **tokens = split_path(tuple->name);
+    if(tokens == NULL) continue;
+
+    char *pth = NULL;
+#ifndef _WIN32
+    pth = g_strdup("/");
+#endif
+    for(char **token = tokens; *token; token++)
+    {
+      pth = dt_util_dstrcat(pth, "%s" G_DIR_SEPARATOR_S, *token);
+      gchar *path = g_strndup(pth, strlen(pth) - 1);
+      gpointer count = NULL;
+      // an existing entry keeps its key, the one passed in is freed
+      if(!g_hash_table_lookup_extended(wanted, path, NULL, &count)) g_ptr_array_add(order, path);
+      g_hash_table_insert(wanted, path, GINT_TO_POINTER(GPOINTER_TO_INT(count) + tuple->count));
+    }
+    g_free(pth);
+    g_strfreev(tokens);
+  }
+
+  // drop the folders which are gone, children first as a removed row takes its children with it
+  GPtrArray *gone = g_ptr_array_new_with_free_func(g_free);
+  GHashTableIter it;
+  gpointer key;
+  g_hash_table_iter_init(&it, d->folders);
+  while(g_hash_table_iter_next(&it, &key, NULL))
+    if(!g_hash_table_contains(wanted, key)) g_ptr_array_add(gone, g_strdup((const char *)key));
+  g_ptr_array_sort(gone, _sort_deepest_first);
+  for(guint k = 0; k < gone->len; k++)
+  {
+    dt_lib_collect_folder_t *folder = (dt_lib_collect_folder_t *)g_hash_table_lookup(d->folders, gone->pdata[k]);
+    gtk_tree_store_remove(store, &folder->iter);
+    g_hash_table_remove(d->folders, gone->pdata[k]);
+  }
+  g_ptr_array_free(gone, TRUE);
+
+  for(guint k = 0; k < order->len; k++)
+  {
+    const char *path = (const char *)order->pdata[k];
+    const guint count = GPOINTER_TO_INT(g_hash_table_lookup(wanted, path));
+    dt_lib_collect_folder_t *folder = (dt_lib_collect_folder_t *)g_hash_table_lookup(d->folders, path);
+
+    if(folder)
+    {
+      guint old_count;
+      gboolean visible;
+      gtk_tree_model_get(model, &folder->iter, DT_LIB_COLLECT_COL_COUNT, &old_count, DT_LIB_COLLECT_COL_VISIBLE,
+                         &visible, -1);
+      if(old_count != count || !visible)
+        gtk_tree_store_set(store, &folder->iter, DT_LIB_COLLECT_COL_COUNT, count, DT_LIB_COLLECT_COL_VISIBLE,
+                           TRUE, -1);
+      continue;
+    }
+
+    // a new folder, its parent is in place already
+    const char *sep = strrchr(path, G_DIR_SEPARATOR);
+    dt_lib_collect_folder_t *parent = NULL;
+    if(sep && sep != path)
+    {
+      gchar *parent_path = g_strndup(path, sep - path);
+      parent = (dt_lib_collect_folder_t *)g_hash_table_lookup(d->folders, parent_path);
+      g_free(parent_path);
+    }
+
+    // keep the siblings sorted
+    char *collate_key = folder_collate_key(path);
+    GtkTreeIter sibling;
+    gboolean before = FALSE;
+    if(gtk_tree_model_iter_children(model, &sibling, parent ? &parent->iter : NULL))
+    {
+      do
+      {
+        gchar *sibling_path = NULL;
+        gtk_tree_model_get(model, &sibling, DT_LIB_COLLECT_COL_PATH, &sibling_path, -1);
+        before = g_strcmp0(collate_key, _folders_key(d, sibling_path)) < 0;
+        g_free(sibling_path);
+      } while(!before && gtk_tree_model_iter_next(model, &sibling));
+    }
+
+    GtkTreeIter iter;
+    gtk_tree_store_insert_before(store, &iter, parent ? &parent->iter : NULL, before ? &sibling : NULL);
+    gtk_tree_store_set(store, &iter, DT_LIB_COLLECT_COL_TEXT, sep ? sep + 1 : path, DT_LIB_COLLECT_COL_PATH, path,
+                       DT_LIB_COLLECT_COL_VISIBLE, TRUE, DT_LIB_COLLECT_COL_COUNT, count,
+                       DT_LIB_COLLECT_COL_UNREACHABLE, !g_file_test(path, G_FILE_TEST_IS_DIR), -1);
+    _folders_add(d, path, &iter)->collate_key = collate_key;
+  }
+
+  g_ptr_array_free(order, TRUE);
+  g_hash_table_destroy(wanted);
+}
+
+// greys out the folders which can't be reached. a stat() for every row, so only done when drives were
+// (un)mounted or the folder tree was picked again, new rows are looked at when they are inserted.
+static void _folders_reachable(dt_lib_collect_t *d, GtkTreeModel *model)
+{
+  GHashTableIter it;
+  gpointer key, value;
+  g_hash_table_iter_init(&it, d->folders);
+  while(g_hash_table_iter_next(&it, &key, &value))
+  {
+    dt_lib_collect_folder_t *folder = (dt_lib_collect_folder_t *)value;
+    gboolean unreachable;
+    gtk_tree_model_get(model, &folder->iter, DT_LIB_COLLECT_COL_UNREACHABLE, &unreachable, -1);
+    const gboolean now = !g_file_test((const char *)key, G_FILE_TEST_IS_DIR);
+    if(now != unreachable)
+      gtk_tree_store_set(GTK_TREE_STORE(model), &folder->iter, DT_LIB_COLLECT_COL_UNREACHABLE, now, -1);
+  }
+  d->folders_recheck = FALSE;
+}
+
+// the images per film roll the folder tree is built from. they are kept between refreshes, the triggers on
+// main.images note the film rolls which got images added, removed or moved in memory.film_rolls_changed and
+// only those are counted again. all of them only when the other rules of the collection changed.
+typedef struct dt_lib_collect_filmroll_t
+{
+  char *folder;
+  int count;
+} dt_lib_collect_filmroll_t;
+
+static void _filmroll_free(gpointer data)
+{
+  dt_lib_collect_filmroll_t *filmroll = (dt_lib_collect_filmroll_t *)data;
+  g_free(filmroll->folder);
+  free(filmroll);
+}
+
+static void _filmrolls_set(dt_lib_collect_t *d, const int id, const char *folder, const int count)
+{
+  if(!folder || count <= 0)
+  {
+    g_hash_table_remove(d->filmrolls, GINT_TO_POINTER(id));
+    return;
+  }
+  dt_lib_collect_filmroll_t *filmroll = (dt_lib_collect_filmroll_t *)malloc(sizeof(dt_lib_collect_filmroll_t));
+  filmroll->folder = g_strdup(folder);
+  filmroll->count = count;
+  g_hash_table_insert(d->filmrolls, GINT_TO_POINTER(id), filmroll);
+}
+
+// returns TRUE if any count might have changed
+static gboolean _filmrolls_count(dt_lib_collect_t *d, const gchar *where_ext)
+{
+  sqlite3_stmt *stmt;
+  GList *changed = NULL;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT id FROM memory.film_rolls_changed", -1, &stmt,
+                              NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    changed = g_list_prepend(changed, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
+
+  // jobs keep adding to it meanwhile, so only what was read is taken out
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "DELETE FROM memory.film_rolls_changed WHERE id = ?1",
+                              -1, &stmt, NULL);
+  for(GList *l = changed; l; l = g_list_next(l))
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, GPOINTER_TO_INT(l->data));
+    sqlite3_step(stmt);
+    DT_DEBUG_SQLITE3_RESET(stmt);
+  }
+  sqlite3_finalize(stmt);
+
+  if(!d->filmrolls_where || strcmp(d->filmrolls_where, where_ext))
+  {
+    g_list_free(changed);
+    g_hash_table_remove_all(d->filmrolls);
+    gchar *query = g_strdup_printf("SELECT film_rolls_id, folder, COUNT(*) AS count FROM main.images AS mi "
+                                   "JOIN (SELECT id AS film_rolls_id, folder FROM main.film_rolls) "
+                                   "ON film_id = film_rolls_id WHERE %s GROUP BY film_rolls_id",
+                                   where_ext);
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+      _filmrolls_set(d, sqlite3_column_int(stmt, 0), (const char *)sqlite3_column_text(stmt, 1),
+                     sqlite3_column_int(stmt, 2));
+    sqlite3_finalize(stmt);
+    g_free(query);
+    g_free(d->filmrolls_where);
+    d->filmrolls_where = g_strdup(where_ext);
+    return TRUE;
+  }
+
+  if(!changed) return FALSE;
+
+  // a film roll which is gone returns no row at all
+  gchar *query = g_strdup_printf("SELECT folder, "
+                                 "(SELECT COUNT(*) FROM main.images AS mi WHERE film_id = ?1 AND %s) "
+                                 "FROM main.film_rolls WHERE id = ?1",
+                                 where_ext);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  for(GList *l = changed; l; l = g_list_next(l))
+  {
+    const int id = GPOINTER_TO_INT(l->data);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
+    if(sqlite3_step(stmt) == SQLITE_ROW)
+      _filmrolls_set(d, id, (const char *)sqlite3_column_text(stmt, 0), sqlite3_column_int(stmt, 1));
+    else
+      _filmrolls_set(d, id, NULL, 0);
+    DT_DEBUG_SQLITE3_RESET(stmt);
+    DT_DEBUG_SQLITE3_CLEAR_BINDINGS(stmt);
+  }
+  sqlite3_finalize(stmt);
+  g_free(query);
+  g_list_free(changed);
+  return TRUE;
+}
+
+// the counted film rolls as the sorted list the folder tree is built or patched from
+static GList *_filmrolls_names(dt_lib_collect_t *d)
+{
+  GList *sorted_names = NULL;
+  GHashTableIter it;
+  gpointer value;
+  g_hash_table_iter_init(&it, d->filmrolls);
+  while(g_hash_table_iter_next(&it, NULL, &value))
+  {
+    const dt_lib_collect_filmroll_t *filmroll = (const dt_lib_collect_filmroll_t *)value;
+    name_key_tuple_t *tuple = (name_key_tuple_t *)malloc(sizeof(name_key_tuple_t));
+    tuple->name = g_strdup(filmroll->folder);
+    tuple->collate_key = folder_collate_key(filmroll->folder);
+    tuple->count = filmroll->count;
+    sorted_names = g_list_prepend(sorted_names, tuple);
+  }
+  return g_list_sort(sorted_names, sort_folder_tag);
+}
+
 // create a key such that "darktable|" is coming first, and the rest is ordered such that sub tags are coming directly
 // behind their parent
 static char *tag_collate_key(char *tag)
@@ -982,29 +1311,17 @@ static void tree_view(dt_lib_collect_rule_t *dr)
     g_object_ref(model);
     g_object_unref(d->treefilter);
     gtk_tree_view_set_model(GTK_TREE_VIEW(d->view), NULL);
-    gtk_tree_store_clear(GTK_TREE_STORE(model));
+    // a folder tree is patched, everything else built from scratch
+    const gboolean patch = folders && g_hash_table_size(d->folders) > 0;
+    if(!patch)
+    {
+      gtk_tree_store_clear(GTK_TREE_STORE(model));
+      g_hash_table_remove_all(d->folders);
+      d->folders_recheck = FALSE; // a new folder tree looks at every row anyway
+    }
     gtk_widget_hide(GTK_WIDGET(d->scrolledwindow));
     gtk_widget_hide(GTK_WIDGET(d->sw2));
 
-    /* query construction */
-    gchar *where_ext = dt_collection_get_extended_where(darktable.collection, dr->num);
-    const char *query = g_strdup_printf(
-            folders ? "SELECT folder, film_rolls_id, COUNT(*) AS count FROM main.images AS mi "
-                    "JOIN (SELECT id AS film_rolls_id, folder FROM main.film_rolls) ON film_id = film_rolls_id "
-                    "WHERE %s GROUP BY folder, film_rolls_id":
-            tags ? "SELECT name, tag_id, COUNT(*) AS count FROM main.images AS mi JOIN main.tagged_images ON id = imgid "
-                    "JOIN (SELECT name, id AS tag_id FROM data.tags) ON tagid = tag_id "
-                    "WHERE %s GROUP BY name,tag_id" :
-            days ? "SELECT SUBSTR(datetime_taken, 1, 10) AS date, 1, COUNT(*) AS count FROM main.images AS mi "
-                    "WHERE %s GROUP BY date ORDER BY datetime_taken ASC" :
-            times ? "SELECT datetime_taken AS date, 1, COUNT(*) AS count FROM main.images AS mi "
-                    "WHERE %s GROUP BY date ORDER BY datetime_taken ASC" :
-            NULL,
-            where_ext);
-
-    g_free(where_ext);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-
     char **last_tokens = NULL;
     int last_tokens_length = 0;
     GtkTreeIter last_parent = { 0 };
@@ -1012,36 +1329,59 @@ static void tree_view(dt_lib_collect_rule_t *dr)
     // we need to sort the names ourselves and not let sqlite handle this
     // because it knows nothing about path separators.
     GList *sorted_names = NULL;
-    while(sqlite3_step(stmt) == SQLITE_ROW)
+    gchar *where_ext = dt_collection_get_extended_where(darktable.collection, dr->num);
+    if(folders)
+    {
+      // the counts of the film rolls are kept, only those which changed are counted again
+      _filmrolls_count(d, where_ext);
+      sorted_names = _filmrolls_names(d);
+    }
+    else
     {
-      char *name = g_strdup((const char *)sqlite3_column_text(stmt, 0));
-      gchar *collate_key = NULL;
+      /* query construction */
+      const char *query = g_strdup_printf(
+              tags ? "SELECT name, tag_id, COUNT(*) AS count FROM main.images AS mi JOIN main.tagged_images ON id = imgid "
+                      "JOIN (SELECT name, id AS tag_id FROM data.tags) ON tagid = tag_id "
+                      "WHERE %s GROUP BY name,tag_id" :
+              days ? "SELECT SUBSTR(datetime_taken, 1, 10) AS date, 1, COUNT(*) AS count FROM main.images AS mi "
+                      "WHERE %s GROUP BY date ORDER BY datetime_taken ASC" :
+              times ? "SELECT datetime_taken AS date, 1, COUNT(*) AS count FROM main.images AS mi "
+                      "WHERE %s GROUP BY date ORDER BY datetime_taken ASC" :
+              NULL,
+              where_ext);
 
-      const int count = sqlite3_column_int(stmt, 2);
+      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
 
-      if(folders)
+      while(sqlite3_step(stmt) == SQLITE_ROW)
       {
-        char *name_folded = g_utf8_casefold(name, -1);
-        char *name_folded_slash = g_strconcat(name_folded, G_DIR_SEPARATOR_S, NULL);
-        collate_key = g_utf8_collate_key_for_filename(name_folded_slash, -1);
-        g_free(name_folded_slash);
-        g_free(name_folded);
+        char *name = g_strdup((const char *)sqlite3_column_text(stmt, 0));
+        gchar *collate_key = NULL;
+
+        const int count = sqlite3_column_int(stmt, 2);
+
+        if(tags)
+          collate_key = tag_collate_key(name);
+
+        name_key_tuple_t *tuple = (name_key_tuple_t *)malloc(sizeof(name_key_tuple_t));
+        tuple->name = name;
+        tuple->collate_key = collate_key;
+        tuple->count = count;
+        sorted_names = g_list_prepend(sorted_names, tuple);
       }
-      else if(tags)
-        collate_key = tag_collate_key(name);
-
-      name_key_tuple_t *tuple = (name_key_tuple_t *)malloc(sizeof(name_key_tuple_t));
-      tuple->name = name;
-      tuple->collate_key = collate_key;
-      tuple->count = count;
-      sorted_names = g_list_prepend(sorted_names, tuple);
+      sqlite3_finalize(stmt);
+
+      if(tags)
+        sorted_names = g_list_sort(sorted_names, sort_folder_tag);
     }
-    sqlite3_finalize(stmt);
+    g_free(where_ext);
 
-    if(folders || tags)
-      sorted_names = g_list_sort(sorted_names, sort_folder_tag);
+    if(patch)
+    {
+      _folders_update(d, model, sorted_names);
+      if(d->folders_recheck) _folders_reachable(d, model);
+    }
 
-    for(GList *names = sorted_names; names; names = g_list_next(names))
+    for(GList *names = patch ? NULL : sorted_names; names; names = g_list_next(names))
     {
       name_key_tuple_t *tuple = (name_key_tuple_t *)names->data;
       char *name = tuple->name;
@@ -1137,8 +1477,11 @@ static void tree_view(dt_lib_collect_rule_t *dr)
             }
 
             if(folders)
+            {
               gtk_tree_store_set(GTK_TREE_STORE(model), &iter, DT_LIB_COLLECT_COL_UNREACHABLE,
                                  !(g_file_test(pth, G_FILE_TEST_IS_DIR)), -1);
+              _folders_add(d, pth2, &iter);
+            }
             common_length++;
             parent = iter;
             g_free(pth2);
@@ -1643,6 +1986,9 @@ static void combo_changed(GtkComboBox *combo, dt_lib_collect_rule_t *d)
     d->typing = FALSE;
   }
 
+  // picking the folders again is the way to have them all looked at for reachability
+  if(property == DT_COLLECTION_PROP_FOLDERS) c->folders_recheck = TRUE;
+
   if(property == DT_COLLECTION_PROP_APERTURE || property == DT_COLLECTION_PROP_FOCAL_LENGTH
      || property == DT_COLLECTION_PROP_ISO || property == DT_COLLECTION_PROP_ASPECT_RATIO
      || property == DT_COLLECTION_PROP_EXPOSURE)
@@ -1891,10 +2237,40 @@ static void collection_updated(gpointer instance, gpointer self)
 
 static void filmrolls_updated(gpointer instance, gpointer self)
 {
-  // TODO: We should update the count of images here
+  dt_lib_module_t *dm = (dt_lib_module_t *)self;
+  dt_lib_collect_t *d = (dt_lib_collect_t *)dm->data;
+
+  // also raised for color labels, metadata and the like. a folder tree only gets the counts of the film rolls
+  // patched which got images added or removed, unless other rules might count differently now.
+  if(d->view_rule == DT_COLLECTION_PROP_FOLDERS)
+  {
+    gchar *where_ext = dt_collection_get_extended_where(darktable.collection, d->active_rule);
+    if(strcmp(where_ext, "(1=1)"))
+    {
+      g_free(d->filmrolls_where);
+      d->filmrolls_where = NULL;
+    }
+    if(_filmrolls_count(d, where_ext))
+    {
+      GList *sorted_names = _filmrolls_names(d);
+      _folders_update(d, gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(d->treefilter)), sorted_names);
+      g_list_free_full(sorted_names, free_tuple);
+    }
+    g_free(where_ext);
+  }
   _lib_collect_gui_update(self);
 }
 
+static void _mounts_changed(GVolumeMonitor *monitor, GMount *mount, dt_lib_module_t *self)
+{
+  dt_lib_collect_t *d = (dt_lib_collect_t *)self->data;
+
+  // film rolls on the drive became (un)reachable
+  d->folders_recheck = TRUE;
+  if(d->view_rule == DT_COLLECTION_PROP_FOLDERS)
+    _folders_reachable(d, gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(d->treefilter)));
+}
+
 static void filmrolls_imported(gpointer instance, int film_id, gpointer self)
 {
   dt_lib_module_t *dm = (dt_lib_module_t *)self;
@@ -1911,11 +2287,8 @@ static void filmrolls_removed(gpointer instance, gpointer self)
   dt_lib_module_t *dm = (dt_lib_module_t *)self;
   dt_lib_collect_t *d = (dt_lib_collect_t *)dm->data;
 
-  // update tree
-  if (d->view_rule != DT_COLLECTION_PROP_FOLDERS)
-  {
-    d->view_rule = -1;
-  }
+  // update tree, a folder tree only gets the counts of the parents of the removed rows patched
+  d->view_rule = -1;
   d->rule[d->active_rule].typing = FALSE;
   _lib_collect_gui_update(self);
 }
@@ -2065,6 +2438,7 @@ void gui_init(dt_lib_module_t *self)
   {
     d->rule[i].num = i;
     d->rule[i].typing = FALSE;
+    d->rule[i].matching = NULL;
     box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0));
     d->rule[i].hbox = GTK_WIDGET(box);
     gtk_box_pack_start(GTK_BOX(self->widget), GTK_WIDGET(box), TRUE, TRUE, 0);
@@ -2106,6 +2480,8 @@ void gui_init(dt_lib_module_t *self)
   GtkTreeView *view = GTK_TREE_VIEW(gtk_tree_view_new());
   d->view_rule = -1;
   d->view = view;
+  d->folders = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, _folder_free);
+  d->filmrolls = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, _filmroll_free);
   gtk_tree_view_set_headers_visible(view, FALSE);
   gtk_container_add(GTK_CONTAINER(sw), GTK_WIDGET(view));
   g_signal_connect(G_OBJECT(view), "button-press-event", G_CALLBACK(view_onButtonPressed), d);
@@ -2164,6 +2540,10 @@ void gui_init(dt_lib_module_t *self)
                             self);
 
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_PREFERENCES_CHANGE, G_CALLBACK(view_set_click), self);
+
+  d->volumes = g_volume_monitor_get();
+  g_signal_connect(G_OBJECT(d->volumes), "mount-added", G_CALLBACK(_mounts_changed), self);
+  g_signal_connect(G_OBJECT(d->volumes), "mount-removed", G_CALLBACK(_mounts_changed), self);
 }
 
 void gui_cleanup(dt_lib_module_t *self)
@@ -2178,6 +2558,8 @@ void gui_cleanup(dt_lib_module_t *self)
   dt_control_signal_disconnect(darktable.signals, G_CALLBACK(filmrolls_removed), self);
   dt_control_signal_disconnect(darktable.signals, G_CALLBACK(tag_changed), self);
   dt_control_signal_disconnect(darktable.signals, G_CALLBACK(view_set_click), self);
+  g_signal_handlers_disconnect_by_func(d->volumes, G_CALLBACK(_mounts_changed), self);
+  g_object_unref(d->volumes);
   darktable.view_manager->proxy.module_collect.module = NULL;
   free(d->params);
 
@@ -2185,6 +2567,9 @@ void gui_cleanup(dt_lib_module_t *self)
 
   g_object_unref(d->treefilter);
   g_object_unref(d->listfilter);
+  g_hash_table_destroy(d->folders);
+  g_hash_table_destroy(d->filmrolls);
+  g_free(d->filmrolls_where);
 
   /* TODO: Make sure we are cleaning up all allocations */
 
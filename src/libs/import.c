@@ -697,7 +697,8 @@ static void _lib_import_update_preview(GtkFileChooser *file_chooser, gpointer da
   {
 
     // get image orientation
-    dt_image_t img = { 0 };
+    dt_image_t img;
+    dt_image_init(&img);
     (void)dt_exif_read(&img, filename);
 
     // Rotate the image to the correct orientation
@@ -737,7 +737,16 @@ void dt_lib_init_presets(dt_lib_module_t *module)
 static void dt_lib_init_module(void *m)
 {
   dt_lib_module_t *module = (dt_lib_module_t *)m;
-  dt_lib_init_presets(module);
+  // only (re)create the presets if something they depend on changed since the last start
+  const uint64_t hash = dt_module_manifest_hash(module->module, module->version(), NULL);
+  if(dt_module_presets_outdated("lib", module->plugin_name, hash, module->version(), -1))
+  {
+    // gui_init() below may start transactions of its own, so this one only covers the presets
+    DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "BEGIN", NULL, NULL, NULL);
+    dt_lib_init_presets(module);
+    dt_module_manifest_store("lib", module->plugin_name, hash);
+    DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+  }
   // Calling the keyboard shortcut initialization callback if present
   // do not init accelerators if there is no gui
   if(darktable.gui)
@@ -62,6 +62,7 @@ typedef struct dt_lib_tagging_t
   char *collection;
   GtkEntryCompletion *completion;
   char *last_tag;
+  GHashTable *matching; // tags matching keyword, only while updating the visibility
 } dt_lib_tagging_t;
 
 typedef struct dt_tag_op_t
@@ -155,30 +156,31 @@ static void propagate_sel_to_parents(GtkTreeModel *model, GtkTreeIter *iter)
 static gboolean set_matching_tag_visibility(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, dt_lib_module_t *self)
 {
   dt_lib_tagging_t *d = (dt_lib_tagging_t *)self->data;
-  gboolean visible;
+  gboolean visible, cur_state;
   gchar *tagname = NULL;
-  gchar *synonyms = NULL;
-  gtk_tree_model_get(model, iter, DT_LIB_TAGGING_COL_PATH, &tagname, DT_LIB_TAGGING_COL_SYNONYM, &synonyms, -1);
-  if (!d->keyword[0])
-    visible = TRUE;
-  else
-  {
-    if (synonyms && synonyms[0]) tagname = dt_util_dstrcat(tagname, ", %s", synonyms);
-    gchar *haystack = g_utf8_strdown(tagname, -1);
-    gchar *needle = g_utf8_strdown(d->keyword, -1);
-    visible = (g_strrstr(haystack, needle) != NULL);
-    g_free(haystack);
-    g_free(needle);
-  }
+  gtk_tree_model_get(model, iter, DT_LIB_TAGGING_COL_PATH, &tagname, DT_LIB_TAGGING_COL_VISIBLE, &cur_state, -1);
+  // path nodes of the tree which aren't tags themselves are revealed by their children
+  visible = !d->matching || (tagname && g_hash_table_contains(d->matching, tagname));
+  g_free(tagname);
+  // every change is a signal to the filter model, so skip the rows which stay as they are
+  if(visible == cur_state) return FALSE;
   if (d->tree_flag)
     gtk_tree_store_set(GTK_TREE_STORE(model), iter, DT_LIB_TAGGING_COL_VISIBLE, visible, -1);
   else
     gtk_list_store_set(GTK_LIST_STORE(model), iter, DT_LIB_TAGGING_COL_VISIBLE, visible, -1);
-  g_free(tagname);
-  g_free(synonyms);
   return FALSE;
 }
 
+static void update_matching_tag_visibility(GtkTreeModel *store, dt_lib_module_t *self)
+{
+  dt_lib_tagging_t *d = (dt_lib_tagging_t *)self->data;
+  // look the keyword up in the tag index once instead of comparing it to every row
+  d->matching = d->keyword[0] ? dt_tag_index_find(d->keyword, TRUE) : NULL;
+  gtk_tree_model_foreach(store, (GtkTreeModelForeachFunc)set_matching_tag_visibility, self);
+  if(d->matching) g_hash_table_destroy(d->matching);
+  d->matching = NULL;
+}
+
 static gboolean tree_reveal_func(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer data)
 {
   gboolean state;
@@ -338,7 +340,7 @@ static void init_treeview(dt_lib_module_t *self, int which)
     }
     if (d->keyword[0])
     {
-      gtk_tree_model_foreach(store, (GtkTreeModelForeachFunc)set_matching_tag_visibility, self);
+      update_matching_tag_visibility(store, self);
       gtk_tree_model_foreach(store, (GtkTreeModelForeachFunc)tree_reveal_func, NULL);
       gtk_tree_view_set_model(GTK_TREE_VIEW(view), model);
       gtk_tree_view_expand_all(d->dictionary_view);
@@ -369,7 +371,7 @@ static void init_treeview(dt_lib_module_t *self, int which)
     }
     if (which && d->keyword[0])
     {
-      gtk_tree_model_foreach(store, (GtkTreeModelForeachFunc)set_matching_tag_visibility, self);
+      update_matching_tag_visibility(store, self);
     }
     gtk_tree_view_set_model(GTK_TREE_VIEW(view), model);
     g_object_unref(model);
@@ -1145,7 +1147,7 @@ static void tag_name_changed(GtkEntry *entry, dt_lib_module_t *self)
   set_keyword(self);
   GtkTreeModel *model = gtk_tree_view_get_model(d->dictionary_view);
   GtkTreeModel *store = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model));
-  gtk_tree_model_foreach(store, (GtkTreeModelForeachFunc)set_matching_tag_visibility, self);
+  update_matching_tag_visibility(store, self);
   if (d->tree_flag && d->keyword[0])
   {
     gtk_tree_model_foreach(store, (GtkTreeModelForeachFunc)tree_reveal_func, NULL);
@@ -2504,6 +2506,7 @@ void gui_init(dt_lib_module_t *self)
   self->data = (void *)d;
   d->imgsel = -1;
   d->last_tag = NULL;
+  d->matching = NULL;
 
   self->widget = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
   dt_gui_add_help_link(self->widget, dt_get_help_url(self->plugin_name));
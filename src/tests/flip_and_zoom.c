@@ -0,0 +1,127 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// benchmark and equivalence test of dt_iop_flip_and_zoom_8 against the generic sampler, for the integer
+// factors that take the shortcut and all eight orientations. input sizes that aren't a multiple of the factor
+// leave pixels over, which puts the taps of flipped axes at another phase. outputs a pixel short of the exact
+// size or rounded up give scales just off the factor, which the shortcut may only take while its blocks still
+// fit into the input. prints the run time of both and the largest difference of the colour channels, and
+// fails if they are more than one apart.
+
+#include "common/darktable.h"
+#include "develop/imageop_math.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RUNS 5
+
+// exact multiples of all factors, odd in both directions and odd in one of them
+static const int32_t _sizes[][2] = { { 6000, 4000 }, { 6001, 4003 }, { 6003, 4000 }, { 6000, 4003 } };
+
+typedef void (*_flip_and_zoom_t)(const uint8_t *in, int32_t iw, int32_t ih, uint8_t *out, int32_t ow,
+                                 int32_t oh, const dt_image_orientation_t orientation, uint32_t *width,
+                                 uint32_t *height);
+
+static double _run(_flip_and_zoom_t f, const uint8_t *const in, const int32_t iw, const int32_t ih,
+                   uint8_t *const out, const int32_t ow, const int32_t oh, const dt_image_orientation_t orientation,
+                   uint32_t *width, uint32_t *height)
+{
+  const double start = dt_get_wtime();
+  for(int n = 0; n < RUNS; n++) f(in, iw, ih, out, ow, oh, orientation, width, height);
+  return (dt_get_wtime() - start) / RUNS;
+}
+
+int main()
+{
+  char *argv[] = {"darktable-test-flip-and-zoom", "--library", ":memory:", "--conf", "write_sidecar_files=FALSE", NULL};
+  int argc = sizeof(argv) / sizeof(*argv) - 1;
+
+  // init dt without gui and without data.db:
+  if(dt_init(argc, argv, FALSE, FALSE, NULL)) exit(1);
+
+  const int factors[] = { 2, 4, 8 };
+  size_t size = 0;
+  for(int s = 0; s < sizeof(_sizes) / sizeof(*_sizes); s++)
+    size = MAX(size, (size_t)4 * _sizes[s][0] * _sizes[s][1]);
+
+  uint8_t *in = dt_alloc_align(64, size);
+  uint8_t *out_generic = dt_alloc_align(64, size / 4);
+  uint8_t *out_integer = dt_alloc_align(64, size / 4);
+  if(!in || !out_generic || !out_integer) exit(1);
+
+  srand(42);
+  for(size_t k = 0; k < size; k++) in[k] = rand() & 0xff;
+
+  printf("average of %d runs\n", RUNS);
+  printf("    input  factor  offset  orientation  generic [ms]  integer [ms]  max diff\n");
+
+  int failed = 0;
+  for(int s = 0; s < sizeof(_sizes) / sizeof(*_sizes); s++)
+    for(int f = 0; f < sizeof(factors) / sizeof(*factors); f++)
+      for(int off = -1; off <= 1; off++)
+        for(int o = 0; o < 8; o++)
+        {
+          const int32_t iw = _sizes[s][0], ih = _sizes[s][1];
+          const dt_image_orientation_t orientation = o;
+          // a pixel short of the exact size, or rounded up so that blocks are left over
+          const int32_t up = (off > 0) ? factors[f] - 1 : 0;
+          const int32_t ow = (((orientation & ORIENTATION_SWAP_XY) ? ih : iw) + up) / factors[f] + MIN(off, 0);
+          const int32_t oh = (((orientation & ORIENTATION_SWAP_XY) ? iw : ih) + up) / factors[f];
+
+          // the generic path leaves pixels it can't sample alone, so start both from the same buffer
+          memset(out_generic, 0, size / 4);
+          memset(out_integer, 0, size / 4);
+
+          uint32_t wd_generic = 0, ht_generic = 0, wd_integer = 0, ht_integer = 0;
+          const double t_generic = _run(dt_iop_flip_and_zoom_8_generic, in, iw, ih, out_generic, ow, oh,
+                                        orientation, &wd_generic, &ht_generic);
+          const double t_integer = _run(dt_iop_flip_and_zoom_8, in, iw, ih, out_integer, ow, oh, orientation,
+                                        &wd_integer, &ht_integer);
+
+          if(wd_generic != wd_integer || ht_generic != ht_integer)
+          {
+            printf("%4dx%4d  %6d  %6d  %11d  size mismatch: %ux%u vs %ux%u\n", iw, ih, factors[f], off, o,
+                   wd_generic, ht_generic, wd_integer, ht_integer);
+            failed = 1;
+            continue;
+          }
+
+          int diff = 0;
+          for(size_t k = 0; k < (size_t)wd_generic * ht_generic; k++)
+            for(int c = 0; c < 3; c++)
+              diff = MAX(diff, abs((int)out_generic[4 * k + c] - (int)out_integer[4 * k + c]));
+
+          printf("%4dx%4d  %6d  %6d  %11d  %12.2f  %12.2f  %8d\n", iw, ih, factors[f], off, o, 1000.0 * t_generic,
+                 1000.0 * t_integer, diff);
+          if(diff > 1) failed = 1;
+        }
+
+  dt_free_align(in);
+  dt_free_align(out_generic);
+  dt_free_align(out_integer);
+
+  dt_cleanup();
+
+  return failed;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -1212,6 +1212,9 @@ static int expose_filemanager(dt_view_t *self, cairo_t *cr, int32_t width, int32
   }
 
 end_query_cache:
+  // get the image structs of the whole page with one query
+  dt_image_cache_prefetch(darktable.image_cache, query_ids, max_rows * max_cols);
+
   mouse_over_id = -1;
   cairo_save(cr);
   int current_image = 0;
@@ -2668,7 +2671,7 @@ static int expose_full_preview(dt_view_t *self, cairo_t *cr, int32_t width, int3
       if(!dt_imageio_large_thumbnail(filename, &lib->full_res_thumb,
                                                &lib->full_res_thumb_wd,
                                                &lib->full_res_thumb_ht,
-                                               &color_space))
+                                               &color_space, lib->full_preview_id, 0, 0))
       {
         lib->full_res_thumb_orientation = ORIENTATION_NONE;
         lib->full_res_thumb_id = lib->full_preview_id;
@@ -21,6 +21,7 @@
 #include "views/view.h"
 #include "bauhaus/bauhaus.h"
 #include "common/collection.h"
+#include "common/colorspaces.h"
 #include "common/darktable.h"
 #include "common/debug.h"
 #include "common/focus_peaking.h"
@@ -56,6 +57,100 @@ static void dt_view_manager_load_modules(dt_view_manager_t *vm);
 static int dt_view_load_module(void *v, const char *libname, const char *module_name);
 static void dt_view_unload_module(dt_view_t *view);
 
+// a thumbnail converted for the display, as painted by dt_view_image_expose()
+typedef struct dt_view_thumb_surface_t
+{
+  uint32_t key;
+  uint32_t generation; // of the mipmap buffer it was made from
+  gboolean color_managed;
+  cairo_surface_t *surface;
+  uint8_t *rgbbuf;
+  size_t size;
+  GList *link; // into the lru queue
+} dt_view_thumb_surface_t;
+
+static void _thumb_surface_free(gpointer data)
+{
+  dt_view_thumb_surface_t *s = (dt_view_thumb_surface_t *)data;
+  cairo_surface_destroy(s->surface);
+  free(s->rgbbuf);
+  free(s);
+}
+
+static void _thumb_surface_remove(dt_view_manager_t *vm, dt_view_thumb_surface_t *s)
+{
+  g_queue_delete_link(vm->thumb_surfaces.lru, s->link);
+  vm->thumb_surfaces.size -= s->size;
+  g_hash_table_remove(vm->thumb_surfaces.table, GUINT_TO_POINTER(s->key));
+}
+
+static void _thumb_surfaces_clear(dt_view_manager_t *vm)
+{
+  g_queue_clear(vm->thumb_surfaces.lru);
+  g_hash_table_remove_all(vm->thumb_surfaces.table);
+  vm->thumb_surfaces.size = 0;
+}
+
+static inline uint32_t _thumb_surface_key(const dt_mipmap_buffer_t *buf)
+{
+  return (((uint32_t)buf->size) << 28) | (buf->imgid & 0xfffffff);
+}
+
+// returns the surface made from buf before, if the pixels of buf didn't change since
+static cairo_surface_t *_thumb_surface_get(dt_view_manager_t *vm, const dt_mipmap_buffer_t *buf,
+                                           const gboolean color_managed)
+{
+  dt_view_thumb_surface_t *s = (dt_view_thumb_surface_t *)g_hash_table_lookup(
+      vm->thumb_surfaces.table, GUINT_TO_POINTER(_thumb_surface_key(buf)));
+  if(!s) return NULL;
+  if(s->generation != buf->generation || s->color_managed != color_managed)
+  {
+    _thumb_surface_remove(vm, s);
+    return NULL;
+  }
+  g_queue_unlink(vm->thumb_surfaces.lru, s->link);
+  g_queue_push_tail_link(vm->thumb_surfaces.lru, s->link);
+  return s->surface;
+}
+
+// takes over surface and rgbbuf
+static void _thumb_surface_put(dt_view_manager_t *vm, const dt_mipmap_buffer_t *buf, const gboolean color_managed,
+                               cairo_surface_t *surface, uint8_t *rgbbuf)
+{
+  dt_view_thumb_surface_t *s = (dt_view_thumb_surface_t *)calloc(1, sizeof(dt_view_thumb_surface_t));
+  s->key = _thumb_surface_key(buf);
+  s->generation = buf->generation;
+  s->color_managed = color_managed;
+  s->surface = surface;
+  s->rgbbuf = rgbbuf;
+  s->size = (size_t)buf->width * buf->height * 4;
+
+  dt_view_thumb_surface_t *old
+      = (dt_view_thumb_surface_t *)g_hash_table_lookup(vm->thumb_surfaces.table, GUINT_TO_POINTER(s->key));
+  if(old) _thumb_surface_remove(vm, old);
+
+  g_hash_table_insert(vm->thumb_surfaces.table, GUINT_TO_POINTER(s->key), s);
+  g_queue_push_tail(vm->thumb_surfaces.lru, s);
+  s->link = g_queue_peek_tail_link(vm->thumb_surfaces.lru);
+  vm->thumb_surfaces.size += s->size;
+
+  // the least recently painted go first, never the one just added
+  while(vm->thumb_surfaces.size > vm->thumb_surfaces.max_size && vm->thumb_surfaces.lru->length > 1)
+    _thumb_surface_remove(vm, (dt_view_thumb_surface_t *)g_queue_peek_head(vm->thumb_surfaces.lru));
+}
+
+static void _thumb_surfaces_profile_changed(gpointer instance, gpointer user_data)
+{
+  _thumb_surfaces_clear((dt_view_manager_t *)user_data);
+}
+
+// the display profile or intent picked in the lighttable or darkroom popovers
+static void _thumb_surfaces_profile_user_changed(gpointer instance, uint8_t profile_type, gpointer user_data)
+{
+  if(profile_type == DT_COLORSPACES_PROFILE_TYPE_DISPLAY || profile_type == DT_COLORSPACES_PROFILE_TYPE_DISPLAY2)
+    _thumb_surfaces_clear((dt_view_manager_t *)user_data);
+}
+
 void dt_view_manager_init(dt_view_manager_t *vm)
 {
   /* prepare statements */
@@ -75,6 +170,12 @@ void dt_view_manager_init(dt_view_manager_t *vm)
       "SELECT id FROM main.images WHERE group_id = (SELECT group_id FROM main.images WHERE id=?1) AND id != ?2",
       -1, &vm->statements.get_grouped, NULL);
 
+  vm->thumb_surfaces.table = g_hash_table_new_full(NULL, NULL, NULL, _thumb_surface_free);
+  vm->thumb_surfaces.lru = g_queue_new();
+  vm->thumb_surfaces.size = 0;
+  // a quarter of what the mipmap cache may hold, that is a couple of pages of thumbnails even on large screens
+  vm->thumb_surfaces.max_size = dt_conf_get_int64("cache_memory") / 4;
+
   dt_view_manager_load_modules(vm);
 
   // Modules loaded, let's handle specific cases
@@ -93,6 +194,12 @@ void dt_view_manager_init(dt_view_manager_t *vm)
 
 void dt_view_manager_gui_init(dt_view_manager_t *vm)
 {
+  // thumbnails converted for the old display profile are of no use anymore
+  dt_control_signal_connect(darktable.signals, DT_SIGNAL_CONTROL_PROFILE_CHANGED,
+                            G_CALLBACK(_thumb_surfaces_profile_changed), vm);
+  dt_control_signal_connect(darktable.signals, DT_SIGNAL_CONTROL_PROFILE_USER_CHANGED,
+                            G_CALLBACK(_thumb_surfaces_profile_user_changed), vm);
+
   for(GList *iter = vm->views; iter; iter = g_list_next(iter))
   {
     dt_view_t *view = (dt_view_t *)iter->data;
@@ -103,6 +210,12 @@ void dt_view_manager_gui_init(dt_view_manager_t *vm)
 void dt_view_manager_cleanup(dt_view_manager_t *vm)
 {
   for(GList *iter = vm->views; iter; iter = g_list_next(iter)) dt_view_unload_module((dt_view_t *)iter->data);
+
+  dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_thumb_surfaces_profile_changed), vm);
+  dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_thumb_surfaces_profile_user_changed), vm);
+  _thumb_surfaces_clear(vm);
+  g_hash_table_destroy(vm->thumb_surfaces.table);
+  g_queue_free(vm->thumb_surfaces.lru);
 }
 
 const dt_view_t *dt_view_manager_get_current_view(dt_view_manager_t *vm)
@@ -1237,6 +1350,7 @@ int dt_view_image_expose(dt_view_image_expose_t *vals)
     float scale = 1.0;
     cairo_surface_t *surface = NULL;
     uint8_t *rgbbuf = NULL;
+    gboolean cached = FALSE;
 
     if(vals->full_surface && *(vals->full_surface) && !*(vals->full_surface_w_lock))
     {
@@ -1245,7 +1359,14 @@ int dt_view_image_expose(dt_view_image_expose_t *vals)
     }
     else
     {
-      if(buf_ok)
+      // thumbnails are kept converted, so redraws like scrolling don't have to do that again for every one
+      // of them. full previews have their own surface and the skull isn't worth it.
+      const gboolean color_managed = dt_conf_get_bool("cache_color_managed");
+      const gboolean use_cache = buf_ok && !vals->full_surface && (buf_wd > 8 || buf_ht > 8);
+      if(use_cache) surface = _thumb_surface_get(darktable.view_manager, &buf, color_managed);
+      cached = (surface != NULL);
+
+      if(buf_ok && !cached)
       {
         rgbbuf = (uint8_t *)calloc(buf_wd * buf_ht * 4, sizeof(uint8_t));
         if(rgbbuf)
@@ -1253,7 +1374,7 @@ int dt_view_image_expose(dt_view_image_expose_t *vals)
           gboolean have_lock = FALSE;
           cmsHTRANSFORM transform = NULL;
 
-          if(dt_conf_get_bool("cache_color_managed"))
+          if(color_managed)
           {
             pthread_rwlock_rdlock(&darktable.color_profiles->xprofile_lock);
             have_lock = TRUE;
@@ -1315,6 +1436,12 @@ int dt_view_image_expose(dt_view_image_expose_t *vals)
           const int32_t stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, buf_wd);
           surface = cairo_image_surface_create_for_data(rgbbuf, CAIRO_FORMAT_RGB24, buf_wd, buf_ht, stride);
 
+          if(use_cache)
+          {
+            _thumb_surface_put(darktable.view_manager, &buf, color_managed, surface, rgbbuf);
+            cached = TRUE;
+          }
+
           // we save the surface for later use
           if(!missing && vals->full_surface && !*(vals->full_surface_w_lock))
           {
@@ -1419,10 +1546,10 @@ int dt_view_image_expose(dt_view_image_expose_t *vals)
                                            cairo_image_surface_get_width(surface),
                                            cairo_image_surface_get_height(surface));
 
-      if(!vals->full_surface || !*(vals->full_surface)) cairo_surface_destroy(surface);
+      if(!cached && (!vals->full_surface || !*(vals->full_surface))) cairo_surface_destroy(surface);
     }
 
-    if(!vals->full_rgbbuf || !*(vals->full_rgbbuf)) free(rgbbuf);
+    if(!cached && (!vals->full_rgbbuf || !*(vals->full_rgbbuf))) free(rgbbuf);
 
     if(no_deco)
     {
@@ -283,6 +283,14 @@ typedef struct dt_view_manager_t
     sqlite3_stmt *get_grouped;
   } statements;
 
+  /* display ready thumbnails of dt_view_image_expose(), by imgid and mip */
+  struct
+  {
+    GHashTable *table;
+    GQueue *lru;
+    size_t size, max_size;
+  } thumb_surfaces;
+
 
   /*
    * Proxy